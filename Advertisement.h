@@ -0,0 +1,383 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Raw advertisement records and the scan response merge buffer.
+
+  With active scanning, the scan response (SCAN_RSP) of a device arrives as a
+  separate packet after its advertisement (ADV_IND), and often carries the name.
+  Every packet received by the scan callback is merged by address into one
+  record: AD structures whose type isn't known yet are appended to the payload,
+  during MERGE_WINDOW milliseconds after the first packet. The merged records
+  are what onScanDone() processes. The buffer starts with MERGE_BUFFER_SIZE
+  records and grows by as many when a busy scan fills it (psram first), up to
+  MERGE_BUFFER_MAX records (MERGE_BUFFER_HEAP_MAX without psram), new addresses
+  are dropped past that. It shrinks back to MERGE_BUFFER_SIZE once the scan is
+  processed so a crowded scan doesn't keep the memory.
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#ifndef MERGE_BUFFER_SIZE // override this from Settings.h
+#define MERGE_BUFFER_SIZE 64 // records, also the growth step
+#endif
+#ifndef MERGE_BUFFER_MAX // override this from Settings.h
+#define MERGE_BUFFER_MAX 1024 // records, with psram
+#endif
+#ifndef MERGE_BUFFER_HEAP_MAX // override this from Settings.h
+#define MERGE_BUFFER_HEAP_MAX 256 // records, without psram
+#endif
+#ifndef MERGE_WINDOW // override this from Settings.h
+#define MERGE_WINDOW 2000 // milliseconds
+#endif
+
+#define ADV_PAYLOAD_MAX 62 // ADV_IND + SCAN_RSP
+
+// AD types, see Bluetooth Core Specification Supplement
+#define AD_TYPE_UUID16_INCOMPLETE  0x02
+#define AD_TYPE_UUID16_COMPLETE    0x03
+#define AD_TYPE_UUID32_INCOMPLETE  0x04
+#define AD_TYPE_UUID32_COMPLETE    0x05
+#define AD_TYPE_UUID128_INCOMPLETE 0x06
+#define AD_TYPE_UUID128_COMPLETE   0x07
+#define AD_TYPE_NAME_SHORT         0x08
+#define AD_TYPE_NAME_COMPLETE      0x09
+#define AD_TYPE_TX_POWER           0x0A
+#define AD_TYPE_SERVICE_DATA16     0x16
+#define AD_TYPE_APPEARANCE         0x19
+#define AD_TYPE_MANUFACTURER_DATA  0xFF
+
+
+// 00000000-0000-1000-8000-00805f9b34fb, little endian, first 12 bytes
+static const uint8_t BLEBaseUUID[12] = { 0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00 };
+
+// formats a little endian 16/32/128 bits uuid the same way as BLEUUID::toString()
+static String uuidToString(const uint8_t *data, uint8_t len) {
+  char out[37];
+  if(len == 2 || len == 4) {
+    uint32_t val = data[0] | (data[1] << 8);
+    if(len == 4) val |= ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    sprintf(out, "%08x-0000-1000-8000-00805f9b34fb", val);
+  } else if(len == 16) {
+    byte pos = 0;
+    for(int i=15;i>=0;i--) {
+      pos += sprintf(out + pos, "%02x", data[i]);
+      if(i == 12 || i == 10 || i == 8 || i == 6) out[pos++] = '-';
+    }
+    out[pos] = '\0';
+  } else {
+    return "";
+  }
+  return String(out);
+}
+
+
+static String hexString(const uint8_t *data, uint8_t len) {
+  String out = "";
+  char hex[3];
+  for(byte i=0;i<len;i++) {
+    sprintf(hex, "%02x", data[i]);
+    out += hex;
+  }
+  return out;
+}
+
+
+struct BLEAdvertisement {
+  uint64_t mac = 0;
+  uint8_t addrType = 0; // esp_ble_addr_type_t
+  int8_t rssi = 0;
+  unsigned long timestamp = 0; // millis() of the first packet
+  uint16_t packets = 0; // merged packets count, saturates
+  uint8_t payloadLength = 0;
+  uint8_t payload[ADV_PAYLOAD_MAX];
+
+  // returns the offset of the data of the first AD structure of this type, or -1
+  int find(uint8_t type, uint8_t &len) {
+    int pos = 0;
+    len = 0;
+    while(pos + 1 < payloadLength) {
+      uint8_t fieldLength = payload[pos];
+      if(fieldLength == 0 || pos + 1 + fieldLength > payloadLength) break; // padding or truncated
+      if(payload[pos+1] == type) {
+        len = fieldLength - 1;
+        return pos + 2;
+      }
+      pos += fieldLength + 1;
+    }
+    return -1;
+  }
+  bool have(uint8_t type) {
+    uint8_t len;
+    return find(type, len) > -1;
+  }
+
+  String getAddress() {
+    char out[18];
+    sprintf(out, "%02x:%02x:%02x:%02x:%02x:%02x",
+      (uint8_t)(mac >> 40), (uint8_t)(mac >> 32), (uint8_t)(mac >> 24),
+      (uint8_t)(mac >> 16), (uint8_t)(mac >> 8),  (uint8_t)mac
+    );
+    return String(out);
+  }
+  uint8_t getAddressType() { return addrType; }
+  int getRSSI() { return rssi; }
+
+  bool haveName() { return have(AD_TYPE_NAME_COMPLETE) || have(AD_TYPE_NAME_SHORT); }
+  String getName() {
+    uint8_t len;
+    int pos = find(AD_TYPE_NAME_COMPLETE, len);
+    if(pos < 0) pos = find(AD_TYPE_NAME_SHORT, len);
+    if(pos < 0) return "";
+    char name[32];
+    if(len > 31) len = 31;
+    memcpy(name, payload + pos, len);
+    name[len] = '\0';
+    return String(name);
+  }
+
+  bool haveAppearance() { return have(AD_TYPE_APPEARANCE); }
+  uint16_t getAppearance() {
+    uint8_t len;
+    int pos = find(AD_TYPE_APPEARANCE, len);
+    if(pos < 0 || len < 2) return 0;
+    return payload[pos] | (payload[pos+1] << 8);
+  }
+
+  bool haveTXPower() { return have(AD_TYPE_TX_POWER); }
+
+  bool haveManufacturerData() { return have(AD_TYPE_MANUFACTURER_DATA); }
+  const uint8_t* getManufacturerData(uint8_t &len) {
+    int pos = find(AD_TYPE_MANUFACTURER_DATA, len);
+    if(pos < 0) {
+      len = 0;
+      return NULL;
+    }
+    return payload + pos;
+  }
+
+  // first 16 bits uuid service data, starts with the uuid
+  const uint8_t* getServiceData(uint8_t &len) {
+    int pos = find(AD_TYPE_SERVICE_DATA16, len);
+    if(pos < 0) {
+      len = 0;
+      return NULL;
+    }
+    return payload + pos;
+  }
+
+  bool haveServiceUUID() {
+    for(uint8_t type=AD_TYPE_UUID16_INCOMPLETE;type<=AD_TYPE_UUID128_COMPLETE;type++) {
+      uint8_t len;
+      if(find(type, len) > -1 && len > 0) return true;
+    }
+    return false;
+  }
+  // first advertised service uuid
+  String getServiceUUID() {
+    for(uint8_t type=AD_TYPE_UUID16_INCOMPLETE;type<=AD_TYPE_UUID128_COMPLETE;type++) {
+      uint8_t len;
+      int pos = find(type, len);
+      uint8_t uuidLength = type <= AD_TYPE_UUID16_COMPLETE ? 2 : type <= AD_TYPE_UUID32_COMPLETE ? 4 : 16;
+      if(pos > -1 && len >= uuidLength) return uuidToString(payload + pos, uuidLength);
+    }
+    return "";
+  }
+
+  // every advertised service uuid, comma separated, 16 bits SIG uuids in their short form
+  String getServiceUUIDs() {
+    String uuids = "";
+    char out[9];
+    int pos = 0;
+    while(pos + 1 < payloadLength) {
+      uint8_t fieldLength = payload[pos];
+      if(fieldLength == 0 || pos + 1 + fieldLength > payloadLength) break;
+      uint8_t type = payload[pos+1];
+      if(type >= AD_TYPE_UUID16_INCOMPLETE && type <= AD_TYPE_UUID128_COMPLETE) {
+        uint8_t uuidLength = type <= AD_TYPE_UUID16_COMPLETE ? 2 : type <= AD_TYPE_UUID32_COMPLETE ? 4 : 16;
+        for(int i=pos+2;i+uuidLength<=pos+1+fieldLength;i+=uuidLength) {
+          const uint8_t *uuid = payload + i;
+          if(uuids != "") uuids += ",";
+          if(uuidLength == 2) {
+            sprintf(out, "%04x", uuid[0] | (uuid[1] << 8));
+            uuids += out;
+          } else if(uuidLength == 4) {
+            sprintf(out, "%08x", uuid[0] | (uuid[1] << 8) | ((uint32_t)uuid[2] << 16) | ((uint32_t)uuid[3] << 24));
+            uuids += out;
+          } else if(memcmp(uuid, BLEBaseUUID, 12) == 0 && uuid[14] == 0 && uuid[15] == 0) {
+            // 0000xxxx-0000-1000-8000-00805f9b34fb
+            sprintf(out, "%04x", uuid[12] | (uuid[13] << 8));
+            uuids += out;
+          } else {
+            uuids += uuidToString(uuid, 16);
+          }
+        }
+      }
+      pos += fieldLength + 1;
+    }
+    return uuids;
+  }
+
+  // appends the AD structures of another packet whose types aren't in the payload yet, returns how many
+  byte merge(const uint8_t *data, uint8_t length) {
+    byte filled = 0;
+    int pos = 0;
+    while(pos + 1 < length) {
+      uint8_t fieldLength = data[pos];
+      if(fieldLength == 0 || pos + 1 + fieldLength > length) break;
+      if(!have(data[pos+1]) && payloadLength + fieldLength + 1 <= ADV_PAYLOAD_MAX) {
+        memcpy(payload + payloadLength, data + pos, fieldLength + 1);
+        payloadLength += fieldLength + 1;
+        filled++;
+      }
+      pos += fieldLength + 1;
+    }
+    return filled;
+  }
+};
+
+
+/* copies the advertised fields that don't need any lookup */
+static void parseAdvertisement(BLEAdvertisement &advertisedDevice, BlueToothDevice &BLEDev) {
+  BLEDev.address = advertisedDevice.getAddress();
+  BLEDev.addrclass = classifyAddress( advertisedDevice.mac, advertisedDevice.getAddressType() );
+  //BLEDev.spower = String( (int)advertisedDevice.getTXPower() );
+  BLEDev.rssi = String ( advertisedDevice.getRSSI() );
+  if (advertisedDevice.haveName()) {
+    BLEDev.name = advertisedDevice.getName();
+  } else {
+    BLEDev.name = "";
+  }
+  if (advertisedDevice.haveAppearance()) {
+    BLEDev.appearance = advertisedDevice.getAppearance();
+  } else {
+    BLEDev.appearance = "";
+  }
+  if (advertisedDevice.haveServiceUUID()) {
+    BLEDev.uuid = advertisedDevice.getServiceUUID();
+  } else {
+    BLEDev.uuid = "";
+  }
+}
+
+
+class MergeBufferUtils {
+  public:
+
+    BLEAdvertisement *records = NULL;
+    uint16_t count = 0;
+    uint16_t capacity = 0; // back to MERGE_BUFFER_SIZE after every scan
+    uint32_t mergedPackets = 0; // packets merged into an existing record
+    uint32_t filledFields = 0; // AD structures added by those packets (mostly scan responses)
+    uint32_t overflows = 0; // new addresses dropped because the buffer couldn't grow
+    uint16_t highWater = 0; // largest capacity reached
+
+    void init() {
+      resize( MERGE_BUFFER_SIZE );
+    }
+
+    // called from the scan callback for every received packet
+    void add(uint64_t mac, uint8_t addrType, int rssi, const uint8_t *payload, size_t length, unsigned long now) {
+      if(length > ADV_PAYLOAD_MAX) length = ADV_PAYLOAD_MAX;
+      int slot = index.find(mac);
+      if(slot > -1) {
+        BLEAdvertisement &record = records[slot];
+        record.rssi = rssi;
+        if(now - record.timestamp > MERGE_WINDOW) return; // sealed
+        if(record.packets < 0xffff) record.packets++;
+        mergedPackets++;
+        filledFields += record.merge(payload, length);
+        return;
+      }
+      if(count >= capacity && !resize( capacity + MERGE_BUFFER_SIZE )) {
+        overflows++;
+        return;
+      }
+      BLEAdvertisement &record = records[count];
+      record.mac = mac;
+      record.addrType = addrType;
+      record.rssi = rssi;
+      record.timestamp = now;
+      record.packets = 1;
+      record.payloadLength = 0;
+      record.merge(payload, length);
+      index.set(mac, count);
+      count++;
+    }
+
+    // true if this address sent a packet during the current scan
+    bool contains(uint64_t mac) {
+      return index.find(mac) > -1;
+    }
+
+    // called once the scan is processed, gives back what a crowded scan took
+    void clear() {
+      count = 0;
+      if(capacity > MERGE_BUFFER_SIZE && resize( MERGE_BUFFER_SIZE )) return; // fresh index
+      index.clear();
+    }
+
+    void printStats() {
+      Serial.printf("Merge -- merged packets:%d fields filled:%d capacity:%d high water:%d overflows:%d\n", mergedPackets, filledFields, capacity, highWater, overflows);
+    }
+
+  private:
+
+    MacIndex index;
+
+    // reallocs the records and rebuilds the index for newCapacity, never below count
+    bool resize(uint32_t newCapacity) {
+      uint32_t maxCapacity = psramFound() ? MERGE_BUFFER_MAX : MERGE_BUFFER_HEAP_MAX;
+      if(newCapacity > maxCapacity || newCapacity >= MACINDEX_EMPTY || newCapacity < count) return false;
+      MacIndex newIndex;
+      if(!newIndex.init(newCapacity, psramFound())) return false; // the old index still covers count records
+      size_t size = newCapacity * sizeof(BLEAdvertisement);
+      BLEAdvertisement *newRecords = (BLEAdvertisement*)( psramFound() ? ps_realloc(records, size) : realloc(records, size) );
+      if(newRecords == NULL) {
+        free(newIndex.table);
+        return false;
+      }
+      records = newRecords;
+      for(uint16_t i=0;i<count;i++) {
+        newIndex.set(records[i].mac, i);
+      }
+      free(index.table);
+      index.table = newIndex.table;
+      index.mask = newIndex.mask;
+      capacity = newCapacity;
+      if(capacity > highWater) highWater = capacity;
+      return true;
+    }
+
+};
+
+
+MergeBufferUtils MergeBuffer;
+
+#endif
@@ -36,27 +36,52 @@ class BLEScanUtils {
     void init() { 
       UI.init();
     };
-    void scan() { };
+    bool scan() { return true; };
 };
 #else
 
 
+// every received packet goes through here, live or replayed
+static void onPacket(uint64_t mac, uint8_t addrType, int rssi, const uint8_t *payload, size_t length, unsigned long now) {
+  unsigned long packetStart = micros();
+  PacketCount++;
+  Capture.add( mac, addrType, rssi, payload, length, now );
+  MergeBuffer.add( mac, addrType, rssi, payload, length, now );
+  LatencyPacket.add( micros() - packetStart );
+}
+
+// millis(), or the captured time when replaying
+static unsigned long scanClock() {
+  #ifdef ADV_REPLAY
+    return Replay.clock;
+  #else
+    return millis();
+  #endif
+}
+
 class FoundDeviceCallback: public BLEAdvertisedDeviceCallbacks {
   bool toggler = true;
-  byte foundDevicesCount = 0;
   void onResult(BLEAdvertisedDevice advertisedDevice) {
-    Serial.printf("Found %s \n", advertisedDevice.toString().c_str());
-    foundDevicesCount++;
-    //UI.headerStats("Found " + String(foundDevicesCount));
+    // called for every packet (duplicates enabled), scan responses are merged into the advertisement record
+    uint8_t *addr = *advertisedDevice.getAddress().getNative();
+    uint64_t mac = 0;
+    for(byte i=0;i<6;i++) mac = (mac << 8) | addr[i];
+    onPacket( mac, advertisedDevice.getAddressType(), advertisedDevice.getRSSI(), advertisedDevice.getPayload(), advertisedDevice.getPayloadLength(), millis() );
     toggler = !toggler;
     if(toggler) {
-      UI.bleStateIcon(WROVER_GREEN);
+      UI.bleStateIcon(WROVER_GREEN, true, DISPLAY_PRODUCER_SCAN);
     } else {
-      UI.bleStateIcon(WROVER_DARKGREEN);
+      UI.bleStateIcon(WROVER_DARKGREEN, true, DISPLAY_PRODUCER_SCAN);
     }
   }
 };
 
+static FoundDeviceCallback FoundDevices;
+static BlueToothDevice FilterScratch; // holds the raw advertised fields of uncached devices for the filter
+static unsigned long ScanPathMicros = 0; // time spent on new devices in onScanDone()
+static unsigned long ScanPathCount = 0;
+static unsigned long EnrichMicros = 0; // time spent on new devices in enrich()
+
 struct DeviceCacheStatus {
   bool exists = false;
   int index = -1;
@@ -67,32 +92,56 @@ class BLEScanUtils {
   public:
 
     void init() {
+      CollectorMutex = xSemaphoreCreateRecursiveMutex();
+      ScanDone = xSemaphoreCreateBinary();
+      xSemaphoreGive(ScanDone); // no scan running yet
+      BLEDevCacheInit();
+      MergeBuffer.init();
+      Decoder.init();
       UI.init();
       DB.init();
+      #ifdef ADV_CAPTURE
+        Capture.init(); // SD Card is mounted
+      #endif
       if ( resetReason == 12)  { // =  SW_CPU_RESET
-        thaw(); // get leftovers from NVS
-        if( feed() ) { // got insertions in DB ?
-          clearNVS(); // purge this
-          //ESP.restart();
-        }
+        #ifdef ADV_REPLAY
+          clearNVS(); // leftovers would make the replay non reproducible
+          Wal.clear();
+          Snapshot.clear();
+        #else
+          Snapshot.restore(); // warm caches and counters
+          thaw(); // get leftovers from NVS
+          if( feed() ) { // got insertions in DB ?
+            clearNVS(); // purge this
+            //ESP.restart();
+          }
+          replayWAL(); // get leftovers from the SD Card
+        #endif
       } else {
         clearNVS();
+        clearLegacyNVS();
+        Snapshot.clear(); // from another session
         ESP.restart();
       }
       WRITE_PERI_REG(RTC_CNTL_BROWN_OUT_REG, 0); //disable brownout detector
-      BLEDevice::init("");
+      #ifdef ADV_REPLAY
+        if( !Replay.init() ) {
+          while(1) yield();
+        }
+      #else
+        BLEDevice::init("");
+      #endif
     }
 
 
     static DeviceCacheStatus deviceCacheStatus(String bleDeviceAddress, bool skipDB=false) {
       DeviceCacheStatus internalStatus;
-      for(int i=0;i<BLEDEVCACHE_SIZE;i++) {
-        if( BLEDevCache[i].address == bleDeviceAddress) {
-          BLEDevCacheHit++;
-          internalStatus.exists = true;
-          internalStatus.index = i;
-          return internalStatus;
-        }
+      int slot = BLEDevCacheFind( macToInt(bleDeviceAddress) );
+      if( slot > -1 ) {
+        BLEDevCacheHit++;
+        internalStatus.exists = true;
+        internalStatus.index = slot;
+        return internalStatus;
       }
       if(skipDB) return internalStatus;
       internalStatus.index = DB.deviceExists(bleDeviceAddress);
@@ -109,164 +158,104 @@ class BLEScanUtils {
     }
 
 
-    static bool isAnonymousDevice(byte cacheindex) {
-      if(BLEDevCache[cacheindex].uuid!="") return false; // uuid's are interesting, let's collect
-      if(BLEDevCache[cacheindex].name!="") return false; // has name, let's collect
-      if(BLEDevCache[cacheindex].appearance!="") return false; // has icon, let's collect
-      if(BLEDevCache[cacheindex].ouiname=="[unpopulated]") return false; // don't know yet, let's keep
-      if(BLEDevCache[cacheindex].vname=="[unpopulated]") return false; // don't know yet, let's keep
-      if(BLEDevCache[cacheindex].ouiname=="[private]" || BLEDevCache[cacheindex].ouiname=="") return true; // don't care
-      if(BLEDevCache[cacheindex].vname=="[unknown]" || BLEDevCache[cacheindex].vname=="") return true; // don't care
-      if(BLEDevCache[cacheindex].vname!="" && BLEDevCache[cacheindex].ouiname!="") return false; // anonymous but qualified device, let's collect
-      return true;
+    static bool isAnonymousDevice(uint16_t cacheindex) {
+      bool anonymous = Filter.evaluate( BLEDevCache[cacheindex] ) == FILTER_DROP;
+      Filter.tally();
+      return anonymous;
     }
 
-    /* stores BLEDevice info in memory cache after retrieving complementary data */
-    static byte store(BLEAdvertisedDevice &advertisedDevice, bool populate=true) {
-      BLEDevCacheIndex++;
-      BLEDevCacheIndex=BLEDevCacheIndex%BLEDEVCACHE_SIZE;
-      BLEDevCache[BLEDevCacheIndex].reset(); // avoid mixing new and old data
-      byte cacheIndex = BLEDevCacheIndex;
+    /* stores BLEDevice info in memory cache, oui/vendor names are left "[unpopulated]" */
+    static uint16_t store(BLEAdvertisement &advertisedDevice) {
+      uint16_t cacheIndex = BLEDevCacheAlloc();
       BLEDevCache[cacheIndex].borderColor = WROVER_RED;
       BLEDevCache[cacheIndex].in_db = false;
-      BLEDevCache[cacheIndex].address = advertisedDevice.getAddress().toString().c_str();
-      //BLEDevCache[cacheIndex].spower = String( (int)advertisedDevice.getTXPower() );
-      if(populate) {
-        BLEDevCache[cacheIndex].ouiname = DB.getOUI( BLEDevCache[cacheIndex].address ); // TODO : procrastinate this
-      } else {
-        BLEDevCache[cacheIndex].ouiname = "[unpopulated]";
-      }
-      BLEDevCache[cacheIndex].rssi = String ( advertisedDevice.getRSSI() );
-      if (advertisedDevice.haveName()) {
-        BLEDevCache[cacheIndex].name = String ( advertisedDevice.getName().c_str() );
-      } else {
-        BLEDevCache[cacheIndex].name = "";
-      }
-      if (advertisedDevice.haveAppearance()) {
-        BLEDevCache[cacheIndex].appearance = advertisedDevice.getAppearance();
-      } else {
-        BLEDevCache[cacheIndex].appearance = "";
-      }
-      if (advertisedDevice.haveManufacturerData()) {
-        std::string md = advertisedDevice.getManufacturerData();
-        uint8_t* mdp = (uint8_t*)advertisedDevice.getManufacturerData().data();
-        char *pHex = BLEUtils::buildHexData(nullptr, mdp, md.length());
+      parseAdvertisement( advertisedDevice, BLEDevCache[cacheIndex] );
+      Decoder.decode( advertisedDevice, BLEDevCache[cacheIndex] );
+      BLEDevCache[cacheIndex].uuids = advertisedDevice.getServiceUUIDs();
+      BLEDevCacheSetIndex( cacheIndex );
+      AddressClassCount[BLEDevCache[cacheIndex].addrclass]++;
+      BLEDevCache[cacheIndex].ouiname = "[unpopulated]";
+      uint8_t mdLength;
+      const uint8_t* mdp = advertisedDevice.getManufacturerData( mdLength );
+      if (mdp != NULL && mdLength >= 2) {
         uint8_t vlsb = mdp[0];
         uint8_t vmsb = mdp[1];
-        uint16_t vint = vmsb * 256 + vlsb;
-        if(populate) {
-          BLEDevCache[cacheIndex].vname = DB.getVendor( vint ); // TODO : procrastinate this
-        } else {
-          BLEDevCache[cacheIndex].vname = "[unpopulated]";
-        }
-        BLEDevCache[cacheIndex].vdata = String ( pHex );
+        BLEDevCache[cacheIndex].vendorid = vmsb * 256 + vlsb;
+        BLEDevCache[cacheIndex].vname = "[unpopulated]";
+        BLEDevCache[cacheIndex].vdata = hexString( mdp, mdLength );
       } else {
         BLEDevCache[cacheIndex].vname = "";
         BLEDevCache[cacheIndex].vdata = "";
       }
-      if (advertisedDevice.haveServiceUUID()) {
-        BLEDevCache[cacheIndex].uuid = String( advertisedDevice.getServiceUUID().toString().c_str() );
-      } else {
-        BLEDevCache[cacheIndex].uuid = "";
-      }
       return cacheIndex;          
     }
 
+    /* resolves "[unpopulated]" oui/vendor names (slow, SD Card queries) */
+    static void populate(uint16_t cacheIndex) {
+      if(BLEDevCache[cacheIndex].ouiname == "[unpopulated]"){
+        if( hasOUI( BLEDevCache[cacheIndex].addrclass ) ) {
+          BLEDevCache[cacheIndex].ouiname = DB.getOUI( BLEDevCache[cacheIndex].address );
+        } else {
+          // random address, the lookup would miss anyway
+          OuiLookupsAvoided++;
+          BLEDevCache[cacheIndex].ouiname = "[private]";
+        }
+      }
+      if(BLEDevCache[cacheIndex].vname == "[unpopulated]") {
+        if(BLEDevCache[cacheIndex].vendorid > -1) {
+          BLEDevCache[cacheIndex].vname = DB.getVendor( BLEDevCache[cacheIndex].vendorid );
+        } else {
+          BLEDevCache[cacheIndex].vname = "";
+        }
+      }
+    }
+
 
     void clearNVS() {
-      for(byte i=0;i<MAX_ITEMS_IN_PREFS;i++) {
+      Freezer.clear();
+      Serial.println("Cleared NVS");
+    }
+
+    /* removes the namespaces of the previous freeze format, one per device */
+    void clearLegacyNVS() {
+      for(byte i=0;i<=MAX_ITEMS_IN_PREFS;i++) {
         String freezename = "cache-"+String(i);
-        //Serial.println("Clearing " + freezename);
         preferences.begin(freezename.c_str(), false);
         preferences.clear();
         preferences.end();
       }
-      Serial.println("Cleared NVS");
-    }
-
-    /* store BLECache device in nvram */
-    static byte freeze(byte cacheindex) {
       preferences.begin("BLECollector", false);
-      unsigned int freezecounter = preferences.getUInt("freezecounter", 0);
-      // Increase counter by 1
-      freezecounter++;
-      if (freezecounter > MAX_ITEMS_IN_PREFS ) {
-        freezecounter = 0;
-      }
-      // Store the new counter to the Preferences
-      preferences.putUInt("freezecounter", freezecounter);
+      preferences.remove("freezecounter");
       preferences.end();
+    }
 
-      Serial.printf("****** Freezing cache index %d into pref index %d : %s\n", cacheindex, freezecounter, BLEDevCache[cacheindex].address.c_str());
-      
-      String freezename = "cache-"+String(freezecounter);
-      preferences.begin(freezename.c_str(), false);
-      preferences.putBool("appearance",   BLEDevCache[cacheindex].in_db);
-      preferences.putString("appearance", BLEDevCache[cacheindex].appearance);
-      preferences.putString("name",       BLEDevCache[cacheindex].name);
-      preferences.putString("address",    BLEDevCache[cacheindex].address);
-      preferences.putString("ouiname",    BLEDevCache[cacheindex].ouiname);
-      preferences.putString("rssi",       BLEDevCache[cacheindex].rssi);
-      preferences.putString("vdata",      BLEDevCache[cacheindex].vdata);
-      preferences.putString("vname",      BLEDevCache[cacheindex].vname);
-      preferences.putString("uuid",       BLEDevCache[cacheindex].uuid);
-      preferences.end();
-      return freezecounter;
+    /* log a BLECache device whose DB insertion is pending or failed, to the SD Card or else nvram (by the next Freezer.commit()) */
+    static void freeze(uint16_t cacheindex) {
+      if( Wal.append( BLEDevCache[cacheindex] ) ) return;
+      if( !Freezer.freeze( cacheindex ) ) {
+        Serial.printf("****** Journal full, can't freeze cache index %d : %s\n", cacheindex, BLEDevCache[cacheindex].address.c_str());
+      }
     }
 
-    /* extract BLECache device from nvram into cache */
-    static void thaw(byte freezeindex) {
-      String freezename = "cache-"+String(freezeindex);
-      preferences.begin(freezename.c_str(), true);
-      BLEDevCacheIndex++;
-      BLEDevCacheIndex=BLEDevCacheIndex%BLEDEVCACHE_SIZE;
-      BLEDevCache[BLEDevCacheIndex].reset(); // avoid mixing new and old data
-      BLEDevCache[BLEDevCacheIndex].in_db       = preferences.getBool("in_db", false);
-      BLEDevCache[BLEDevCacheIndex].appearance  = preferences.getString("appearance", "");
-      BLEDevCache[BLEDevCacheIndex].name        = preferences.getString("name", "");
-      BLEDevCache[BLEDevCacheIndex].address     = preferences.getString("address", "");
-      BLEDevCache[BLEDevCacheIndex].ouiname     = preferences.getString("ouiname", "");
-      BLEDevCache[BLEDevCacheIndex].rssi        = preferences.getString("rssi", "");
-      BLEDevCache[BLEDevCacheIndex].vdata       = preferences.getString("vdata", "");
-      BLEDevCache[BLEDevCacheIndex].vname       = preferences.getString("vname", "");
-      BLEDevCache[BLEDevCacheIndex].uuid        = preferences.getString("uuid", "");
-      BLEDevCache[BLEDevCacheIndex].borderColor = WROVER_CYAN;
-      BLEDevCache[BLEDevCacheIndex].textColor   = WROVER_DARKGREY;
-      if(BLEDevCache[BLEDevCacheIndex].address != "") {
-        Serial.printf("****** Thawing pref index %d into cache index %d : %s\n", freezeindex, BLEDevCacheIndex, BLEDevCache[BLEDevCacheIndex].address.c_str());
+    /* extract BLECache device from nvram into cache, returns false if the slot is empty */
+    static bool thaw(byte freezeindex) {
+      BlueToothDevice &BLEDev = BLEDevCache[BLEDevCacheAlloc()];
+      if( !Freezer.thaw( freezeindex, BLEDev ) ) {
+        BLEDev.reset(); // slot stays free
+        return false;
       }
-      preferences.end();
+      BLEDev.borderColor = WROVER_CYAN;
+      BLEDev.textColor   = WROVER_DARKGREY;
+      BLEDevCacheSetIndex( BLEDevCacheIndex );
+      Serial.printf("****** Thawing pref index %d into cache index %d : %s\n", freezeindex, BLEDevCacheIndex, BLEDev.address.c_str());
+      return true;
     }
 
     /* extract all BLECache devices from nvram */
     static void thaw() {
       for(byte i=0;i<MAX_ITEMS_IN_PREFS;i++) {
-        thaw(i);
-        if(BLEDevCache[BLEDevCacheIndex].address!="") {
-          if(BLEDevCache[BLEDevCacheIndex].ouiname == "[unpopulated]"){
-            Serial.println("ouiname-populating " + BLEDevCache[BLEDevCacheIndex].address);
-            BLEDevCache[BLEDevCacheIndex].ouiname = DB.getOUI( BLEDevCache[BLEDevCacheIndex].address );
-          }
-          if(BLEDevCache[BLEDevCacheIndex].vname == "[unpopulated]") {
-            if(BLEDevCache[BLEDevCacheIndex].vdata!="" && BLEDevCache[BLEDevCacheIndex].vdata.length()>=4) {
-              //Serial.println("vname-populating " + BLEDevCache[BLEDevCacheIndex].address);
-              char hex0[3];
-              char hex1[3];
-              strcpy(hex0, BLEDevCache[BLEDevCacheIndex].vdata.substring(0,2).c_str());
-              strcpy(hex1, BLEDevCache[BLEDevCacheIndex].vdata.substring(2,4).c_str());
-              //Serial.printf("  vname-info hex0:%s: hex1:%s\n", hex0, hex1);
-              uint8_t vlsb = strtoul( hex0, nullptr, 16);
-              uint8_t vmsb = strtoul( hex1, nullptr, 16);
-              //Serial.printf("  vname-info lsb:%d msb:%d\n", vlsb, vmsb);
-              uint16_t vint = vmsb * 256 + vlsb;
-              BLEDevCache[BLEDevCacheIndex].vname = DB.getVendor( vint );
-              //Serial.println("  vname: " + BLEDevCache[BLEDevCacheIndex].vname);
-            } else {
-              //Serial.println("vname-clearing " + BLEDevCache[BLEDevCacheIndex].address);
-              BLEDevCache[BLEDevCacheIndex].vname = ""; 
-            }
-          }
-
+        if( thaw(i) ) {
+          populate( BLEDevCacheIndex );
           UI.headerStats("Defrosted "+String(BLEDevCacheIndex)+"#" + String(i));
           UI.printBLECard( BLEDevCache[BLEDevCacheIndex] );
           UI.footerStats();          
@@ -275,182 +264,355 @@ class BLEScanUtils {
     }
 
 
+    /* inserts the devices logged on the SD Card before the restart */
+    static void replayWAL() {
+      if( !Wal.begin() ) return; // nothing logged
+      bool complete = true;
+      uint16_t cacheIndex = BLEDevCacheAlloc();
+      while( Wal.next( BLEDevCache[cacheIndex] ) ) {
+        BLEDevCacheSetIndex( cacheIndex );
+        populate( cacheIndex ); // the filter rules may test the oui/vendor names
+        if(!isAnonymousDevice( cacheIndex )) {
+          DBMessage insertion = DB.upsertBTDevice( cacheIndex );
+          if(insertion == INSERTION_FAILED || insertion == DB_IS_OOM) {
+            complete = false; // keep the log for the next boot
+            break;
+          }
+          BLEDevCache[cacheIndex].in_db = true;
+          if(insertion == INSERTION_SUCCESS) {
+            InsertedCount++;
+            entries++;
+            prune_trigger++;
+          }
+        }
+        Wal.replayed++;
+        UI.headerStats("WAL "+String(Wal.replayed)+"#");
+        cacheIndex = BLEDevCacheAlloc();
+      }
+      Wal.end( complete );
+    }
+
+
     bool feed() {
       bool fed = false;
-      for(int i=0;i<BLEDEVCACHE_SIZE;i++) {
+      for(int i=0;i<BLEDevCacheSize;i++) {
         if(BLEDevCache[i].address == "") continue;
         if(BLEDevCache[i].in_db == true) continue;
         if(isAnonymousDevice( i )) continue;
         Serial.println("####### Feeding thawed " + BLEDevCache[i].address + " to DB");
         if(DB.insertBTDevice( i ) == INSERTION_SUCCESS) {
           fed = true;
-          BLEDevCache[i].in_db == true;
+          BLEDevCache[i].in_db = true;
         }
       }
       return fed;
     }
 
-    static void onScanDone(BLEScanResults foundDevices) {
-      UI.headerStats("Showing results ...");
-      String headerMessage = "                    ";
-      byte cacheIndex;
-      devicesCount = foundDevices.getCount();
-      sessDevicesCount += devicesCount;
-      for (int i = 0; i < devicesCount; i++) {
-        BLEAdvertisedDevice advertisedDevice = foundDevices.getDevice(i);
-        String address = advertisedDevice.getAddress().toString().c_str();
-        if( UI.BLECardIsOnScreen( address ) ) { 
-          // avoid repeating last printed card
-          SelfCacheHit++;
-          UI.headerStats("Ignoring #" + String(i));
-          UI.footerStats();
-          continue;
+    /* inserts a populated new device if the filter wants it, returns false if the DB insertion failed */
+    static bool collect(uint16_t cacheIndex, String &headerMessage) {
+      if(!isAnonymousDevice( cacheIndex )) {
+        unsigned long insertStart = micros();
+        DBMessage insertion = DB.insertBTDevice( cacheIndex );
+        LatencyInsert.add( micros() - insertStart );
+        if(insertion == INSERTION_SUCCESS) {
+          InsertedCount++;
+          entries++;
+          prune_trigger++;
+          newDevicesCount++;
+          BLEDevCache[cacheIndex].in_db = true;
+          BLEDevCache[cacheIndex].textColor = NOT_ANONYMOUS_COLOR;
+          headerMessage = "Inserted "+String(cacheIndex)+"#";
+        } else {
+          // DB Error, journal it in NVS!
+          BLEDevCache[cacheIndex].in_db = false;
+          freeze( cacheIndex );
+          return false;
         }
+      } else {
+        BLEDevCache[cacheIndex].textColor = ANONYMOUS_COLOR;
+        AnonymousCacheHit++;
+        headerMessage = "Anon "+String(cacheIndex)+"#";
+      }
+      return true;
+    }
+
+    /* resolves queued devices names, inserts and renders them, stops when the time budget is spent */
+    static void enrich(unsigned long budget) {
+      unsigned long started = millis();
+      String headerMessage;
+      while( EnrichQueueCount > 0 && millis() - started < budget ) {
+        CollectorLock lock; // released between devices so onScanDone() can get in
+        if( DB.isOOM ) {
+          freezePending(); // will be thawed, populated, inserted and rendered on reboot
+          break;
+        }
+        unsigned long enrichStart = micros();
+        int cacheIndex = EnrichQueuePop(); // under the lock: onScanDone() may have drained the queue meanwhile
+        if( cacheIndex < 0 ) break;
+        populate( cacheIndex );
+        bool collected = collect( cacheIndex, headerMessage );
+        EnrichMicros += micros() - enrichStart;
+        LatencyEnrich.add( micros() - enrichStart );
+        EnrichDone++;
+        if( !collected ) continue;
+        UI.headerStats(headerMessage + String(EnrichQueueCount));
+        UI.printBLECard( BLEDevCache[cacheIndex] );
+        UI.footerStats();
+      }
+      CollectorLock lock;
+      Freezer.commit(); // failed insertions, if any
+    }
+
+    /* moves the unresolved devices from the queue to NVS */
+    static void freezePending() {
+      int cacheIndex;
+      while( (cacheIndex = EnrichQueuePop()) > -1 ) {
+        freeze( cacheIndex );
+      }
+      Freezer.commit();
+    }
+
+    /* one merged record of the scan: cache, filter, clusters, DB lookup, then queued for enrich() or collected now */
+    static void processRecord(BLEAdvertisement &advertisedDevice, int i, int &newFound) {
+      String headerMessage = "                    ";
+      uint16_t cacheIndex;
+      String address = advertisedDevice.getAddress();
+      if( UI.BLECardIsOnScreen( address ) ) { 
+        // avoid repeating last printed card, a table row gets its RSSI updated
+        UI.refreshBLECard( advertisedDevice.mac, advertisedDevice.getRSSI() );
+        Cluster.seen( advertisedDevice.mac, advertisedDevice.getRSSI() );
+        SelfCacheHit++;
+        UI.headerStats("Ignoring #" + String(i));
+        UI.footerStats();
+        return;
+      }
 
-        // make sure it's in cache first
-        int deviceIndexIfExists = getDeviceCacheIndex( address );
+      // make sure it's in cache first
+      int deviceIndexIfExists = getDeviceCacheIndex( address );
+      if(deviceIndexIfExists<0) {
+        // not in cache, drop unwanted devices before any DB lookup
+        parseAdvertisement( advertisedDevice, FilterScratch );
+        if( Filter.evaluate( FilterScratch, FILTER_RESOLVED_RAW ) == FILTER_DROP ) {
+          Filter.tally(); // a keep isn't final, the device is evaluated again once populated
+          FilteredOutCount++;
+          UI.headerStats("Filtered #" + String(i));
+          return;
+        }
+        // rotated address of an already collected device ?
+        if( Cluster.check( advertisedDevice, macToInt(address), FilterScratch.addrclass ) == CLUSTER_ALIAS ) {
+          UI.headerStats("Linked #" + String(i));
+          return;
+        }
+      } else {
+        // keep the cluster of this address active
+        Cluster.check( advertisedDevice, BLEDevCache[deviceIndexIfExists].mac, BLEDevCache[deviceIndexIfExists].addrclass );
+      }
+      if(deviceIndexIfExists>-1) {
+        if(BLEDevCache[deviceIndexIfExists].enrich_pending) {
+          // already queued, will be rendered once enriched
+          return;
+        }
+        // load from cache
+        cacheIndex = deviceIndexIfExists;
+        BLEDevCache[cacheIndex].borderColor = IN_CACHE_COLOR;
+        BLEDevCache[cacheIndex].vdata = ""; // hack to free some heap ? this has already been decoded anyway
+        headerMessage = "Cache "+String(cacheIndex)+"#";
+      } else {
+        if(!DB.isOOM) {
+          deviceIndexIfExists = DB.deviceExists( address ); // will load from DB if necessary
+        }
         if(deviceIndexIfExists>-1) {
-          // load from cache
           cacheIndex = deviceIndexIfExists;
           BLEDevCache[cacheIndex].borderColor = IN_CACHE_COLOR;
-          BLEDevCache[cacheIndex].vdata = ""; // hack to free some heap ? this has already been decoded anyway
-          headerMessage = "Cache "+String(cacheIndex)+"#";
+          BLEDevCache[cacheIndex].textColor = NOT_ANONYMOUS_COLOR;
+          headerMessage = "DB Seen "+String(cacheIndex)+"#";
         } else {
-          if(!DB.isOOM) {
-            deviceIndexIfExists = DB.deviceExists( address ); // will load from DB if necessary
+          newDevicesCount++;
+          newFound++;
+          unsigned long scanPathStart = micros();
+          cacheIndex = store( advertisedDevice ); // store data in cache but don't populate
+          if(DB.isOOM) { // newfound but OOM, gather what's left of data without DB
+            // freeze it partially ...
+            freeze( cacheIndex );
+            // don't render it (will be thawed, populated, inserted and rendered on reboot)
+            return;
           }
-          if(deviceIndexIfExists>-1) {
-            cacheIndex = deviceIndexIfExists;
-            BLEDevCache[cacheIndex].borderColor = IN_CACHE_COLOR;
-            BLEDevCache[cacheIndex].textColor = NOT_ANONYMOUS_COLOR;
-            headerMessage = "DB Seen "+String(cacheIndex)+"#";
-          } else {
-            newDevicesCount++;
-            if(DB.isOOM) { // newfound but OOM, gather what's left of data without DB
-              cacheIndex = store( advertisedDevice, false ); // store data in cache but don't populate
-              // freeze it partially ...
-              byte prefIndex = freeze( cacheIndex );
-              // don't render it (will be thawed, populated, inserted and rendered on reboot)
-              continue;
-            } else { // newfound
-              cacheIndex = store( advertisedDevice ); // store data in cache
-              BLEDevCache[cacheIndex].borderColor = NOT_IN_CACHE_COLOR;
-              if(!isAnonymousDevice( cacheIndex )) {
-                if(DB.insertBTDevice( cacheIndex ) == INSERTION_SUCCESS) {
-                  entries++;
-                  prune_trigger++;
-                  newDevicesCount++;
-                  BLEDevCache[cacheIndex].in_db = true;
-                  BLEDevCache[cacheIndex].textColor = NOT_ANONYMOUS_COLOR;
-                  headerMessage = "Inserted "+String(cacheIndex)+"#";
-                  byte prefIndex = freeze( cacheIndex );
-                } else {
-                  // DB Error, freeze it in NVS!
-                  BLEDevCache[cacheIndex].in_db = false;
-                  byte prefIndex = freeze( cacheIndex );
-                  // don't render it (will be thawed, rendered and inserted on reboot)
-                  continue;
-                }
-
-              } else {
-                BLEDevCache[cacheIndex].textColor = ANONYMOUS_COLOR;
-                AnonymousCacheHit++;
-                headerMessage = "Anon "+String(cacheIndex)+"#";
-              }
-            }
-
+          BLEDevCache[cacheIndex].borderColor = NOT_IN_CACHE_COLOR;
+          if( EnrichQueuePush( cacheIndex ) ) {
+            // names will be resolved, the device inserted and rendered when idle
+            ScanPathMicros += micros() - scanPathStart;
+            ScanPathCount++;
+            LatencyScanPath.add( micros() - scanPathStart );
+            UI.headerStats("Queued "+String(cacheIndex)+"#" + String(i));
+            return;
           }
+          // queue is full, do it now
+          EnrichSync++;
+          populate( cacheIndex );
+          if( !collect( cacheIndex, headerMessage ) ) {
+            // don't render it (will be thawed, rendered and inserted on reboot)
+            return;
+          }
+          ScanPathMicros += micros() - scanPathStart;
+          ScanPathCount++;
+          LatencyScanPath.add( micros() - scanPathStart );
         }
+      }
 
-        /*
-        // check if device is in cache or DB
-        DeviceCacheStatus BLEDevStatus = deviceCacheStatus( address );
+      /*
+      // check if device is in cache or DB
+      DeviceCacheStatus BLEDevStatus = deviceCacheStatus( address );
+      
+      if ( BLEDevStatus.exists && BLEDevStatus.index >=0 ) { // exists in cache (and maybe in DB too)
+        cacheIndex = BLEDevStatus.index;
+        BLEDevCache[cacheIndex].vdata = ""; // hack to free some heap ? this has already been decoded anyway
+        if( isAnonymousDevice( cacheIndex ) ) {
+          BLEDevCache[cacheIndex].borderColor = IN_CACHE_COLOR;
+          BLEDevCache[cacheIndex].textColor = ANONYMOUS_COLOR;
+          //Serial.println("CACHED ANONYMOUS: " + BLEDevCache[cacheIndex].address);
+        } else {
+          BLEDevCache[cacheIndex].borderColor = IN_CACHE_COLOR;
+          BLEDevCache[cacheIndex].textColor = NOT_ANONYMOUS_COLOR;
+          //Serial.println("CACHED NOT ANONYMOUS: " + BLEDevCache[cacheIndex].address);
+        }
+        headerMessage = "Result #";
+      } else { // not in cache, will copy data
         
-        if ( BLEDevStatus.exists && BLEDevStatus.index >=0 ) { // exists in cache (and maybe in DB too)
-          cacheIndex = BLEDevStatus.index;
-          BLEDevCache[cacheIndex].vdata = ""; // hack to free some heap ? this has already been decoded anyway
-          if( isAnonymousDevice( cacheIndex ) ) {
-            BLEDevCache[cacheIndex].borderColor = IN_CACHE_COLOR;
-            BLEDevCache[cacheIndex].textColor = ANONYMOUS_COLOR;
-            //Serial.println("CACHED ANONYMOUS: " + BLEDevCache[cacheIndex].address);
-          } else {
-            BLEDevCache[cacheIndex].borderColor = IN_CACHE_COLOR;
+        if(BLEDevStatus.index == -2 || DB.isOOM) {
+          // OOM occured, store incomplete info in nvram and flag them for completion at reboot
+          cacheIndex = store( advertisedDevice, false ); // store data in cache but don't populate  
+        } else {
+          cacheIndex = store( advertisedDevice ); // store data in cache
+        }
+        byte prefIndex = freeze( cacheIndex );
+
+        if(isAnonymousDevice( cacheIndex )) {
+          BLEDevCache[cacheIndex].borderColor = NOT_IN_CACHE_COLOR;
+          BLEDevCache[cacheIndex].textColor = ANONYMOUS_COLOR;
+          //Serial.println("SKIPPED ANONYMOUS: " + BLEDevCache[cacheIndex].address);
+          headerMessage = "Skipped #";
+          newDevicesCount++;
+          AnonymousCacheHit++;
+        } else {
+          if(DB.insertBTDevice( cacheIndex ) == INSERTION_SUCCESS) {
+            entries++;
+            prune_trigger++;
+            newDevicesCount++;
+            BLEDevCache[cacheIndex].in_db = true;
+            BLEDevCache[cacheIndex].borderColor = NOT_IN_CACHE_COLOR;
             BLEDevCache[cacheIndex].textColor = NOT_ANONYMOUS_COLOR;
-            //Serial.println("CACHED NOT ANONYMOUS: " + BLEDevCache[cacheIndex].address);
+            //Serial.println("INSERTED NON ANONYMOUS: " + BLEDevCache[cacheIndex].address);
+            headerMessage = "Inserted #";
+          } else { // out of memory ?
+            UI.headerStats("DB Error..!");
+            BLEDevCache[cacheIndex].borderColor = WROVER_RED;
+            BLEDevCache[cacheIndex].textColor = WROVER_RED;
+            //Serial.println("FAILED INSERTING NON ANONYMOUS: " + BLEDevCache[cacheIndex].address);
           }
-          headerMessage = "Result #";
-        } else { // not in cache, will copy data
-          
-          if(BLEDevStatus.index == -2 || DB.isOOM) {
-            // OOM occured, store incomplete info in nvram and flag them for completion at reboot
-            cacheIndex = store( advertisedDevice, false ); // store data in cache but don't populate  
-          } else {
-            cacheIndex = store( advertisedDevice ); // store data in cache
-          }
-          byte prefIndex = freeze( cacheIndex );
+        }
+      }*/
+      UI.headerStats(headerMessage + String(i));
+      UI.printBLECard( BLEDevCache[cacheIndex] ); // TODO : procrastinate this
+      UI.footerStats();
+    }
 
-          if(isAnonymousDevice( cacheIndex )) {
-            BLEDevCache[cacheIndex].borderColor = NOT_IN_CACHE_COLOR;
-            BLEDevCache[cacheIndex].textColor = ANONYMOUS_COLOR;
-            //Serial.println("SKIPPED ANONYMOUS: " + BLEDevCache[cacheIndex].address);
-            headerMessage = "Skipped #";
-            newDevicesCount++;
-            AnonymousCacheHit++;
-          } else {
-            if(DB.insertBTDevice( cacheIndex ) == INSERTION_SUCCESS) {
-              entries++;
-              prune_trigger++;
-              newDevicesCount++;
-              BLEDevCache[cacheIndex].in_db = true;
-              BLEDevCache[cacheIndex].borderColor = NOT_IN_CACHE_COLOR;
-              BLEDevCache[cacheIndex].textColor = NOT_ANONYMOUS_COLOR;
-              //Serial.println("INSERTED NON ANONYMOUS: " + BLEDevCache[cacheIndex].address);
-              headerMessage = "Inserted #";
-            } else { // out of memory ?
-              UI.headerStats("DB Error..!");
-              BLEDevCache[cacheIndex].borderColor = WROVER_RED;
-              BLEDevCache[cacheIndex].textColor = WROVER_RED;
-              //Serial.println("FAILED INSERTING NON ANONYMOUS: " + BLEDevCache[cacheIndex].address);
-            }
-          }
-        }*/
-        UI.headerStats(headerMessage + String(i));
-        UI.printBLECard( BLEDevCache[cacheIndex] ); // TODO : procrastinate this
-        UI.footerStats();
+    /* processes the merged advertisement records, foundDevices isn't used: the scan callback filled the merge buffer */
+    static void onScanDone(BLEScanResults foundDevices) {
+      CollectorLock lock;
+      UI.headerStats("Showing results ...");
+      int newFound = 0; // new devices in this scan, for the scheduler
+      Cluster.newScan( scanClock() );
+      devicesCount = MergeBuffer.count;
+      sessDevicesCount += devicesCount;
+      for (int i = 0; i < devicesCount; i++) {
+        processRecord( MergeBuffer.records[i], i, newFound );
       }
       
+      MergeBuffer.clear();
+      BLEDevice::getScan()->clearResults(); // the library's own copy of the results, if it kept any
+      Capture.flush();
+      Freezer.commit(); // failed or OOM-pending devices of this scan
+      Scheduler.update( devicesCount, newFound, EnrichQueueCount );
+      xSemaphoreGive(ScanDone); // the next scan can apply the updated parameters
+
       if( DB.isOOM ) {
+        freezePending();
         Out.println("[DB ERROR] restarting");
         delay(1000);
-        ESP.restart();
+        warmRestart();
       }
       
     }
 
 
-    void scan() {
+    /* one scan and its processing, returns false once the replayed capture is over */
+    bool scan() {
+      // the previous results must have gone through Scheduler.update() before the
+      // next parameters are applied, and its blink task must be over
+      xSemaphoreTake(ScanDone, portMAX_DELAY);
       UI.headerStats("Scan in progress...");
       UI.footerStats();
       // synchronous scan: blink icon and draw time-based scan progress in a separate task
       // while using the callback to update its status in real time
       UI.taskBlink();
-      BLEScan *pBLEScan = BLEDevice::getScan(); //create new scan
-      pBLEScan->setAdvertisedDeviceCallbacks(new FoundDeviceCallback());
-      pBLEScan->setActiveScan(true); //active scan uses more power, but get results faster
-      pBLEScan->setInterval(0x50); // 0x50
-      pBLEScan->setWindow(0x30); // 0x30
-      //BLEScanResults foundDevices = pBLEScan->start(SCAN_TIME);
-      //onScanDone( foundDevices );
-      pBLEScan->start(SCAN_TIME, onScanDone);
+      #ifdef ADV_REPLAY
+        if( !Replay.feed( Scheduler.duration, Scheduler.window, Scheduler.interval, onPacket ) ) {
+          Replay.printSummary( InsertedCount );
+          return false;
+        }
+        onScanDone( BLEScanResults() );
+        // a time budget would make the results depend on the replay speed
+        enrich( REPLAY_SPEED == 0 ? 0xffffffff : ENRICH_BUDGET );
+      #else
+        BLEScan *pBLEScan = BLEDevice::getScan(); //create new scan
+        pBLEScan->setAdvertisedDeviceCallbacks(&FoundDevices, true); // want duplicates: scan responses come as separate packets
+        Scheduler.apply(pBLEScan); // active/passive, interval and window
+        //BLEScanResults foundDevices = pBLEScan->start(Scheduler.duration);
+        //onScanDone( foundDevices );
+        pBLEScan->start(Scheduler.duration, onScanDone);
+        enrich( ENRICH_BUDGET ); // idle while scanning, resolve the names of the previous results
+      #endif
       UI.update(); // run after-scan display stuff
-      DB.maintain(); // check for db pruning
-      Serial.printf("Cache hits -- Cards:%s Self:%s Anonymous:%s, Oui:%s Vendor:%s\n", 
+      {
+        CollectorLock lock;
+        DB.maintain(); // check for db pruning
+        Browser.poll(); // Serial console commands
+      }
+      Serial.printf("Cache hits -- Cards:%s Self:%s Anonymous:%s, Oui:%s Vendor:%s Filtered:%s\n", 
         String(BLEDevCacheHit).c_str(), 
         String(SelfCacheHit).c_str(), 
         String(AnonymousCacheHit).c_str(), 
         String(OuiCacheHit).c_str(), 
-        String(VendorCacheHit).c_str()
+        String(VendorCacheHit).c_str(),
+        String(FilteredOutCount).c_str()
       );
+      Filter.printStats();
+      Cluster.printStats();
+      MergeBuffer.printStats();
+      Decoder.printStats();
+      Capture.printStats();
+      Freezer.printStats();
+      Wal.printStats();
+      Browser.printStats();
+      Metrics.printStats();
+      Serial.printf("Addresses -- public:%d static:%d rpa:%d nrpa:%d unknown:%d, OUI lookups avoided:%d\n",
+        AddressClassCount[ADDR_PUBLIC],
+        AddressClassCount[ADDR_RANDOM_STATIC],
+        AddressClassCount[ADDR_RPA],
+        AddressClassCount[ADDR_NON_RESOLVABLE],
+        AddressClassCount[ADDR_UNKNOWN],
+        OuiLookupsAvoided
+      );
+      Serial.printf("Enrich -- queued:%d done:%d sync:%d pending:%d, scan path:%lu us/device, idle:%lu us/device\n",
+        EnrichQueued,
+        EnrichDone,
+        EnrichSync,
+        EnrichQueueCount,
+        ScanPathCount > 0 ? ScanPathMicros / ScanPathCount : 0,
+        EnrichDone > 0 ? EnrichMicros / EnrichDone : 0
+      );
+      UI.printStats();
+      return true;
     }
 
 };
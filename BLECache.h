@@ -30,13 +30,83 @@
 */
 
 #define BLECARD_MAC_CACHE_SIZE 8 // "virtual" BLE Card cache size, keeps mac addresses to avoid duplicate rendering
-static String lastPrintedMac[BLECARD_MAC_CACHE_SIZE]; // BLECard screen cache, where the mac addresses are stored
+static uint64_t lastPrintedMac[BLECARD_MAC_CACHE_SIZE]; // BLECard screen cache, where the packed mac addresses are stored
 static byte lastPrintedMacIndex = 0; // index in the circular buffer
 
-// TODO: store this in psram
+
+// packs a "aa:bb:cc:dd:ee:ff" mac address into the lower 48 bits of an int
+static uint64_t macToInt(const char* address) {
+  uint64_t mac = 0;
+  byte nibbles = 0;
+  for(const char* c = address; *c && nibbles < 12; c++) {
+    byte val;
+    if     (*c >= '0' && *c <= '9') val = *c - '0';
+    else if(*c >= 'a' && *c <= 'f') val = *c - 'a' + 10;
+    else if(*c >= 'A' && *c <= 'F') val = *c - 'A' + 10;
+    else continue; // separator
+    mac = (mac << 4) | val;
+    nibbles++;
+  }
+  return mac;
+}
+
+static uint64_t macToInt(const String &address) {
+  return macToInt(address.c_str());
+}
+
+
+// address classes, from the advertised address type and the two most significant bits
+enum BLEAddressClass {
+  ADDR_UNKNOWN        = 0, // type not available (e.g. thawed from NVS), treated as public
+  ADDR_PUBLIC         = 1, // IEEE assigned, has an OUI
+  ADDR_RANDOM_STATIC  = 2, // 0b11xxxxxx, fixed until power cycle
+  ADDR_RPA            = 3, // 0b01xxxxxx, resolvable private address, rotates
+  ADDR_NON_RESOLVABLE = 4, // 0b00xxxxxx, rotates
+  ADDR_CLASSES_COUNT
+};
+
+const char* addressClassNames[ADDR_CLASSES_COUNT] = { "unknown", "public", "static", "rpa", "nrpa" };
+static int AddressClassCount[ADDR_CLASSES_COUNT] = {0}; // classified new devices
+static int OuiLookupsAvoided = 0; // random addresses that skipped getOUI()
+
+// addrType is the esp_ble_addr_type_t reported with the advertisement
+static byte classifyAddress(uint64_t mac, uint8_t addrType) {
+  byte addrClass;
+  switch(addrType) {
+    case 0/*BLE_ADDR_TYPE_PUBLIC*/:
+      addrClass = ADDR_PUBLIC;
+    break;
+    case 1/*BLE_ADDR_TYPE_RANDOM*/:
+      switch( (mac >> 46) & 0x03 ) {
+        case 0x03: addrClass = ADDR_RANDOM_STATIC;  break;
+        case 0x01: addrClass = ADDR_RPA;            break;
+        case 0x00: addrClass = ADDR_NON_RESOLVABLE; break;
+        default:   addrClass = ADDR_UNKNOWN;        break; // reserved
+      }
+    break;
+    case 2/*BLE_ADDR_TYPE_RPA_PUBLIC*/:
+    case 3/*BLE_ADDR_TYPE_RPA_RANDOM*/:
+      addrClass = ADDR_RPA;
+    break;
+    default:
+      addrClass = ADDR_UNKNOWN;
+  }
+  return addrClass;
+}
+
+// only public addresses carry an OUI
+static bool hasOUI(byte addrClass) {
+  return addrClass == ADDR_PUBLIC || addrClass == ADDR_UNKNOWN;
+}
+
 
 struct BlueToothDevice {
   //int id;
+  uint64_t mac = 0; // packed address, used as the cache key
+  bool referenced = false; // CLOCK eviction bit, set on every cache hit
+  bool enrich_pending = false; // waiting in the EnrichQueue for oui/vendor names
+  int vendorid = -1; // company id from manufacturer data, -1 if none
+  byte addrclass = ADDR_UNKNOWN; // see BLEAddressClass
   bool in_db = false;
   uint16_t borderColor;
   uint16_t textColor;
@@ -48,10 +118,21 @@ struct BlueToothDevice {
   String vdata = ""; // manufacturer data
   String vname = ""; // manufacturer name (from manufacturer data, see ble-oui.db)
   String uuid = ""; // service uuid
+  String uuids = ""; // all service uuids, comma separated, short form for 16 bits SIG uuids (see blemacuuids table)
+  byte dtype = 0; // decoded payload type, see DecodedType in Decoder.h
+  String did = ""; // decoded id: beacon uuid, eddystone namespace+instance or url
+  uint16_t dmajor = 0; // decoded field, meaning depends on dtype
+  uint16_t dminor = 0; // decoded field, meaning depends on dtype
+  int8_t dpower = 0; // decoded calibrated tx power
   //String spower = "";
   //time_t created_at;
   //time_t updated_at;
   void reset() {
+    mac = 0;
+    referenced = false;
+    enrich_pending = false;
+    vendorid = -1;
+    addrclass = ADDR_UNKNOWN;
     in_db = false;
     borderColor;
     textColor;
@@ -63,6 +144,12 @@ struct BlueToothDevice {
     vdata = "";
     vname = "";
     uuid = "";
+    uuids = "";
+    dtype = 0;
+    did = "";
+    dmajor = 0;
+    dminor = 0;
+    dpower = 0;
     //spower = "";
   }
   void set(String prop, String val) {
@@ -75,7 +162,13 @@ struct BlueToothDevice {
     else if(prop=="rssi")       { rssi = val;       updated = true; }
     else if(prop=="vdata")      { vdata = val;      updated = true; }
     else if(prop=="vname")      { vname = val;      updated = true; }
+    else if(prop=="vprefix")    { vendorid = val.length() == 4 ? strtol(val.substring(2, 4).c_str(), NULL, 16) * 256 + strtol(val.substring(0, 2).c_str(), NULL, 16) : -1; updated = true; } // first bytes of vdata
     else if(prop=="uuid")       { uuid = val;       updated = true; }
+    else if(prop=="dtype")      { dtype = val.toInt();  updated = true; }
+    else if(prop=="did")        { did = val;            updated = true; }
+    else if(prop=="dmajor")     { dmajor = val.toInt(); updated = true; }
+    else if(prop=="dminor")     { dminor = val.toInt(); updated = true; }
+    else if(prop=="dpower")     { dpower = val.toInt(); updated = true; }
     //else if(prop=="spower")     { spower = val;     updated = true; }
     //else if(prop=="created_at") { created_at = val; updated = true; }
     //else if(prop=="updated_at") { created_at = val; updated = true; }
@@ -107,9 +200,278 @@ struct BlueToothDevice {
 #ifndef BLEDEVCACHE_SIZE // override this from Settings.h
 #define BLEDEVCACHE_SIZE 10
 #endif
-static BlueToothDevice BLEDevCache[BLEDEVCACHE_SIZE]; // will store database results here 
-static byte BLEDevCacheIndex = 0; // index in the circular buffer
+#ifndef BLEDEVCACHE_PSRAM_SIZE // override this from Settings.h
+#define BLEDEVCACHE_PSRAM_SIZE 1024
+#endif
+#ifndef ENRICHQUEUE_SIZE // override this from Settings.h
+#define ENRICHQUEUE_SIZE 32
+#endif
+
+
+/*
+ * Open addressing index (linear probing) of the BLEDevCache slots, keyed by
+ * the 48 bits mac address. Table size is a power of two at least twice the
+ * amount of indexed slots so probe sequences stay short.
+ */
+struct MacIndexEntry {
+  uint32_t maclo; // lower 32 bits of the mac address
+  uint16_t machi; // upper 16 bits of the mac address
+  uint16_t slot;  // BLEDevCache index or MACINDEX_EMPTY
+};
+
+#define MACINDEX_EMPTY 0xffff
+
+struct MacIndex {
+  MacIndexEntry *table = NULL;
+  uint32_t mask = 0;
+  uint32_t probes = 0; // statistics: total probes
+  uint32_t lookups = 0; // statistics: total lookups
+
+  bool init(uint32_t capacity, bool usePsram = false) {
+    uint32_t size = 2;
+    while(size < capacity * 2) size <<= 1;
+    if(usePsram) {
+      table = (MacIndexEntry*)ps_malloc(size * sizeof(MacIndexEntry));
+    } else {
+      table = (MacIndexEntry*)malloc(size * sizeof(MacIndexEntry));
+    }
+    if(table == NULL) return false;
+    mask = size - 1;
+    clear();
+    return true;
+  }
+  void clear() {
+    for(uint32_t i=0;i<=mask;i++) table[i].slot = MACINDEX_EMPTY;
+  }
+  static uint32_t hash(uint64_t mac) {
+    // fibonacci hashing, the upper bits are the best mixed
+    return (uint32_t)((mac * 0x9E3779B97F4A7C15ULL) >> 32);
+  }
+  bool matches(uint32_t pos, uint64_t mac) {
+    return table[pos].maclo == (uint32_t)mac && table[pos].machi == (uint16_t)(mac >> 32);
+  }
+  // returns the slot indexed for this mac, or -1 if not found
+  int find(uint64_t mac) {
+    lookups++;
+    uint32_t pos = hash(mac) & mask;
+    while(table[pos].slot != MACINDEX_EMPTY) {
+      probes++;
+      if(matches(pos, mac)) return table[pos].slot;
+      pos = (pos + 1) & mask;
+    }
+    probes++;
+    return -1;
+  }
+  // adds or overwrites the slot for this mac
+  void set(uint64_t mac, uint16_t slot) {
+    uint32_t pos = hash(mac) & mask;
+    while(table[pos].slot != MACINDEX_EMPTY && !matches(pos, mac)) {
+      pos = (pos + 1) & mask;
+    }
+    table[pos].maclo = (uint32_t)mac;
+    table[pos].machi = (uint16_t)(mac >> 32);
+    table[pos].slot  = slot;
+  }
+  // removes the mac only if it still points to this slot (backward shift deletion)
+  void remove(uint64_t mac, uint16_t slot) {
+    uint32_t pos = hash(mac) & mask;
+    while(table[pos].slot != MACINDEX_EMPTY) {
+      if(matches(pos, mac)) break;
+      pos = (pos + 1) & mask;
+    }
+    if(table[pos].slot == MACINDEX_EMPTY || table[pos].slot != slot) return;
+    uint32_t hole = pos;
+    uint32_t next = (pos + 1) & mask;
+    while(table[next].slot != MACINDEX_EMPTY) {
+      uint32_t home = hash( ((uint64_t)table[next].machi << 32) | table[next].maclo ) & mask;
+      // move the entry back if its home position isn't cyclically within (hole, next]
+      if( ((next - home) & mask) >= ((next - hole) & mask) ) {
+        table[hole] = table[next];
+        hole = next;
+      }
+      next = (next + 1) & mask;
+    }
+    table[hole].slot = MACINDEX_EMPTY;
+  }
+};
+
+
+static BlueToothDevice *BLEDevCache = NULL; // will store database results here, allocated by BLEDevCacheInit()
+static uint16_t BLEDevCacheSize = BLEDEVCACHE_SIZE; // actual capacity, bigger when psram is found
+static uint16_t BLEDevCacheIndex = 0; // last allocated slot
+static uint16_t BLEDevCacheHand = 0; // CLOCK hand
+static MacIndex BLEDevCacheMacIndex;
+
+// devices waiting for their oui/vendor names, drained between scans
+static uint16_t EnrichQueue[ENRICHQUEUE_SIZE]; // BLEDevCache slots, pinned while queued
+static uint16_t EnrichQueueHead = 0; // index in the circular buffer
+static uint16_t EnrichQueueCount = 0;
+static int EnrichQueued = 0;
+static int EnrichDone = 0;
+static int EnrichSync = 0; // queue was full, names resolved in the scan path
 
 static int BLEDevCacheHit = 0;
 static int SelfCacheHit = 0;
 static int AnonymousCacheHit = 0;
+
+
+void BLEDevCacheInit() {
+  if(BLEDevCache != NULL) return;
+  bool usePsram = psramFound();
+  if(usePsram) {
+    void *mem = ps_calloc(BLEDEVCACHE_PSRAM_SIZE, sizeof(BlueToothDevice));
+    if(mem != NULL && BLEDevCacheMacIndex.init(BLEDEVCACHE_PSRAM_SIZE, true)) {
+      BLEDevCacheSize = BLEDEVCACHE_PSRAM_SIZE;
+      BLEDevCache = (BlueToothDevice*)mem;
+      for(uint16_t i=0;i<BLEDevCacheSize;i++) new (&BLEDevCache[i]) BlueToothDevice();
+    } else {
+      free(mem);
+      usePsram = false;
+    }
+  }
+  if(!usePsram) {
+    BLEDevCacheSize = BLEDEVCACHE_SIZE;
+    BLEDevCache = new BlueToothDevice[BLEDevCacheSize];
+    BLEDevCacheMacIndex.init(BLEDevCacheSize);
+  }
+  Serial.printf("BLEDevCache: %d slots in %s\n", BLEDevCacheSize, usePsram ? "psram" : "heap");
+}
+
+
+// CLOCK eviction: picks the first slot not referenced since the last sweep, unindexes and resets it
+// slots waiting for enrichment are skipped, EnrichQueuePush() keeps at least half of the cache evictable
+uint16_t BLEDevCacheAlloc() {
+  while(BLEDevCache[BLEDevCacheHand].referenced || BLEDevCache[BLEDevCacheHand].enrich_pending) {
+    BLEDevCache[BLEDevCacheHand].referenced = false; // second chance
+    BLEDevCacheHand = (BLEDevCacheHand + 1) % BLEDevCacheSize;
+  }
+  uint16_t slot = BLEDevCacheHand;
+  BLEDevCacheHand = (BLEDevCacheHand + 1) % BLEDevCacheSize;
+  if(BLEDevCache[slot].mac != 0) {
+    BLEDevCacheMacIndex.remove(BLEDevCache[slot].mac, slot);
+  }
+  BLEDevCache[slot].reset(); // avoid mixing new and old data
+  BLEDevCacheIndex = slot;
+  return slot;
+}
+
+
+// indexes a slot by its address, to be called once the address is populated
+void BLEDevCacheSetIndex(uint16_t slot) {
+  if(BLEDevCache[slot].address == "") return;
+  BLEDevCache[slot].mac = macToInt(BLEDevCache[slot].address);
+  BLEDevCacheMacIndex.set(BLEDevCache[slot].mac, slot);
+}
+
+
+// returns the cache index of a device, or -1 if not found
+int BLEDevCacheFind(uint64_t mac) {
+  int slot = BLEDevCacheMacIndex.find(mac);
+  if(slot > -1) {
+    BLEDevCache[slot].referenced = true;
+  }
+  return slot;
+}
+
+
+// queues a slot for oui/vendor names resolution, returns false if the queue is full
+bool EnrichQueuePush(uint16_t slot) {
+  if(BLEDevCache[slot].enrich_pending) return true; // already queued
+  if(EnrichQueueCount >= ENRICHQUEUE_SIZE || EnrichQueueCount >= BLEDevCacheSize/2) return false;
+  EnrichQueue[(EnrichQueueHead + EnrichQueueCount) % ENRICHQUEUE_SIZE] = slot;
+  EnrichQueueCount++;
+  EnrichQueued++;
+  BLEDevCache[slot].enrich_pending = true;
+  return true;
+}
+
+
+// returns the slot of the next queued device, -1 if the queue is empty
+int EnrichQueuePop() {
+  if(EnrichQueueCount == 0) return -1;
+  uint16_t slot = EnrichQueue[EnrichQueueHead];
+  EnrichQueueHead = (EnrichQueueHead + 1) % ENRICHQUEUE_SIZE;
+  EnrichQueueCount--;
+  BLEDevCache[slot].enrich_pending = false;
+  return slot;
+}
+
+
+/*
+  onScanDone() runs on the BT task while the loop task runs enrich(), the DB
+  maintenance and the browser: both sides alloc BLEDevCache slots, use the EnrichQueue, the
+  BLECollectorDB handle and the Freezer, so they take turns with this lock.
+  enrich() holds it per device, onScanDone() waits for one lookup at most.
+  warmRestart() takes it too so the snapshot doesn't catch a half updated cache.
+*/
+static SemaphoreHandle_t CollectorMutex = NULL;
+static SemaphoreHandle_t ScanDone = NULL; // given by onScanDone(), taken before the next scan starts
+
+// holds the collector for the scope it's declared in, nesting is allowed
+struct CollectorLock {
+  // the mutex is created by BLEScanUtils::init(), a restart before that has nothing to wait for
+  CollectorLock() { if(CollectorMutex) xSemaphoreTakeRecursive(CollectorMutex, portMAX_DELAY); }
+  ~CollectorLock() { if(CollectorMutex) xSemaphoreGiveRecursive(CollectorMutex); }
+};
+
+
+#ifdef BLEDEVCACHE_BENCHMARK
+// compares the legacy linear String scan with the mac index probes, at several
+// index load factors (the cache keeps it under 50%), half hits and half misses
+void BLEDevCacheBenchmark() {
+  const uint16_t sizes[3] = { 16, 256, 4096 }; // index capacity, the table has twice as many entries
+  const byte loads[4] = { 25, 50, 75, 90 }; // percent of the table filled
+  const uint16_t lookups = 1000;
+  char addr[18];
+  Serial.println("[BENCH] entries  load | linear ns/lookup cmp/lookup | hashed ns/lookup probes/lookup");
+  for(byte s=0;s<3;s++) {
+    for(byte l=0;l<4;l++) {
+      MacIndex index;
+      if(!index.init(sizes[s], psramFound())) {
+        Serial.printf("[BENCH] %5d entries: not enough memory\n", sizes[s]);
+        continue;
+      }
+      uint16_t size = ((index.mask + 1) * loads[l]) / 100;
+      String *addresses = new String[size];
+      String *needles = new String[lookups];
+      for(uint16_t i=0;i<size;i++) {
+        uint32_t r = esp_random();
+        sprintf(addr, "%02x:%02x:%02x:%02x:%02x:%02x", (byte)(r>>24), (byte)(r>>16), (byte)(r>>8), (byte)r, (byte)(i>>8), (byte)i);
+        addresses[i] = addr;
+        index.set(macToInt(addr), i);
+      }
+      for(uint16_t n=0;n<lookups;n++) {
+        if(n&1) {
+          needles[n] = addresses[esp_random() % size];
+        } else {
+          uint32_t r = esp_random();
+          sprintf(addr, "%02x:%02x:%02x:%02x:ff:%02x", (byte)(r>>24), (byte)(r>>16), (byte)(r>>8), (byte)r, (byte)n); // never generated above
+          needles[n] = addr;
+        }
+      }
+      uint32_t compares = 0;
+      unsigned long start = micros();
+      for(uint16_t n=0;n<lookups;n++) {
+        for(uint16_t i=0;i<size;i++) {
+          compares++;
+          if(addresses[i] == needles[n]) break;
+        }
+      }
+      unsigned long linear = micros() - start;
+      start = micros();
+      for(uint16_t n=0;n<lookups;n++) {
+        index.find(macToInt(needles[n].c_str()));
+      }
+      unsigned long hashed = micros() - start;
+      Serial.printf("[BENCH] %7d  %3d%% | %16lu %10d.%02d | %16lu %13d.%02d\n",
+        size, loads[l],
+        (linear * 1000) / lookups, compares / lookups, ((compares * 100) / lookups) % 100,
+        (hashed * 1000) / lookups, index.probes / index.lookups, ((index.probes * 100) / index.lookups) % 100
+      );
+      free(index.table);
+      delete[] needles;
+      delete[] addresses;
+    }
+  }
+}
+#endif
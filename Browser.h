@@ -0,0 +1,161 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Paged DB browser, driven from the Serial console between two scans:
+
+    f   first page
+    n   next page
+    p   previous page
+    m   metrics history (see Metrics.h)
+    ?   help
+
+  Pages are BROWSER_PAGE_SIZE rows of blemacs, printed with Out (display +
+  Serial). Pagination is keyset based on the rowid, the table's btree key:
+  only the first and last rowid of the page are kept, and each page is a
+  seek + BROWSER_PAGE_SIZE steps, whatever the table size. Queries are
+  prepared statements with bound keys. The BLECollectorDB handle is shared
+  with the scan callback, poll() is called under the CollectorLock (BLE.h).
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#ifndef BROWSER_PAGE_SIZE // override this from Settings.h
+#define BROWSER_PAGE_SIZE 26 // rows, a screen minus the page title
+#endif
+
+// used by page()
+const char *browserPageQuery = "SELECT rowid, address, rssi, name, vname FROM blemacs WHERE rowid >= ? ORDER BY rowid LIMIT ?;";
+// used by previous(), first rowid of the page before the given one
+const char *browserPrevQuery = "SELECT MIN(rowid) FROM (SELECT rowid FROM blemacs WHERE rowid < ? ORDER BY rowid DESC LIMIT ?);";
+
+
+class BrowserUtils {
+  public:
+
+    uint32_t pages = 0;
+    unsigned long pageMicros = 0;
+
+    // handles the pending Serial commands
+    void poll() {
+      while (Serial.available() > 0) {
+        switch (Serial.read()) {
+          case 'f': page(0); break;
+          case 'n': page(pageLast + 1); break;
+          case 'p': previous(); break;
+          case 'm': Metrics.dump(); break;
+          case '?':
+            Serial.println("[BROWSER] f: first page, n: next page, p: previous page, m: metrics history");
+          break;
+        }
+      }
+    }
+
+    void printStats() {
+      Serial.printf("Browser -- pages:%d query:%lu us/page\n", pages, pages > 0 ? pageMicros / pages : 0);
+    }
+
+  private:
+
+    sqlite3_int64 pageFirst = 0;
+    sqlite3_int64 pageLast = 0;
+
+    // prints BROWSER_PAGE_SIZE rows from the given rowid
+    void page(sqlite3_int64 from) {
+      unsigned long start = micros();
+      sqlite3_stmt *stmt;
+      DB.open(BLE_COLLECTOR_DB);
+      if (sqlite3_prepare_v2(BLECollectorDB, browserPageQuery, -1, &stmt, NULL) != SQLITE_OK) {
+        DB.error(String(sqlite3_errmsg(BLECollectorDB)));
+        DB.close(BLE_COLLECTOR_DB);
+        return;
+      }
+      sqlite3_bind_int64(stmt, 1, from);
+      sqlite3_bind_int(stmt, 2, BROWSER_PAGE_SIZE);
+      DisplayLock lock; // keeps the text color until done
+      tft.setTextColor(WROVER_YELLOW);
+      Out.println(" DB page from #" + String((long)from) + " (" + String(entries) + " entries)");
+      tft.setTextColor(WROVER_GREENYELLOW);
+      byte rows = 0;
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+        sqlite3_int64 rowid = sqlite3_column_int64(stmt, 0);
+        if (rows == 0) pageFirst = rowid;
+        pageLast = rowid;
+        String name = column(stmt, 3);
+        if (name == "") name = column(stmt, 4);
+        Out.println(" " + String((long)rowid) + " " + column(stmt, 1) + " " + column(stmt, 2) + " " + name.substring(0, 10));
+        rows++;
+      }
+      sqlite3_finalize(stmt);
+      DB.close(BLE_COLLECTOR_DB);
+      if (rows == 0) {
+        Out.println(" [end of table]");
+      }
+      tft.setTextColor(WROVER_YELLOW);
+      pageMicros += micros() - start;
+      pages++;
+    }
+
+    void previous() {
+      sqlite3_stmt *stmt;
+      sqlite3_int64 from = 0;
+      DB.open(BLE_COLLECTOR_DB);
+      if (sqlite3_prepare_v2(BLECollectorDB, browserPrevQuery, -1, &stmt, NULL) != SQLITE_OK) {
+        DB.error(String(sqlite3_errmsg(BLECollectorDB)));
+        DB.close(BLE_COLLECTOR_DB);
+        return;
+      }
+      sqlite3_bind_int64(stmt, 1, pageFirst);
+      sqlite3_bind_int(stmt, 2, BROWSER_PAGE_SIZE);
+      if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+        from = sqlite3_column_int64(stmt, 0);
+      }
+      sqlite3_finalize(stmt);
+      DB.close(BLE_COLLECTOR_DB);
+      page(from); // first page when there's nothing before
+    }
+
+    static String column(sqlite3_stmt *stmt, int col) {
+      const unsigned char *text = sqlite3_column_text(stmt, col);
+      return text == NULL ? "" : String((const char*)text);
+    }
+
+};
+
+#else
+
+class BrowserUtils {
+  public:
+    void poll() { };
+    void printStats() { };
+};
+
+#endif
+
+BrowserUtils Browser;
@@ -0,0 +1,194 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Raw advertisement capture, enabled with ADV_CAPTURE in Settings.h.
+
+  Every packet received by the scan callback is appended to CAPTURE_FILE on the
+  SD Card, file layout:
+
+    block 0        "BLECAP" + format version, padded to CAPTURE_BLOCK_SIZE
+    blocks 1..n    records, padded to CAPTURE_BLOCK_SIZE
+
+    record         <length:1> <millis:4> <mac:6> <addr type:1> <rssi:1> <payload length:1> <payload>
+                   (little endian millis, most significant mac byte first)
+                   records never cross a block boundary, a zero length means
+                   the rest of the block is padding
+
+  The scan callback only copies into one of two RAM buffers, a separate task
+  writes the other one. When both are busy the record is dropped and counted,
+  the radio is never blocked by the SD Card.
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#define CAPTURE_FILE "/ble-capture.bin"
+#define CAPTURE_MAGIC "BLECAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_BLOCK_SIZE 512 // SD Card sector
+#ifndef CAPTURE_BUFFER_SIZE // override this from Settings.h
+#define CAPTURE_BUFFER_SIZE 4096 // must be a multiple of CAPTURE_BLOCK_SIZE
+#endif
+#define CAPTURE_HEADER_SIZE 13 // record header, without the length byte
+
+
+class CaptureUtils {
+  public:
+
+    bool enabled = false;
+    uint32_t records = 0;
+    uint32_t dropped = 0; // both buffers were full
+    uint32_t bytesWritten = 0;
+    uint32_t writeErrors = 0;
+
+    void init() {
+      for(byte i=0;i<2;i++) {
+        buffers[i] = psramFound() ? (uint8_t*)ps_malloc(CAPTURE_BUFFER_SIZE) : (uint8_t*)malloc(CAPTURE_BUFFER_SIZE);
+        if(buffers[i] == NULL) {
+          Serial.println("[CAPTURE] Not enough memory, capture disabled");
+          return;
+        }
+      }
+      captureFile = SD_MMC.open(CAPTURE_FILE, FILE_APPEND);
+      if(!captureFile) {
+        Serial.println("[CAPTURE] Can't open " + String(CAPTURE_FILE) + ", capture disabled");
+        return;
+      }
+      size_t size = captureFile.size();
+      if(size % CAPTURE_BLOCK_SIZE != 0) {
+        // interrupted write, realign on the next block
+        memset(buffers[0], 0, CAPTURE_BLOCK_SIZE);
+        captureFile.write(buffers[0], CAPTURE_BLOCK_SIZE - (size % CAPTURE_BLOCK_SIZE));
+      }
+      if(size == 0) {
+        memset(buffers[0], 0, CAPTURE_BLOCK_SIZE);
+        memcpy(buffers[0], CAPTURE_MAGIC, strlen(CAPTURE_MAGIC));
+        buffers[0][strlen(CAPTURE_MAGIC)] = CAPTURE_VERSION;
+        captureFile.write(buffers[0], CAPTURE_BLOCK_SIZE);
+      }
+      captureFile.flush();
+      xTaskCreatePinnedToCore(writerTask, "CaptureWriter", 2048, this, 1, &writer, 1); /* last = Task Core */
+      enabled = true;
+      Serial.println("[CAPTURE] Logging advertisements to " + String(CAPTURE_FILE));
+    }
+
+
+    // called from the scan callback, never waits
+    void add(uint64_t mac, uint8_t addrType, int rssi, const uint8_t *payload, size_t length, uint32_t now) {
+      if(!enabled) return;
+      if(length > 255 - CAPTURE_HEADER_SIZE) length = 255 - CAPTURE_HEADER_SIZE;
+      uint16_t recordLength = 1 + CAPTURE_HEADER_SIZE + length;
+      uint16_t blockLeft = CAPTURE_BLOCK_SIZE - (used % CAPTURE_BLOCK_SIZE);
+      if(recordLength > blockLeft) {
+        // records don't cross blocks, pad to the next one
+        memset(buffers[active] + used, 0, blockLeft);
+        used += blockLeft;
+      }
+      if(used + recordLength > CAPTURE_BUFFER_SIZE) {
+        if(!swap()) {
+          dropped++;
+          return;
+        }
+      }
+      uint8_t *record = buffers[active] + used;
+      record[0] = CAPTURE_HEADER_SIZE + length;
+      for(byte i=0;i<4;i++) record[1+i] = (now >> (8*i)) & 0xff;
+      for(byte i=0;i<6;i++) record[5+i] = (mac >> (8*(5-i))) & 0xff;
+      record[11] = addrType;
+      record[12] = (int8_t)rssi;
+      record[13] = length;
+      memcpy(record + 14, payload, length);
+      used += recordLength;
+      records++;
+    }
+
+
+    // hands the current buffer to the writer, called after each scan so the file doesn't lag too much
+    void flush() {
+      if(!enabled || used == 0) return;
+      swap();
+    }
+
+
+    void printStats() {
+      if(!enabled) return;
+      Serial.printf("Capture -- records:%d dropped:%d written:%d bytes, write errors:%d\n", records, dropped, bytesWritten, writeErrors);
+    }
+
+
+  private:
+
+    uint8_t *buffers[2] = { NULL, NULL };
+    volatile byte active = 0; // buffer being filled
+    volatile int8_t pending = -1; // buffer being written, -1 if none
+    uint16_t pendingLength = 0;
+    uint16_t used = 0;
+    File captureFile;
+    TaskHandle_t writer = NULL;
+
+    // pads the active buffer to the next block and queues it, fails if the writer is still busy
+    bool swap() {
+      if(pending != -1) return false;
+      uint16_t length = ((used + CAPTURE_BLOCK_SIZE - 1) / CAPTURE_BLOCK_SIZE) * CAPTURE_BLOCK_SIZE;
+      memset(buffers[active] + used, 0, length - used);
+      pendingLength = length;
+      pending = active;
+      active ^= 1;
+      used = 0;
+      xTaskNotifyGive(writer);
+      return true;
+    }
+
+    static void writerTask(void *param) {
+      CaptureUtils *capture = (CaptureUtils*)param;
+      while(1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if(capture->pending == -1) continue;
+        size_t written = capture->captureFile.write(capture->buffers[capture->pending], capture->pendingLength);
+        capture->captureFile.flush();
+        if(written != capture->pendingLength) {
+          capture->writeErrors++;
+        }
+        capture->bytesWritten += written;
+        capture->pending = -1;
+      }
+    }
+
+};
+
+#else
+
+class CaptureUtils {
+  public:
+    void init() { };
+};
+
+#endif
+
+CaptureUtils Capture;
@@ -0,0 +1,265 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Rotating address clustering.
+
+  Phones and wearables rotate their random address every ~15mn, each rotation
+  would otherwise look like a new device. Random addresses are fingerprinted
+  from the stable parts of their advertisement (fields layout, name, appearance,
+  service uuid, manufacturer data company id/length/type) and a new address is
+  linked to an existing cluster when:
+    - the fingerprints match
+    - the cluster's current address isn't in this scan's results (it rotated)
+    - that address was heard during the previous CLUSTER_GAP_SCANS scans, a
+      rotation is a handoff, not a reappearance
+    - the RSSI moved by less than CLUSTER_RSSI_DELTA dB since
+    - no other cluster qualifies: two unnamed phones of the same brand have the
+      same fingerprint, an ambiguous address starts its own cluster
+  Only the first address of a cluster reaches the DB, later ones are aliases.
+
+  Linking drops addresses, so it's only enabled with CLUSTER_LINK. Without it
+  the clusters are still tracked and the would-be links counted, every address
+  gets collected: replay a capture (see Replay.h) and compare the counters with
+  the known devices before enabling it.
+
+  test/test_cluster.cpp scores the links against a labeled capture, on 8 seeds:
+  precision 0 to 14%, recall 0 to 7%. Most rotations happen in the middle of a
+  scan, the old address is still in the results and the new one starts its own
+  cluster, and most of the links are people walking by at a scan boundary.
+  It stays off until the heuristic does better there.
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#ifdef CLUSTER_LINK
+  #define CLUSTER_LINKING true
+#else
+  #define CLUSTER_LINKING false
+#endif
+
+#ifndef CLUSTER_SIZE // override this from Settings.h
+#define CLUSTER_SIZE 32
+#endif
+#ifndef CLUSTER_GAP_SCANS // override this from Settings.h
+#define CLUSTER_GAP_SCANS 1 // scans between the last packet of the old address and the new one
+#endif
+#ifndef CLUSTER_RSSI_DELTA // override this from Settings.h
+#define CLUSTER_RSSI_DELTA 10 // dB
+#endif
+
+enum ClusterStatus {
+  CLUSTER_NONE  = 0, // public address or unclustered, process as usual
+  CLUSTER_NEW   = 1, // first address of a logical device, process as usual
+  CLUSTER_SEEN  = 2, // first address seen again, process as usual
+  CLUSTER_ALIAS = 3  // rotated address of a known logical device, skip it
+};
+
+struct ClusterEntry {
+  uint32_t fingerprint = 0;
+  uint64_t firstmac = 0; // address that went to the DB
+  uint64_t lastmac = 0; // current address
+  unsigned long lastseen = 0; // scan time, see newScan()
+  uint32_t lastscan = 0; // scan number
+  int8_t lastrssi = 0;
+  uint16_t rotations = 0;
+};
+
+
+class ClusterUtils {
+  public:
+
+    int created = 0;
+    int linked = 0; // new addresses linked to an existing cluster (or would be, without CLUSTER_LINK)
+    int aliasHits = 0; // known aliases seen again
+    int ambiguous = 0; // new addresses matching more than one cluster, not linked
+    int rssiRejected = 0; // fingerprint and timing matched, not the RSSI
+    #ifdef ADV_REPLAY
+    // every link as it's made, to score them against a labeled capture (see test/test_cluster.cpp)
+    void (*onLink)(uint64_t previous, uint64_t mac) = NULL;
+    #endif
+
+    // now: millis(), or the replay virtual time
+    void newScan(unsigned long now) {
+      scanNumber++;
+      clock = now;
+    }
+
+
+    ClusterStatus check(BLEAdvertisement &advertisedDevice, uint64_t mac, byte addrClass) {
+      if( addrClass != ADDR_RPA && addrClass != ADDR_NON_RESOLVABLE ) return CLUSTER_NONE;
+      int8_t rssi = advertisedDevice.getRSSI();
+      for(byte i=0;i<CLUSTER_SIZE;i++) {
+        if( clusters[i].lastmac == mac && clusters[i].lastseen != 0 ) {
+          touch( i, rssi );
+          if( mac == clusters[i].firstmac ) return CLUSTER_SEEN;
+          aliasHits++;
+          return alias();
+        }
+      }
+      uint32_t fp = fingerprint( advertisedDevice );
+      int victim = -1; // free or least recently seen cluster
+      int candidate = -1;
+      byte candidates = 0;
+      bool rssiMismatch = false;
+      for(byte i=0;i<CLUSTER_SIZE;i++) {
+        if( clusters[i].lastseen == 0 ) {
+          if( victim < 0 || clusters[victim].lastseen != 0 ) victim = i;
+          continue;
+        }
+        if( victim < 0 || ( clusters[victim].lastseen != 0 && clusters[i].lastseen < clusters[victim].lastseen ) ) {
+          victim = i;
+        }
+        if( clusters[i].fingerprint != fp ) continue;
+        if( clusters[i].lastscan == scanNumber ) continue; // already linked during this scan
+        if( scanNumber - clusters[i].lastscan > CLUSTER_GAP_SCANS ) continue; // went quiet too long ago
+        if( MergeBuffer.contains( clusters[i].lastmac ) ) continue; // its address is still active
+        if( abs( rssi - clusters[i].lastrssi ) > CLUSTER_RSSI_DELTA ) {
+          rssiMismatch = true;
+          continue;
+        }
+        candidate = i;
+        candidates++;
+      }
+      if( candidates == 1 ) {
+        #ifdef ADV_REPLAY
+        if( onLink != NULL ) onLink( clusters[candidate].lastmac, mac );
+        #endif
+        clusters[candidate].lastmac = mac;
+        clusters[candidate].rotations++;
+        touch( candidate, rssi );
+        linked++;
+        return alias();
+      }
+      if( candidates > 1 ) {
+        ambiguous++;
+      } else if( rssiMismatch ) {
+        rssiRejected++;
+      }
+      clusters[victim].fingerprint = fp;
+      clusters[victim].firstmac = mac;
+      clusters[victim].lastmac = mac;
+      clusters[victim].rotations = 0;
+      touch( victim, rssi );
+      created++;
+      return CLUSTER_NEW;
+    }
+
+
+    // an address skipped before check() (card on screen) still keeps its cluster's timing
+    void seen(uint64_t mac, int8_t rssi) {
+      for(byte i=0;i<CLUSTER_SIZE;i++) {
+        if( clusters[i].lastmac == mac && clusters[i].lastseen != 0 ) {
+          touch( i, rssi );
+          return;
+        }
+      }
+    }
+
+
+    void printStats() {
+      Serial.printf("Clusters -- created:%d linked:%d aliases seen:%d ambiguous:%d rssi rejected:%d%s\n",
+        created, linked, aliasHits, ambiguous, rssiRejected,
+        CLUSTER_LINKING ? "" : " (not linking)"
+      );
+    }
+
+
+  private:
+
+    ClusterEntry clusters[CLUSTER_SIZE];
+    uint32_t scanNumber = 1;
+    unsigned long clock = 0; // time of the current scan
+
+    void touch(byte i, int8_t rssi) {
+      clusters[i].lastseen = clock;
+      clusters[i].lastscan = scanNumber;
+      clusters[i].lastrssi = rssi;
+    }
+
+    // without CLUSTER_LINK the alias is counted but still collected
+    static ClusterStatus alias() {
+      return CLUSTER_LINKING ? CLUSTER_ALIAS : CLUSTER_SEEN;
+    }
+
+    // FNV-1a
+    static uint32_t hash(uint32_t h, const uint8_t *data, size_t len) {
+      for(size_t i=0;i<len;i++) {
+        h ^= data[i];
+        h *= 16777619;
+      }
+      return h;
+    }
+
+    static uint32_t hash(uint32_t h, String str) {
+      return hash(h, (const uint8_t*)str.c_str(), str.length());
+    }
+
+    uint32_t fingerprint(BLEAdvertisement &advertisedDevice) {
+      uint32_t h = 2166136261;
+      uint8_t layout = (advertisedDevice.haveName()             ? 0x01 : 0)
+                     | (advertisedDevice.haveAppearance()       ? 0x02 : 0)
+                     | (advertisedDevice.haveServiceUUID()      ? 0x04 : 0)
+                     | (advertisedDevice.haveManufacturerData() ? 0x08 : 0)
+                     | (advertisedDevice.haveTXPower()          ? 0x10 : 0);
+      h = hash(h, &layout, 1);
+      if( advertisedDevice.haveName() ) {
+        h = hash(h, advertisedDevice.getName());
+      }
+      if( advertisedDevice.haveAppearance() ) {
+        uint16_t appearance = advertisedDevice.getAppearance();
+        h = hash(h, (const uint8_t*)&appearance, 2);
+      }
+      if( advertisedDevice.haveServiceUUID() ) {
+        h = hash(h, advertisedDevice.getServiceUUID());
+      }
+      uint8_t mdLength;
+      const uint8_t *md = advertisedDevice.getManufacturerData( mdLength );
+      if( md != NULL ) {
+        // company id + first type byte (e.g. Apple Continuity message type) + length, the rest rotates
+        uint8_t prefix[4] = { 0, 0, 0, mdLength };
+        for(byte i=0;i<3 && i<mdLength;i++) prefix[i] = md[i];
+        h = hash(h, prefix, 4);
+      }
+      return h;
+    }
+
+};
+
+#else
+
+class ClusterUtils {
+  public:
+    void newScan(unsigned long now) { };
+    void seen(uint64_t mac, int8_t rssi) { };
+};
+
+#endif
+
+ClusterUtils Cluster;
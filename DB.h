@@ -46,6 +46,11 @@ const char BACKSLASH = '\\'; // used to escape() slashes
 char *colNeedle = 0; // search criteria
 String colValue = ""; // search result
 #define MAX_FIELD_LEN 32 // max chars returned by field
+#ifdef ADV_REPLAY
+  #define BLE_COLLECTOR_DB_FILE "/blemacs-replay.db" // replays start from an empty DB, see Replay.h
+#else
+  #define BLE_COLLECTOR_DB_FILE "/blemacs.db"
+#endif
 
 // all DB queries
 // used by showDataSamples()
@@ -57,16 +62,35 @@ const char *allEntriesQuery   = "SELECT appearance, name, address, ouiname, rssi
 const char *countEntriesQuery = "SELECT count(*) FROM blemacs;";
 // used by resetDB()
 const char *dropTableQuery   = "DROP TABLE IF EXISTS blemacs;";
-const char *createTableQuery = "CREATE TABLE IF NOT EXISTS blemacs(id INTEGER, appearance, name, address, ouiname, rssi, vdata, vname, uuid, spower, hits INTEGER, created_at timestamp NOT NULL DEFAULT current_timestamp, updated_at timestamp NOT NULL DEFAULT current_timestamp);";
-// used by pruneDB()
-const char *pruneTableQuery = "DELETE FROM blemacs WHERE appearance='' AND name='' AND uuid='' AND ouiname='[private]' AND (vname LIKE 'Apple%' or vname='[unknown]')";
+const char *createTableQuery = "CREATE TABLE IF NOT EXISTS blemacs(id INTEGER, appearance, name, address, ouiname, rssi, vdata, vname, uuid, spower, dtype INTEGER, did, dmajor INTEGER, dminor INTEGER, dpower INTEGER, hits INTEGER, created_at timestamp NOT NULL DEFAULT current_timestamp, updated_at timestamp NOT NULL DEFAULT current_timestamp);";
+// used by migrateDB(), adds the tables and columns missing from databases created before them (errors are expected)
+const char *migrateQueries[] = {
+  "ALTER TABLE blemacs ADD COLUMN dtype INTEGER;",
+  "ALTER TABLE blemacs ADD COLUMN did;",
+  "ALTER TABLE blemacs ADD COLUMN dmajor INTEGER;",
+  "ALTER TABLE blemacs ADD COLUMN dminor INTEGER;",
+  "ALTER TABLE blemacs ADD COLUMN dpower INTEGER;",
+  "CREATE INDEX IF NOT EXISTS blemacs_decoded ON blemacs(dtype, did, dmajor, dminor);",
+  // service uuids dictionary, and device <-> uuid links (macid is the blemacs rowid)
+  "CREATE TABLE IF NOT EXISTS bleuuids(id INTEGER PRIMARY KEY, uuid TEXT NOT NULL UNIQUE);",
+  "CREATE TABLE IF NOT EXISTS blemacuuids(macid INTEGER NOT NULL, uuidid INTEGER NOT NULL, UNIQUE(macid, uuidid));",
+  "CREATE INDEX IF NOT EXISTS blemacuuids_uuid ON blemacuuids(uuidid);"
+};
+// used by insertUUIDs()
+const char* insertUUIDQueryTemplate = "INSERT OR IGNORE INTO bleuuids(uuid) VALUES('%s');"
+  "INSERT OR IGNORE INTO blemacuuids(macid, uuidid) SELECT %lld, id FROM bleuuids WHERE uuid='%s';";
+// used by pruneDB(), removes the links of pruned devices
+const char* pruneUUIDsQuery = "DELETE FROM blemacuuids WHERE macid NOT IN (SELECT rowid FROM blemacs);";
+// used by pruneDB(): see Filter.pruneQuery()
 // used by testVendorNames()
 const char *testVendorNamesQuery = "SELECT SUBSTR(vendor,0,32)  FROM 'ble-oui' LIMIT 10";
 // used by testOUI()
 const char *testOUIQuery = "SELECT * FROM 'oui-light' limit 10";
 // used by insertBTDevice()
-const char* insertQueryTemplate = "INSERT INTO blemacs(appearance, name, address, ouiname, rssi, vdata, vname, uuid, spower, hits) VALUES('%s','%s','%s','%s','%s','%s','%s','%s','%s','1')";
+const char* insertQueryTemplate = "INSERT INTO blemacs(appearance, name, address, ouiname, rssi, vdata, vname, uuid, spower, dtype, did, dmajor, dminor, dpower, hits) VALUES('%s','%s','%s','%s','%s','%s','%s','%s','%s',%d,'%s',%d,%d,%d,'1')";
 static char insertQuery[1024]; // stack overflow ? pray that 1024 is enough :D
+// used by upsertBTDevice()
+const char* countAddressQueryTemplate = "SELECT count(*) FROM blemacs WHERE address='%s';";
 
 // used by getVendor()
 #ifndef VENDORCACHE_SIZE // override this from Settings.h
@@ -126,6 +150,11 @@ class DBUtils {
         delay(300);
       }
       sqlite3_initialize();
+      Filter.init(); // load filter rules from the SD Card
+      #ifdef ADV_REPLAY
+        SD_MMC.remove(BLE_COLLECTOR_DB_FILE);
+      #endif
+      migrateDB(); // create the table or add missing columns
       initial_free_heap = freeheap;
       entries = getEntries();
       //resetDB();
@@ -143,6 +172,9 @@ class DBUtils {
         testOUI(); // test oui database
         testVendorNames(); // test vendornames database
         showDataSamples(); // print some of the collected values (WARN: memory hungry)
+        #ifdef BLEDEVCACHE_BENCHMARK
+          BLEDevCacheBenchmark(); // compare linear and hashed cache probes
+        #endif
         // restart after test to clear some memory
         //ESP.restart();
       }
@@ -158,7 +190,7 @@ class DBUtils {
     int open(DBName dbName) {
      int rc;
       switch(dbName) {
-        case BLE_COLLECTOR_DB:    rc = sqlite3_open("/sdcard/blemacs.db", &BLECollectorDB); break;// will be created upon first boot
+        case BLE_COLLECTOR_DB:    rc = sqlite3_open("/sdcard" BLE_COLLECTOR_DB_FILE, &BLECollectorDB); break;// will be created upon first boot
         case MAC_OUI_NAMES_DB:    rc = sqlite3_open("/sdcard/mac-oui-light.db", &OUIVendorsDB); break;// https://code.wireshark.org/review/gitweb?p=wireshark.git;a=blob_plain;f=manuf
         case BLE_VENDOR_NAMES_DB: rc = sqlite3_open("/sdcard/ble-oui.db", &BLEVendorsDB); break;// https://www.bluetooth.com/specifications/assigned-numbers/company-identifiers
         default: Serial.println("Can't open null DB"); UI.dbStateIcon(-1); return rc;
@@ -207,7 +239,7 @@ class DBUtils {
     int deviceExists(String bleDeviceAddress) {
       results = 0;
       open(BLE_COLLECTOR_DB);
-      String requestStr = "SELECT appearance, name, address, ouiname, rssi, vname, uuid FROM blemacs WHERE address='" + bleDeviceAddress + "'";
+      String requestStr = "SELECT appearance, name, address, ouiname, rssi, vname, SUBSTR(vdata,1,4) AS vprefix, uuid, dtype, did, dmajor, dminor, dpower FROM blemacs WHERE address='" + bleDeviceAddress + "'";
       int rc = sqlite3_exec(BLECollectorDB, requestStr.c_str(), BLEDev_db_callback, (void*)dataBLE, &zErrMsg);
       if (rc != SQLITE_OK) {
         error(String(zErrMsg));
@@ -226,15 +258,14 @@ class DBUtils {
     static int BLEDev_db_callback(void *dataBLE, int argc, char **argv, char **azColName) {
       //Serial.println("BLEDev_db_callback");
       results++;
-      BLEDevCacheIndex++;
-      BLEDevCacheIndex = BLEDevCacheIndex % BLEDEVCACHE_SIZE;
-      BLEDevCache[BLEDevCacheIndex].reset(); // avoid mixing new and old data
-      if(results < BLEDEVCACHE_SIZE) {
+      BLEDevCacheAlloc();
+      if(results < BLEDevCacheSize) {
         int i;
         for (i = 0; i < argc; i++) {
           BLEDevCache[BLEDevCacheIndex].set(String(azColName[i]), String(argv[i] ? argv[i] : ""));
           //Serial.printf("BLEDev Set cb %s = %s\n", azColName[i], argv[i] ? argv[i] : "NULL");
         }
+        BLEDevCacheSetIndex( BLEDevCacheIndex );
       } else {
         Serial.println("Device Pool Size Exceeded, ignoring");
       }
@@ -313,7 +344,7 @@ class DBUtils {
     }
 
 
-    DBMessage insertBTDevice(byte cacheindex) {
+    DBMessage insertBTDevice(uint16_t cacheindex) {
       if(isOOM) {
         // cowardly refusing to use DB when OOM
         return DB_IS_OOM;
@@ -338,7 +369,12 @@ class DBUtils {
         escape(BLEDevCache[cacheindex].vdata).c_str(),
         escape(BLEDevCache[cacheindex].vname).c_str(),
         escape(BLEDevCache[cacheindex].uuid).c_str(),
-        ""//escape(bleDevice.spower).c_str()
+        "",//escape(bleDevice.spower).c_str()
+        BLEDevCache[cacheindex].dtype,
+        escape(BLEDevCache[cacheindex].did).c_str(),
+        BLEDevCache[cacheindex].dmajor,
+        BLEDevCache[cacheindex].dminor,
+        BLEDevCache[cacheindex].dpower
       );
       
       int rc = db_exec(BLECollectorDB, insertQuery);
@@ -350,6 +386,7 @@ class DBUtils {
         return INSERTION_FAILED;
       }
       //requestStr = "";
+      insertUUIDs( sqlite3_last_insert_rowid(BLECollectorDB), BLEDevCache[cacheindex].uuids );
       close(BLE_COLLECTOR_DB);
       return INSERTION_SUCCESS;
       /*
@@ -371,6 +408,39 @@ class DBUtils {
     }
 
 
+    // inserts a device unless its address is already in the DB, safe to run twice on the same device
+    DBMessage upsertBTDevice(uint16_t cacheindex) {
+      if(isOOM) {
+        return DB_IS_OOM;
+      }
+      open(BLE_COLLECTOR_DB);
+      sprintf(insertQuery, countAddressQueryTemplate, escape(BLEDevCache[cacheindex].address).c_str());
+      int rc = db_exec(BLECollectorDB, insertQuery, true, (char*)"count(*)");
+      close(BLE_COLLECTOR_DB);
+      if (rc != SQLITE_OK) {
+        return INSERTION_FAILED;
+      }
+      if( atoi(colValue.c_str()) > 0 ) {
+        return INSERTION_IGNORED; // inserted before the restart
+      }
+      return insertBTDevice( cacheindex );
+    }
+
+
+    // links a device to all its service uuids, uuids are dictionary-encoded in bleuuids
+    void insertUUIDs(sqlite3_int64 macid, String uuids) {
+      int start = 0;
+      while(start < (int)uuids.length()) {
+        int end = uuids.indexOf(',', start);
+        if(end < 0) end = uuids.length();
+        String uuid = escape( uuids.substring(start, end) );
+        sprintf(insertQuery, insertUUIDQueryTemplate, uuid.c_str(), (long long)macid, uuid.c_str());
+        db_exec(BLECollectorDB, insertQuery);
+        start = end + 1;
+      }
+    }
+
+
     String getVendor(uint16_t devid) {
       // try fast answer first
       for(int i=0;i<VENDORCACHE_SIZE;i++) {
@@ -431,6 +501,7 @@ class DBUtils {
 
 
     void showDataSamples() {
+      DisplayLock lock; // keeps the text color until done
       open(BLE_COLLECTOR_DB);
       tft.setTextColor(WROVER_YELLOW);
       Out.println(" Collected Named Devices:");
@@ -466,7 +537,7 @@ class DBUtils {
       Out.println();
       Out.println("Re-creating database");
       Out.println();
-      SD_MMC.remove("/blemacs.db");
+      SD_MMC.remove(BLE_COLLECTOR_DB_FILE);
       open(BLE_COLLECTOR_DB);
       db_exec(BLECollectorDB, dropTableQuery);
       db_exec(BLECollectorDB, createTableQuery);
@@ -475,14 +546,39 @@ class DBUtils {
     }
 
 
+    void migrateDB() {
+      open(BLE_COLLECTOR_DB);
+      db_exec(BLECollectorDB, createTableQuery);
+      for(byte i=0;i<sizeof(migrateQueries)/sizeof(migrateQueries[0]);i++) {
+        // no error reporting, "duplicate column name" is the normal case
+        sqlite3_exec(BLECollectorDB, migrateQueries[i], NULL, NULL, NULL);
+      }
+      close(BLE_COLLECTOR_DB);
+    }
+
+
     void pruneDB() {
       unsigned int before_pruning = getEntries();
+      DisplayLock lock; // keeps the text color until done
       tft.setTextColor(WROVER_YELLOW);
       UI.headerStats("Pruning DB");
       tft.setTextColor(WROVER_GREEN);
-      open(BLE_COLLECTOR_DB);
-      db_exec(BLECollectorDB, pruneTableQuery, true);
-      close(BLE_COLLECTOR_DB);
+      String pruneTableQuery = Filter.pruneQuery(); // remove whatever the filter rules would now drop
+      if(pruneTableQuery != "") {
+        sqlite3_stmt *stmt;
+        open(BLE_COLLECTOR_DB);
+        if (sqlite3_prepare_v2(BLECollectorDB, pruneTableQuery.c_str(), -1, &stmt, NULL) == SQLITE_OK) {
+          Filter.bindPruneQuery(stmt);
+          if (sqlite3_step(stmt) != SQLITE_DONE) {
+            error(String(sqlite3_errmsg(BLECollectorDB)));
+          }
+          sqlite3_finalize(stmt);
+          db_exec(BLECollectorDB, pruneUUIDsQuery);
+        } else {
+          error(String(sqlite3_errmsg(BLECollectorDB)));
+        }
+        close(BLE_COLLECTOR_DB);
+      }
       entries = getEntries();
       tft.setTextColor(WROVER_YELLOW);
       prune_trigger = 0;
@@ -492,6 +588,7 @@ class DBUtils {
 
 
     void testVendorNames() {
+      DisplayLock lock; // keeps the text color until done
       open(BLE_VENDOR_NAMES_DB);
       tft.setTextColor(WROVER_YELLOW);
       Out.println();
@@ -515,6 +612,7 @@ class DBUtils {
 
 
     void testOUI() {
+      DisplayLock lock; // keeps the text color until done
       open(MAC_OUI_NAMES_DB);
       tft.setTextColor(WROVER_YELLOW);
       Out.println();
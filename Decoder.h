@@ -0,0 +1,229 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Manufacturer / service data decoders.
+
+  Decoders are registered by company id (manufacturer data) or by 16 bits
+  service uuid (service data) in a small hash table, so dispatching is a single
+  probe. They extract the well known fields into the dtype/did/dmajor/dminor/
+  dpower columns:
+
+    dtype           did                     dmajor          dminor
+    iBeacon         proximity uuid          major           minor
+    Eddystone-UID   namespace + instance
+    Eddystone-URL   url
+    Eddystone-TLM                           battery (mV)    temperature (8.8)
+    Continuity                              message type    first data byte
+    MS-CDP                                  scenario type   device type
+
+  To add a decoder: write a DecoderFunc and registerDecoder() it in init().
+
+*/
+
+enum DecodedType {
+  DECODED_NONE          = 0,
+  DECODED_IBEACON       = 1,
+  DECODED_EDDYSTONE_UID = 2,
+  DECODED_EDDYSTONE_URL = 3,
+  DECODED_EDDYSTONE_TLM = 4,
+  DECODED_CONTINUITY    = 5,
+  DECODED_MS_CDP        = 6,
+  DECODED_TYPES_COUNT
+};
+
+const char* decodedTypeNames[DECODED_TYPES_COUNT] = { "", "iBeacon", "Eddystone-UID", "Eddystone-URL", "Eddystone-TLM", "Continuity", "MS-CDP" };
+
+#ifndef BUILD_NTPMENU_BIN
+
+#define DECODER_SLOTS 16 // power of 2, at most half full
+
+#define COMPANY_ID_APPLE     0x004C
+#define COMPANY_ID_MICROSOFT 0x0006
+#define SERVICE_UUID_EDDYSTONE 0xFEAA
+
+enum DecoderKind {
+  DECODER_COMPANY = 0, // keyed by manufacturer data company id
+  DECODER_SERVICE = 1  // keyed by 16 bits service data uuid
+};
+
+// data starts with the company id or service uuid, returns the DecodedType or DECODED_NONE
+typedef byte (*DecoderFunc)(const uint8_t *data, uint8_t len, BlueToothDevice &BLEDev);
+
+struct DecoderEntry {
+  uint32_t key = 0; // kind << 16 | id
+  DecoderFunc decode = NULL;
+};
+
+
+// 0x4C 0x00 0x02 0x15 <uuid:16> <major:2> <minor:2> <tx:1>
+static byte decodeApple(const uint8_t *data, uint8_t len, BlueToothDevice &BLEDev) {
+  if(len < 4) return DECODED_NONE;
+  if(data[2] == 0x02 && data[3] == 0x15) {
+    if(len < 25) return DECODED_NONE; // truncated iBeacon, not a Continuity message
+    char uuid[37];
+    byte pos = 0;
+    for(byte i=4;i<20;i++) {
+      pos += sprintf(uuid + pos, "%02x", data[i]);
+      if(i == 7 || i == 9 || i == 11 || i == 13) uuid[pos++] = '-';
+    }
+    uuid[pos] = '\0';
+    BLEDev.did    = String(uuid);
+    BLEDev.dmajor = (data[20] << 8) | data[21];
+    BLEDev.dminor = (data[22] << 8) | data[23];
+    BLEDev.dpower = (int8_t)data[24];
+    return DECODED_IBEACON;
+  }
+  // Continuity: <type:1> <length:1> <data...>, only the first message is kept
+  BLEDev.dmajor = data[2];
+  BLEDev.dminor = len > 4 ? data[4] : 0;
+  return DECODED_CONTINUITY;
+}
+
+
+// 0x06 0x00 <scenario:1> <version:3|device type:5> <version|flags:1> <reserved:1> <salt:4> <hash:16>
+static byte decodeMicrosoft(const uint8_t *data, uint8_t len, BlueToothDevice &BLEDev) {
+  if(len < 6) return DECODED_NONE;
+  BLEDev.dmajor = data[2];
+  BLEDev.dminor = data[3] & 0x1f;
+  return DECODED_MS_CDP;
+}
+
+
+static const char* eddystoneSchemes[4] = { "http://www.", "https://www.", "http://", "https://" };
+static const char* eddystoneExpansions[14] = {
+  ".com/", ".org/", ".edu/", ".net/", ".info/", ".biz/", ".gov/",
+  ".com",  ".org",  ".edu",  ".net",  ".info",  ".biz",  ".gov"
+};
+
+// 0xAA 0xFE <frame type:1> <frame data...>
+static byte decodeEddystone(const uint8_t *data, uint8_t len, BlueToothDevice &BLEDev) {
+  if(len < 4) return DECODED_NONE;
+  switch(data[2]) {
+    case 0x00: // UID: <tx:1> <namespace:10> <instance:6>
+      if(len < 20) return DECODED_NONE;
+      BLEDev.dpower = (int8_t)data[3];
+      BLEDev.did    = hexString(data + 4, 16);
+      return DECODED_EDDYSTONE_UID;
+    case 0x10: // URL: <tx:1> <scheme:1> <encoded url...>
+      if(len < 5 || data[4] > 3) return DECODED_NONE;
+      BLEDev.dpower = (int8_t)data[3];
+      BLEDev.did    = eddystoneSchemes[data[4]];
+      for(byte i=5;i<len;i++) {
+        if(data[i] < 14) {
+          BLEDev.did += eddystoneExpansions[data[i]];
+        } else if(data[i] > 0x20 && data[i] < 0x7f) {
+          BLEDev.did += (char)data[i];
+        }
+      }
+      return DECODED_EDDYSTONE_URL;
+    case 0x20: // TLM: <version:1> <battery mV:2> <temperature 8.8:2> <adv count:4> <uptime:4>
+      if(len < 8) return DECODED_NONE;
+      BLEDev.dmajor = (data[4] << 8) | data[5];
+      BLEDev.dminor = (data[6] << 8) | data[7];
+      return DECODED_EDDYSTONE_TLM;
+  }
+  return DECODED_NONE;
+}
+
+
+class DecoderUtils {
+  public:
+
+    uint32_t decodedCount[DECODED_TYPES_COUNT];
+
+    void init() {
+      memset(decodedCount, 0, sizeof(decodedCount));
+      registerDecoder( DECODER_COMPANY, COMPANY_ID_APPLE,       decodeApple );
+      registerDecoder( DECODER_COMPANY, COMPANY_ID_MICROSOFT,   decodeMicrosoft );
+      registerDecoder( DECODER_SERVICE, SERVICE_UUID_EDDYSTONE, decodeEddystone );
+    }
+
+    bool registerDecoder(byte kind, uint16_t id, DecoderFunc decode) {
+      uint32_t key = ((uint32_t)kind << 16) | id;
+      for(byte i=0;i<DECODER_SLOTS;i++) {
+        byte pos = (slot(key) + i) & (DECODER_SLOTS-1);
+        if(decoders[pos].decode == NULL || decoders[pos].key == key) {
+          decoders[pos].key = key;
+          decoders[pos].decode = decode;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // fills the decoded fields of BLEDev from the manufacturer data, or else the service data
+    byte decode(BLEAdvertisement &advertisedDevice, BlueToothDevice &BLEDev) {
+      uint8_t len;
+      const uint8_t *data = advertisedDevice.getManufacturerData( len );
+      if(data != NULL && len >= 2) {
+        BLEDev.dtype = run( DECODER_COMPANY, data, len, BLEDev );
+      }
+      if(BLEDev.dtype == DECODED_NONE) {
+        data = advertisedDevice.getServiceData( len );
+        if(data != NULL && len >= 2) {
+          BLEDev.dtype = run( DECODER_SERVICE, data, len, BLEDev );
+        }
+      }
+      decodedCount[BLEDev.dtype]++;
+      return BLEDev.dtype;
+    }
+
+    void printStats() {
+      String out = "Decoded --";
+      for(byte i=1;i<DECODED_TYPES_COUNT;i++) {
+        out += " " + String(decodedTypeNames[i]) + ":" + String(decodedCount[i]);
+      }
+      out += " none:" + String(decodedCount[DECODED_NONE]);
+      Serial.println(out);
+    }
+
+  private:
+
+    DecoderEntry decoders[DECODER_SLOTS];
+
+    static byte slot(uint32_t key) {
+      return ((key * 0x9E3779B1UL) >> 28) & (DECODER_SLOTS-1);
+    }
+
+    byte run(byte kind, const uint8_t *data, uint8_t len, BlueToothDevice &BLEDev) {
+      uint32_t key = ((uint32_t)kind << 16) | (data[1] << 8) | data[0];
+      for(byte i=0;i<DECODER_SLOTS;i++) {
+        byte pos = (slot(key) + i) & (DECODER_SLOTS-1);
+        if(decoders[pos].decode == NULL) return DECODED_NONE;
+        if(decoders[pos].key == key) return decoders[pos].decode( data, len, BLEDev );
+      }
+      return DECODED_NONE;
+    }
+
+};
+
+
+DecoderUtils Decoder;
+
+#endif
@@ -0,0 +1,206 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Display ownership: draw command rings, render frames and the bus lock.
+
+  The background tasks (scan progress blink, scan callback icon) don't touch
+  the display: they push compact DrawCommands into their own
+  single producer / single consumer ring. The Render task (see UI.h) drains
+  every ring once per DISPLAY_FRAME in a single startWrite()/endWrite()
+  transaction, using the write*() primitives, and advances the hardware
+  scroll and the heap graph (see Metrics.h).
+
+  Text and jpeg rendering (cards, header, footer) stays in the foreground
+  but holds the DisplayLock, so it never interleaves with a frame.
+
+*/
+
+#ifndef DISPLAY_FRAME // override this from Settings.h
+#define DISPLAY_FRAME 16 // milliseconds, render task tick
+#endif
+#define DISPLAY_RING_SIZE 128 // commands, power of 2
+
+enum DisplayProducer {
+  DISPLAY_PRODUCER_BLINK = 0, // blinkBlueIcon task
+  DISPLAY_PRODUCER_SCAN  = 1, // BLE scan callback
+  DISPLAY_PRODUCERS
+};
+
+enum DrawOp {
+  DRAW_FILL_RECT   = 0, // x, y, w, h
+  DRAW_HLINE       = 1, // x, y, w
+  DRAW_VLINE       = 2, // x, y, h
+  DRAW_FILL_CIRCLE = 3, // x, y, radius in w
+  DRAW_CIRCLE      = 4  // x, y, radius in w
+};
+
+struct DrawCommand {
+  uint8_t op;
+  int16_t x, y, w, h;
+  uint16_t color;
+} __attribute__((packed));
+
+
+// lock-free as long as only one task pushes and only the render task pops
+struct DisplayRing {
+  DrawCommand commands[DISPLAY_RING_SIZE];
+  volatile uint16_t head = 0; // written by the producer
+  volatile uint16_t tail = 0; // written by the render task
+  uint32_t dropped = 0;
+
+  bool push(const DrawCommand &command) {
+    if((uint16_t)(head - tail) >= DISPLAY_RING_SIZE) return false;
+    commands[head & (DISPLAY_RING_SIZE-1)] = command;
+    __sync_synchronize(); // command visible before the head moves
+    head++;
+    return true;
+  }
+  bool pop(DrawCommand &command) {
+    if(tail == head) return false;
+    __sync_synchronize();
+    command = commands[tail & (DISPLAY_RING_SIZE-1)];
+    __sync_synchronize(); // slot read before it's handed back
+    tail++;
+    return true;
+  }
+};
+
+
+class DisplayUtils {
+  public:
+
+    TaskHandle_t renderer = NULL;
+    uint32_t frames = 0; // startWrite()/endWrite() transactions
+    uint32_t commands = 0;
+
+    void init() {
+      if(lockHandle == NULL) lockHandle = xSemaphoreCreateRecursiveMutex();
+    }
+
+    void lock() {
+      if(lockHandle != NULL) xSemaphoreTakeRecursive(lockHandle, portMAX_DELAY);
+    }
+    void unlock() {
+      if(lockHandle != NULL) xSemaphoreGiveRecursive(lockHandle);
+    }
+
+    // queues a command, waits for room unless told not to (the scan callback drops instead)
+    bool submit(byte producer, uint8_t op, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color, bool wait = true) {
+      DrawCommand command = { op, x, y, w, h, color };
+      while(!rings[producer].push(command)) {
+        if(!wait || renderer == NULL) {
+          rings[producer].dropped++;
+          return false;
+        }
+        wake();
+        vTaskDelay(1);
+      }
+      wake();
+      return true;
+    }
+
+    void wake() {
+      if(renderer != NULL) xTaskNotifyGive(renderer);
+    }
+
+    // runs the queued commands in one transaction, returns false if there was nothing to draw
+    bool frame() {
+      bool pending = false;
+      for(byte i=0;i<DISPLAY_PRODUCERS;i++) {
+        if(rings[i].head != rings[i].tail) pending = true;
+      }
+      if(!pending) return false;
+      DrawCommand command;
+      lock();
+      tft.startWrite();
+      for(byte i=0;i<DISPLAY_PRODUCERS;i++) {
+        while(rings[i].pop(command)) {
+          run(command);
+          commands++;
+        }
+      }
+      tft.endWrite();
+      unlock();
+      frames++;
+      return true;
+    }
+
+    void printStats() {
+      uint32_t dropped = 0;
+      for(byte i=0;i<DISPLAY_PRODUCERS;i++) dropped += rings[i].dropped;
+      Serial.printf("Display -- frames:%d commands:%d (%d per transaction) dropped:%d\n",
+        frames,
+        commands,
+        frames > 0 ? commands / frames : 0,
+        dropped
+      );
+    }
+
+  private:
+
+    SemaphoreHandle_t lockHandle = NULL;
+    DisplayRing rings[DISPLAY_PRODUCERS];
+
+    // inside startWrite()/endWrite(): only the write*() primitives, the others open their own transaction
+    static void run(DrawCommand &command) {
+      switch(command.op) {
+        case DRAW_FILL_RECT:
+          tft.writeFillRect(command.x, command.y, command.w, command.h, command.color);
+        break;
+        case DRAW_HLINE:
+          tft.writeFastHLine(command.x, command.y, command.w, command.color);
+        break;
+        case DRAW_VLINE:
+          tft.writeFastVLine(command.x, command.y, command.h, command.color);
+        break;
+        case DRAW_FILL_CIRCLE:
+          tft.writeFastVLine(command.x, command.y - command.w, 2 * command.w + 1, command.color);
+          tft.fillCircleHelper(command.x, command.y, command.w, 3, 0, command.color);
+        break;
+        case DRAW_CIRCLE:
+          tft.writePixel(command.x, command.y + command.w, command.color);
+          tft.writePixel(command.x, command.y - command.w, command.color);
+          tft.writePixel(command.x + command.w, command.y, command.color);
+          tft.writePixel(command.x - command.w, command.y, command.color);
+          tft.drawCircleHelper(command.x, command.y, command.w, 0xf, command.color);
+        break;
+      }
+    }
+
+};
+
+
+DisplayUtils Display;
+
+
+// holds the display for the scope it's declared in, nesting is allowed
+struct DisplayLock {
+  DisplayLock() { Display.lock(); }
+  ~DisplayLock() { Display.unlock(); }
+};
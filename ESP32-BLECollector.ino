@@ -32,7 +32,7 @@
     - [mandatory] SD Card breakout (or bundled in Wrover-Kit, M5Stack, LoLinD32 Pro)
     - [mandatory] Micro SD (FAT32 formatted, max 32GB)
     - [mandatory] 'mac-oui-light.db' and 'ble-oui.db' files copied on the Micro SD Card root
-    - [mandatory] ILI9341 320x240 TFT (or bundled in Wrover-Kit, M5Stack, LoLinD32 Pro)
+    - [optional] ILI9341 320x240 TFT (or bundled in Wrover-Kit, M5Stack, LoLinD32 Pro), see "#define UI_PROFILE" in settings.h
     - [optional] I2C RTC Module (see "#define RTC_PROFILE" in settings.h)
 
   Arduino IDE Settings:
@@ -61,5 +61,7 @@ void setup() {
 
 
 void loop() {
-  BLECollector.scan();
+  if( !BLECollector.scan() ) {
+    while(1) yield(); // end of the replayed capture, see Replay.h
+  }
 }
@@ -0,0 +1,411 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Device filter rules, decides whether a device is worth collecting.
+
+  Rules are read from FILTER_RULES_FILE on the SD Card (defaults below if the
+  file is missing), one rule per line, first matching rule wins:
+
+    <keep|drop|skip> [condition] [condition] ...
+
+  keep collects the device, drop and skip don't. pruneDB() also deletes the
+  rows matching a drop rule (and none of the keep rules above it) while skip
+  rules leave the DB alone.
+
+  Conditions (all must match):
+    field             field is not empty
+    !field            field is empty
+    field=value       field equals value
+    field^=value      field starts with value
+    field~=value      field starts with value, ignoring case (SQL LIKE 'value%')
+    !field=value      negation works with any condition
+
+  Fields: name, uuid, appearance, ouiname, vname
+  Values containing spaces must be double quoted: vname="Apple, Inc."
+  A rule without condition always matches.
+
+  Every distinct condition is evaluated once per device into a bitmask,
+  rules are then (mask, expected bits) pairs. A device may be evaluated more
+  than once (raw fields first), only the final decision is counted: see tally().
+
+  The defaults keep what the old isAnonymousDevice() kept and prune what the
+  old pruneTableQuery deleted. They never drop on the raw fields alone: the
+  "[unpopulated]" keeps need the oui/vendor lookups, only a rules file with
+  e.g. "drop name^=Tile" above them filters before the lookups.
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#define FILTER_RULES_FILE "/ble-filter.txt"
+#define FILTER_MAX_CONDITIONS 32 // one bit per condition
+#define FILTER_MAX_RULES 24
+#define FILTER_NO_RULE -1 // evaluate() fell through to the default keep
+#define FILTER_UNDECIDED_RULE -2
+
+enum FilterField {
+  FILTER_NAME       = 0,
+  FILTER_UUID       = 1,
+  FILTER_APPEARANCE = 2,
+  FILTER_OUINAME    = 3,
+  FILTER_VNAME      = 4,
+  FILTER_FIELDS_COUNT
+};
+
+// bitmasks of fields known when evaluating
+#define FILTER_RESOLVED_ALL ((1<<FILTER_FIELDS_COUNT)-1)
+#define FILTER_RESOLVED_RAW ((1<<FILTER_NAME)|(1<<FILTER_UUID)|(1<<FILTER_APPEARANCE)) // from the advertisement only, no lookup
+
+enum FilterOperator {
+  FILTER_PRESENT = 0,
+  FILTER_EQUALS  = 1,
+  FILTER_PREFIX  = 2,
+  FILTER_PREFIX_NOCASE = 3
+};
+
+enum FilterVerdict {
+  FILTER_UNDECIDED = 0, // some condition needs a field that isn't resolved yet
+  FILTER_KEEP      = 1,
+  FILTER_DROP      = 2
+};
+
+const char* filterFieldNames[FILTER_FIELDS_COUNT] = { "name", "uuid", "appearance", "ouiname", "vname" };
+
+// same logic as the original isAnonymousDevice() checks, the drop rules are the original pruneTableQuery
+const char* defaultFilterRules[] = {
+  "keep uuid",                 // uuid's are interesting, let's collect
+  "keep name",                 // has name, let's collect
+  "keep appearance",           // has icon, let's collect
+  "keep ouiname=[unpopulated]",// don't know yet, let's keep
+  "keep vname=[unpopulated]",  // don't know yet, let's keep
+  "drop ouiname=[private] vname~=Apple", // don't care, prune
+  "drop ouiname=[private] vname=[unknown]", // don't care, prune
+  "skip ouiname=[private]",    // don't care
+  "skip !ouiname",             // don't care
+  "skip vname=[unknown]",      // don't care
+  "skip !vname",               // don't care
+  "keep"                       // anonymous but qualified device, let's collect
+};
+
+struct FilterCondition {
+  byte field;
+  byte op;
+  String value;
+};
+
+struct FilterRule {
+  uint32_t mask = 0; // conditions involved
+  uint32_t want = 0; // expected condition bits
+  bool keep = true;
+  bool prune = false; // drop rule, also applied to the DB
+  uint32_t hits = 0;
+};
+
+
+class FilterUtils {
+  public:
+
+    uint32_t defaultHits = 0; // devices that matched no rule (kept)
+    int lastRule = FILTER_NO_RULE; // rule matched by the last evaluate()
+
+    void init() {
+      conditionsCount = 0;
+      rulesCount = 0;
+      File rulesFile = SD_MMC.open(FILTER_RULES_FILE);
+      if(rulesFile && !rulesFile.isDirectory()) {
+        while(rulesFile.available()) {
+          addRule( rulesFile.readStringUntil('\n') );
+        }
+        rulesFile.close();
+        Serial.println("Loaded " + String(rulesCount) + " filter rules from " + String(FILTER_RULES_FILE));
+      } else {
+        for(byte i=0;i<sizeof(defaultFilterRules)/sizeof(defaultFilterRules[0]);i++) {
+          addRule( defaultFilterRules[i] );
+        }
+        Serial.println("Loaded " + String(rulesCount) + " default filter rules");
+      }
+    }
+
+
+    FilterVerdict evaluate(BlueToothDevice &BLEDev, byte resolvedFields = FILTER_RESOLVED_ALL) {
+      uint32_t bits = 0;
+      uint32_t unknown = 0;
+      for(byte i=0;i<conditionsCount;i++) {
+        if( !(resolvedFields & (1<<conditions[i].field)) ) {
+          unknown |= (1UL<<i);
+          continue;
+        }
+        if( matches(conditions[i], BLEDev) ) {
+          bits |= (1UL<<i);
+        }
+      }
+      for(byte i=0;i<rulesCount;i++) {
+        if( rules[i].mask & unknown ) {
+          // can't tell if this rule matches, and it may shadow the next ones
+          lastRule = FILTER_UNDECIDED_RULE;
+          return FILTER_UNDECIDED;
+        }
+        if( (bits & rules[i].mask) == rules[i].want ) {
+          lastRule = i;
+          return rules[i].keep ? FILTER_KEEP : FILTER_DROP;
+        }
+      }
+      lastRule = FILTER_NO_RULE;
+      return FILTER_KEEP;
+    }
+
+
+    // counts the last evaluate() as the final decision for this device
+    void tally() {
+      if( lastRule == FILTER_NO_RULE ) {
+        defaultHits++;
+      } else if( lastRule >= 0 ) {
+        rules[lastRule].hits++;
+      }
+    }
+
+
+    // binds the condition values of pruneQuery(), they're ?NNN parameters numbered by condition
+    void bindPruneQuery(sqlite3_stmt *stmt) {
+      for(byte i=0;i<conditionsCount;i++) {
+        switch( conditions[i].op ) {
+          case FILTER_PRESENT: break;
+          case FILTER_PREFIX_NOCASE: {
+            String pattern = conditions[i].value;
+            pattern.replace("\\", "\\\\");
+            pattern.replace("%", "\\%");
+            pattern.replace("_", "\\_");
+            sqlite3_bind_text(stmt, i+1, (pattern + "%").c_str(), -1, SQLITE_TRANSIENT);
+          }
+          break;
+          default:
+            sqlite3_bind_text(stmt, i+1, conditions[i].value.c_str(), -1, SQLITE_TRANSIENT);
+        }
+      }
+    }
+
+
+    // SQL equivalent of the drop rules, used by pruneDB()
+    String pruneQuery() {
+      String where = "";
+      for(byte i=0;i<rulesCount;i++) {
+        if( rules[i].keep ) {
+          if( rules[i].mask == 0 ) break; // catch-all keep, nothing will be dropped after this
+          continue;
+        }
+        if( !rules[i].prune ) continue; // skip rule
+        String clause = ruleToSQL( rules[i] );
+        for(byte j=0;j<i;j++) {
+          if( rules[j].keep ) {
+            clause += " AND NOT " + ruleToSQL( rules[j] );
+          }
+        }
+        where += (where=="" ? "(" : " OR (") + clause + ")";
+        if( rules[i].mask == 0 ) break; // catch-all drop
+      }
+      if( where == "" ) return "";
+      return "DELETE FROM blemacs WHERE " + where;
+    }
+
+
+    void printStats() {
+      String out = "Filter hits --";
+      for(byte i=0;i<rulesCount;i++) {
+        out += " #" + String(i) + (rules[i].keep ? "+" : rules[i].prune ? "-" : "/") + ":" + String(rules[i].hits);
+      }
+      out += " default:" + String(defaultHits);
+      Serial.println(out);
+    }
+
+
+  private:
+
+    FilterCondition conditions[FILTER_MAX_CONDITIONS];
+    FilterRule rules[FILTER_MAX_RULES];
+    byte conditionsCount = 0;
+    byte rulesCount = 0;
+
+
+    bool matches(FilterCondition &condition, BlueToothDevice &BLEDev) {
+      String *value;
+      switch(condition.field) {
+        case FILTER_NAME:       value = &BLEDev.name;       break;
+        case FILTER_UUID:       value = &BLEDev.uuid;       break;
+        case FILTER_APPEARANCE: value = &BLEDev.appearance; break;
+        case FILTER_OUINAME:    value = &BLEDev.ouiname;    break;
+        case FILTER_VNAME:      value = &BLEDev.vname;      break;
+        default: return false;
+      }
+      switch(condition.op) {
+        case FILTER_PRESENT: return *value != "";
+        case FILTER_EQUALS:  return *value == condition.value;
+        case FILTER_PREFIX:  return value->startsWith( condition.value );
+        case FILTER_PREFIX_NOCASE: return value->length() >= condition.value.length() && value->substring(0, condition.value.length()).equalsIgnoreCase( condition.value );
+      }
+      return false;
+    }
+
+
+    // returns the condition bit, shared by all rules using the same condition
+    int conditionIndex(byte field, byte op, String value) {
+      for(byte i=0;i<conditionsCount;i++) {
+        if(conditions[i].field == field && conditions[i].op == op && conditions[i].value == value) {
+          return i;
+        }
+      }
+      if(conditionsCount >= FILTER_MAX_CONDITIONS) return -1;
+      conditions[conditionsCount].field = field;
+      conditions[conditionsCount].op = op;
+      conditions[conditionsCount].value = value;
+      return conditionsCount++;
+    }
+
+
+    // splits on spaces, double quotes protect spaces
+    String nextToken(String &line, uint16_t &pos) {
+      String token = "";
+      bool quoted = false;
+      while(pos < line.length() && line[pos] == ' ') pos++;
+      while(pos < line.length()) {
+        char c = line[pos++];
+        if(c == '"') {
+          quoted = !quoted;
+        } else if(c == ' ' && !quoted) {
+          break;
+        } else {
+          token += c;
+        }
+      }
+      return token;
+    }
+
+
+    bool addRule(String line) {
+      line.replace("\t", " ");
+      line.replace("\r", "");
+      line.trim();
+      if(line == "" || line.startsWith("#")) return false;
+      if(rulesCount >= FILTER_MAX_RULES) {
+        Serial.println("[FILTER] Too many rules, ignoring: " + line);
+        return false;
+      }
+      FilterRule rule;
+      uint16_t pos = 0;
+      String action = nextToken(line, pos);
+      if(action == "keep") {
+        rule.keep = true;
+      } else if(action == "drop") {
+        rule.keep = false;
+        rule.prune = true;
+      } else if(action == "skip") {
+        rule.keep = false;
+      } else {
+        Serial.println("[FILTER] Invalid action, ignoring: " + line);
+        return false;
+      }
+      String token;
+      while( (token = nextToken(line, pos)) != "" ) {
+        bool negate = token.startsWith("!");
+        if(negate) token = token.substring(1);
+        byte op = FILTER_PRESENT;
+        String fieldName = token;
+        String value = "";
+        int eq = token.indexOf('=');
+        if(eq > 0) {
+          op = FILTER_EQUALS;
+          fieldName = token.substring(0, eq);
+          value = token.substring(eq + 1);
+          if(fieldName.endsWith("^")) {
+            op = FILTER_PREFIX;
+            fieldName = fieldName.substring(0, fieldName.length() - 1);
+          } else if(fieldName.endsWith("~")) {
+            op = FILTER_PREFIX_NOCASE;
+            fieldName = fieldName.substring(0, fieldName.length() - 1);
+          }
+        }
+        int field = -1;
+        for(byte f=0;f<FILTER_FIELDS_COUNT;f++) {
+          if(fieldName == filterFieldNames[f]) field = f;
+        }
+        int bit = field > -1 ? conditionIndex(field, op, value) : -1;
+        if(bit < 0) {
+          Serial.println("[FILTER] Invalid condition '" + token + "', ignoring: " + line);
+          return false;
+        }
+        rule.mask |= (1UL<<bit);
+        if(!negate) rule.want |= (1UL<<bit);
+      }
+      rules[rulesCount++] = rule;
+      return true;
+    }
+
+
+    // values are bound, not pasted: see bindPruneQuery(). The ^= prefix test is
+    // case sensitive and has no wildcards, same as startsWith() in matches().
+    // The sketch never inserts NULLs, a NULL column matches no condition
+    String conditionToSQL(byte index) {
+      FilterCondition &condition = conditions[index];
+      String column = filterFieldNames[condition.field];
+      String param = "?" + String(index + 1);
+      switch(condition.op) {
+        case FILTER_EQUALS: return column + "=" + param;
+        case FILTER_PREFIX: return "SUBSTR(" + column + ",1,LENGTH(" + param + "))=" + param;
+        case FILTER_PREFIX_NOCASE: return column + " LIKE " + param + " ESCAPE '\\'";
+        default:            return column + "!=''";
+      }
+    }
+
+
+    String ruleToSQL(FilterRule &rule) {
+      if(rule.mask == 0) return "(1)";
+      String sql = "";
+      for(byte i=0;i<conditionsCount;i++) {
+        if( !(rule.mask & (1UL<<i)) ) continue;
+        if(sql != "") sql += " AND ";
+        if( rule.want & (1UL<<i) ) {
+          sql += conditionToSQL( i );
+        } else {
+          sql += "NOT " + conditionToSQL( i );
+        }
+      }
+      return "(" + sql + ")";
+    }
+
+};
+
+#else
+
+class FilterUtils {
+  public:
+    void init() { };
+};
+
+#endif
+
+FilterUtils Filter;
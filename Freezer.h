@@ -0,0 +1,294 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Binary device records, and the NVS ring where devices are frozen across
+  restarts.
+
+  A record is a FrozenHeader followed by the device fields: strings are
+  <length:1><chars>, numbers are little endian. The crc covers the fields, the
+  sequence number tells which slot of the ring is the most recent.
+
+  The ring is MAX_ITEMS_IN_PREFS blobs ("d0".."dN") in the FREEZER_NAMESPACE,
+  slot = sequence % MAX_ITEMS_IN_PREFS: one blob written per frozen device.
+
+  It's a write-behind journal of the devices whose DB insertion is pending
+  (OOM) or failed, devices already in the DB are never written. freeze() only
+  stages the cache index, commit() writes the staged devices in one NVS session
+  and then the "durable" watermark: the sequence number of the last record of
+  the batch. Records above the watermark belong to an interrupted batch and are
+  ignored by thaw().
+
+  Wear, counted by test/test_freezer.cpp on the host NVS: a batch of 10 devices
+  is 11 writes and 51 flash entries, 5.1 per device. The previous format (two
+  namespaces, a counter and a key per field) took 10 writes and 18 entries per
+  device.
+
+*/
+
+#define FREEZER_NAMESPACE "freezer"
+#define FREEZER_VERSION 1
+#define FREEZER_RECORD_MAX 512
+#define NVS_ENTRY_SIZE 32 // bytes, NVS page entry
+#define FREEZER_DURABLE_KEY "durable"
+#define FREEZER_NO_WATERMARK 0xffffffff
+
+#define FROZEN_IN_DB 0x01 // flags
+
+struct FrozenHeader {
+  uint8_t version;
+  uint8_t flags;
+  uint16_t length; // fields, without header
+  uint32_t seq;
+  uint32_t crc; // crc32 of the fields
+} __attribute__((packed));
+
+
+// device <-> binary record
+class DeviceRecord {
+  public:
+
+    // returns the record size, strings are truncated to fit FREEZER_RECORD_MAX
+    static uint16_t serialize(BlueToothDevice &BLEDev, uint32_t seq, uint8_t *buf) {
+      FrozenHeader *header = (FrozenHeader*)buf;
+      uint16_t pos = sizeof(FrozenHeader);
+      putString(buf, pos, BLEDev.address);
+      putString(buf, pos, BLEDev.appearance);
+      putString(buf, pos, BLEDev.name);
+      putString(buf, pos, BLEDev.ouiname);
+      putString(buf, pos, BLEDev.rssi);
+      putString(buf, pos, BLEDev.vname);
+      putString(buf, pos, BLEDev.uuid);
+      putString(buf, pos, BLEDev.did);
+      putNumber(buf, pos, BLEDev.vendorid, 2);
+      putNumber(buf, pos, BLEDev.addrclass, 1);
+      putNumber(buf, pos, BLEDev.dtype, 1);
+      putNumber(buf, pos, BLEDev.dmajor, 2);
+      putNumber(buf, pos, BLEDev.dminor, 2);
+      putNumber(buf, pos, (uint8_t)BLEDev.dpower, 1);
+      // longest fields last, they're the ones to be truncated
+      putString(buf, pos, BLEDev.uuids);
+      putString(buf, pos, BLEDev.vdata);
+      header->version = FREEZER_VERSION;
+      header->flags = BLEDev.in_db ? FROZEN_IN_DB : 0;
+      header->length = pos - sizeof(FrozenHeader);
+      header->seq = seq;
+      header->crc = crc32_le(0, buf + sizeof(FrozenHeader), header->length);
+      return pos;
+    }
+
+    // returns false if the record is truncated, corrupted or from another version
+    static bool deserialize(const uint8_t *buf, uint16_t length, BlueToothDevice &BLEDev) {
+      if(!isValid(buf, length)) return false;
+      const FrozenHeader *header = (const FrozenHeader*)buf;
+      uint16_t pos = sizeof(FrozenHeader);
+      uint16_t end = pos + header->length;
+      BLEDev.in_db      = header->flags & FROZEN_IN_DB;
+      BLEDev.address    = getString(buf, pos, end);
+      BLEDev.appearance = getString(buf, pos, end);
+      BLEDev.name       = getString(buf, pos, end);
+      BLEDev.ouiname    = getString(buf, pos, end);
+      BLEDev.rssi       = getString(buf, pos, end);
+      BLEDev.vname      = getString(buf, pos, end);
+      BLEDev.uuid       = getString(buf, pos, end);
+      BLEDev.did        = getString(buf, pos, end);
+      BLEDev.vendorid   = (int16_t)getNumber(buf, pos, end, 2);
+      BLEDev.addrclass  = getNumber(buf, pos, end, 1);
+      BLEDev.dtype      = getNumber(buf, pos, end, 1);
+      BLEDev.dmajor     = getNumber(buf, pos, end, 2);
+      BLEDev.dminor     = getNumber(buf, pos, end, 2);
+      BLEDev.dpower     = (int8_t)getNumber(buf, pos, end, 1);
+      BLEDev.uuids      = getString(buf, pos, end);
+      BLEDev.vdata      = getString(buf, pos, end);
+      return BLEDev.address != "";
+    }
+
+    static bool isValid(const uint8_t *buf, uint16_t length) {
+      if(length < sizeof(FrozenHeader)) return false;
+      const FrozenHeader *header = (const FrozenHeader*)buf;
+      if(header->version != FREEZER_VERSION) return false;
+      if(sizeof(FrozenHeader) + header->length > length) return false;
+      return header->crc == crc32_le(0, buf + sizeof(FrozenHeader), header->length);
+    }
+
+    static uint32_t seq(const uint8_t *buf) {
+      return ((const FrozenHeader*)buf)->seq;
+    }
+
+  private:
+
+    static void putString(uint8_t *buf, uint16_t &pos, String &str) {
+      if(pos >= FREEZER_RECORD_MAX) return;
+      uint16_t len = str.length();
+      if(len > 255) len = 255;
+      if(len > FREEZER_RECORD_MAX - pos - 1) len = FREEZER_RECORD_MAX - pos - 1;
+      buf[pos++] = len;
+      memcpy(buf + pos, str.c_str(), len);
+      pos += len;
+    }
+
+    static void putNumber(uint8_t *buf, uint16_t &pos, uint32_t value, byte size) {
+      if(pos + size > FREEZER_RECORD_MAX) return;
+      for(byte i=0;i<size;i++) buf[pos++] = (value >> (8*i)) & 0xff;
+    }
+
+    static String getString(const uint8_t *buf, uint16_t &pos, uint16_t end) {
+      if(pos >= end) return "";
+      uint8_t len = buf[pos++];
+      if(pos + len > end) len = end - pos;
+      char str[256];
+      memcpy(str, buf + pos, len);
+      str[len] = '\0';
+      pos += len;
+      return String(str);
+    }
+
+    static uint32_t getNumber(const uint8_t *buf, uint16_t &pos, uint16_t end, byte size) {
+      uint32_t value = 0;
+      for(byte i=0;i<size && pos<end;i++) value |= (uint32_t)buf[pos++] << (8*i);
+      return value;
+    }
+
+};
+
+
+class FreezerUtils {
+  public:
+
+    uint32_t freezes = 0; // devices written
+    uint32_t commits = 0; // NVS sessions
+    uint32_t lost = 0; // staged devices evicted from the cache before the commit
+    uint32_t nvsWrites = 0; // put* calls
+    uint32_t nvsEntries = 0; // estimated 32 bytes flash entries written
+
+    // queues a device for the next commit, returns false if the batch is full
+    bool freeze(uint16_t cacheIndex) {
+      for(byte i=0;i<stagedCount;i++) {
+        if(staged[i] == cacheIndex) return true;
+      }
+      if(stagedCount >= MAX_ITEMS_IN_PREFS) return false;
+      staged[stagedCount] = cacheIndex;
+      stagedMacs[stagedCount] = BLEDevCache[cacheIndex].mac;
+      stagedCount++;
+      return true;
+    }
+
+    // writes the staged devices and moves the durable watermark, no NVS access when nothing is staged
+    void commit() {
+      if(stagedCount == 0) return;
+      uint8_t buf[FREEZER_RECORD_MAX];
+      bool written = false;
+      preferences.begin(FREEZER_NAMESPACE, false);
+      for(byte i=0;i<stagedCount;i++) {
+        BlueToothDevice &BLEDev = BLEDevCache[staged[i]];
+        if(BLEDev.mac != stagedMacs[i] || BLEDev.in_db) {
+          if(!BLEDev.in_db) lost++; // slot was recycled
+          continue;
+        }
+        uint16_t length = DeviceRecord::serialize(BLEDev, nextSeq, buf);
+        byte slot = nextSeq % MAX_ITEMS_IN_PREFS;
+        preferences.putBytes(slotKey(slot).c_str(), buf, length);
+        Serial.printf("****** Freezing cache index %d into pref index %d : %s\n", staged[i], slot, BLEDev.address.c_str());
+        nextSeq++;
+        freezes++;
+        nvsWrites++;
+        nvsEntries += 2 + (length + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE; // blob index + data header + data
+        written = true;
+      }
+      if(written) {
+        preferences.putUInt(FREEZER_DURABLE_KEY, nextSeq - 1);
+        nvsWrites++;
+        nvsEntries++;
+        commits++;
+      }
+      preferences.end();
+      stagedCount = 0;
+    }
+
+    // reads a slot, returns false if it's empty, invalid or above the durable watermark
+    bool thaw(byte slot, BlueToothDevice &BLEDev) {
+      uint8_t buf[FREEZER_RECORD_MAX];
+      preferences.begin(FREEZER_NAMESPACE, true);
+      uint32_t durable = preferences.getUInt(FREEZER_DURABLE_KEY, FREEZER_NO_WATERMARK);
+      if(durable == FREEZER_NO_WATERMARK) {
+        preferences.end();
+        return false; // nothing was ever committed
+      }
+      size_t length = preferences.getBytesLength(slotKey(slot).c_str());
+      if(length == 0 || length > FREEZER_RECORD_MAX) {
+        preferences.end();
+        return false;
+      }
+      preferences.getBytes(slotKey(slot).c_str(), buf, length);
+      preferences.end();
+      if(!DeviceRecord::isValid(buf, length)) {
+        Serial.printf("[FREEZER] Ignoring invalid record in slot %d\n", slot);
+        return false;
+      }
+      if(DeviceRecord::seq(buf) > durable) {
+        Serial.printf("[FREEZER] Ignoring uncommitted record in slot %d\n", slot);
+        return false;
+      }
+      // keep writing after the most recent record
+      if(DeviceRecord::seq(buf) >= nextSeq) nextSeq = DeviceRecord::seq(buf) + 1;
+      return DeviceRecord::deserialize(buf, length, BLEDev);
+    }
+
+    void clear() {
+      stagedCount = 0;
+      preferences.begin(FREEZER_NAMESPACE, false);
+      preferences.clear();
+      preferences.end();
+    }
+
+    void printStats() {
+      Serial.printf("NVS -- freezes:%d commits:%d lost:%d writes:%d entries:~%d (%d per device)\n",
+        freezes,
+        commits,
+        lost,
+        nvsWrites,
+        nvsEntries,
+        freezes > 0 ? nvsEntries / freezes : 0
+      );
+    }
+
+  private:
+
+    uint32_t nextSeq = 0;
+    uint16_t staged[MAX_ITEMS_IN_PREFS];
+    uint64_t stagedMacs[MAX_ITEMS_IN_PREFS]; // to detect recycled cache slots
+    byte stagedCount = 0;
+
+    static String slotKey(byte slot) {
+      return "d" + String(slot);
+    }
+
+};
+
+
+FreezerUtils Freezer;
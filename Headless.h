@@ -0,0 +1,105 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Display stand-ins for UI_PROFILE UI_HEADLESS (see Settings.h).
+
+  The code shared with the TFT profile (DB.h, TimeUtils.h, SDUpdater.h, BLE.h)
+  keeps calling tft, Out, Display and DisplayLock: here they're empty inline
+  methods the compiler drops, except Out.println() which still goes to
+  Serial. No GFX library is linked.
+
+*/
+
+// same values as the WROVER_KIT_LCD library
+#define WROVER_BLACK       0x0000
+#define WROVER_DARKGREEN   0x03E0
+#define WROVER_DARKGREY    0x7BEF
+#define WROVER_GREEN       0x07E0
+#define WROVER_CYAN        0x07FF
+#define WROVER_RED         0xF800
+#define WROVER_PINK        0xF81F
+#define WROVER_YELLOW      0xFFE0
+#define WROVER_WHITE       0xFFFF
+#define WROVER_GREENYELLOW 0xAFE5
+
+enum DisplayProducer {
+  DISPLAY_PRODUCER_BLINK = 0,
+  DISPLAY_PRODUCER_SCAN  = 1,
+  DISPLAY_PRODUCERS
+};
+
+
+class HeadlessLCD : public Print {
+  public:
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *buffer, size_t size) { return size; }
+    uint16_t color565(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3); }
+    int16_t width() { return 0; }
+    int16_t height() { return 0; }
+    int16_t getCursorX() { return 0; }
+    int16_t getCursorY() { return 0; }
+    void setCursor(int16_t x, int16_t y) { }
+    void setTextColor(uint16_t color) { }
+    void setTextColor(uint16_t color, uint16_t bgcolor) { }
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { }
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { }
+};
+
+HeadlessLCD tft;
+
+
+class DisplayUtils {
+  public:
+    void wake() { };
+    void printStats() { };
+};
+
+DisplayUtils Display;
+
+struct DisplayLock {
+  DisplayLock() { }
+};
+
+
+const String SPACE = " ";
+
+class ScrollableOutput {
+  public:
+    int println(String str = " ") {
+      return print(str + "\n");
+    }
+    int print(String str) {
+      if(str!=" \n") {
+        Serial.print( str );
+      }
+      return 0;
+    }
+};
+
+ScrollableOutput Out;
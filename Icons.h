@@ -0,0 +1,125 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  RGB565 icon atlas, generated from Assets.h by tools/make_icons.py, don't edit.
+
+*/
+
+enum IconId {
+  ICON_NIC       = 0, // nic16_jpeg
+  ICON_NAME      = 1, // name_jpeg
+  ICON_INSERT    = 2, // insert_jpeg
+  ICON_UPDATE    = 3, // update_jpeg
+  ICON_SERVICE   = 4, // service_jpeg
+  ICON_GENERIC   = 5, // generic_jpeg
+  ICON_APPLE     = 6, // apple16_jpeg
+  ICON_IBM       = 7, // ibm8_jpg
+  ICON_MICROSOFT = 8, // crosoft_jpeg
+  ICONS_COUNT
+};
+
+struct IconRect {
+  uint16_t offset; // in iconAtlas
+  uint8_t width;
+  uint8_t height;
+};
+
+const IconRect iconRects[ICONS_COUNT] = {
+  {    0, 13, 8 }, // ICON_NIC
+  {  104,  7, 8 }, // ICON_NAME
+  {  160,  8, 8 }, // ICON_INSERT
+  {  224,  8, 8 }, // ICON_UPDATE
+  {  288,  8, 8 }, // ICON_SERVICE
+  {  352,  8, 8 }, // ICON_GENERIC
+  {  416,  8, 8 }, // ICON_APPLE
+  {  480, 20, 8 }, // ICON_IBM
+  {  640,  8, 8 }, // ICON_MICROSOFT
+};
+
+const uint16_t iconAtlas[704] PROGMEM = {
+  0x0040, 0x0060, 0x0160, 0x2ba5, 0x3326, 0x00e0, 0x0040, 0x0020, 0x0000, 0x0000, 0x0000, 0x0000,
+  0x0000, 0x00a0, 0x2ae4, 0x54e9, 0x3427, 0x2b26, 0x3b48, 0x2264, 0x00a0, 0x0040, 0x0020, 0x0000,
+  0x0000, 0x0000, 0x0180, 0x44a7, 0x5e0b, 0x664d, 0x3428, 0x446a, 0x6e4f, 0x3cc8, 0x0a61, 0x00a0,
+  0x0040, 0x0000, 0x0000, 0x3382, 0x7e2c, 0x65e9, 0x55c9, 0x556a, 0x6e6e, 0x45a9, 0x3d88, 0x4d49,
+  0x3c27, 0x0180, 0x0060, 0x0040, 0x1a00, 0x5c46, 0x7d88, 0x7e48, 0x5de7, 0x45a6, 0x2d25, 0x0300,
+  0x3d26, 0x4507, 0x1362, 0x23a4, 0x0160, 0x0040, 0x00e0, 0x4301, 0x5ca4, 0x65e7, 0x5e08, 0x4548,
+  0x34c6, 0x2ca5, 0x0320, 0x2484, 0x4528, 0x550a, 0x0000, 0x0020, 0x0020, 0x0940, 0x3364, 0x54c9,
+  0x01e0, 0x12e3, 0x2445, 0x3527, 0x5e4c, 0x5dec, 0x1262, 0x0000, 0x0000, 0x0000, 0x0020, 0x0080,
+  0x00a0, 0x0080, 0x00a0, 0x01e0, 0x1c44, 0x0be2, 0x0140, 0x00a0, 0x0000, 0x0801, 0x612c, 0xa2f5,
+  0x594b, 0x0802, 0x0000, 0x0000, 0x1002, 0xab96, 0xbb97, 0xabb5, 0x1803, 0x0000, 0x0000, 0x1803,
+  0xb397, 0xbb78, 0xabb6, 0x1804, 0x0000, 0x0801, 0x1002, 0x81f1, 0xbb78, 0x8211, 0x1803, 0x0801,
+  0x1003, 0x7a50, 0x9ab4, 0x8191, 0xa295, 0x8a72, 0x1003, 0x50ab, 0xb397, 0xbb78, 0xc359, 0xc359,
+  0xbb78, 0x594c, 0x9233, 0xbb78, 0xc359, 0xc339, 0xc339, 0xc359, 0xa2b5, 0xaa96, 0xbb18, 0xc319,
+  0xc319, 0xc319, 0xc318, 0xbb18, 0x9c70, 0x5a89, 0x0000, 0x0000, 0x0800, 0x0800, 0x0800, 0x0000,
+  0x9c90, 0x0800, 0x1000, 0x1000, 0x1800, 0x72c8, 0x2080, 0x0800, 0x9c70, 0x1800, 0x6a04, 0xa327,
+  0xab68, 0xab69, 0x9349, 0x2040, 0xa470, 0x4142, 0xa389, 0x8a44, 0x79e2, 0xa348, 0x6a45, 0x1800,
+  0xa46f, 0x4963, 0x59c4, 0x1800, 0x1800, 0x4184, 0x1000, 0x0800, 0xa46f, 0x2060, 0x3943, 0x1000,
+  0x0800, 0x0000, 0x0000, 0x0000, 0x9c90, 0x0800, 0x1020, 0x0800, 0x0800, 0x0800, 0x0800, 0x5aa9,
+  0x9c70, 0x9cb1, 0x9c91, 0x9c91, 0x9cb1, 0x9c91, 0x9cb1, 0x9c90, 0x0000, 0x10a2, 0x94b2, 0xdedb,
+  0xdefb, 0x9cf3, 0x630c, 0x94b2, 0x10a2, 0xdefb, 0xdefb, 0x7bcf, 0x73ae, 0xe71c, 0xffff, 0xa514,
+  0x94b2, 0xdefb, 0x1082, 0x0000, 0x39c7, 0xf7be, 0xffff, 0xa514, 0xdefb, 0x7bcf, 0x0000, 0x0000,
+  0x0000, 0x0861, 0x2104, 0x39c7, 0x39c7, 0x2104, 0x0861, 0x0000, 0x0000, 0x0000, 0x7bcf, 0xdefb,
+  0xa514, 0xffff, 0xf7be, 0x39c7, 0x0000, 0x1082, 0xdefb, 0x94b2, 0xa514, 0xffff, 0xe71c, 0x73ae,
+  0x7bcf, 0xdefb, 0xdefb, 0x10a2, 0x94b2, 0x630c, 0x9cf3, 0xdefb, 0xdedb, 0x94b2, 0x10a2, 0x0000,
+  0x0800, 0x1000, 0x6164, 0x4840, 0x9288, 0x2800, 0x1800, 0x1000, 0x1800, 0x40e3, 0x8aea, 0x79e6,
+  0x79e6, 0x8aca, 0x7248, 0x1800, 0x3840, 0x932b, 0x3881, 0x4102, 0x4103, 0x3040, 0x8288, 0x50c1,
+  0x6102, 0x7a27, 0x3040, 0x30c2, 0x30c2, 0x3040, 0x71e6, 0x6963, 0x6102, 0x7a27, 0x1800, 0x4144,
+  0x4144, 0x1800, 0x71e6, 0x6963, 0x3840, 0x932b, 0x3080, 0x30a1, 0x3081, 0x3040, 0x8289, 0x50c1,
+  0x1800, 0x40e3, 0x8aea, 0x7a06, 0x71e6, 0x8aca, 0x7248, 0x1800, 0x0800, 0x1000, 0x6164, 0x4840,
+  0x9288, 0x2800, 0x1800, 0x1000, 0x0064, 0x0128, 0x0291, 0x0396, 0x0376, 0x0270, 0x0127, 0x0083,
+  0x52cb, 0x6432, 0x3c75, 0x2cb7, 0x24d6, 0x2cd4, 0x44b0, 0x33ab, 0x69a2, 0x93cb, 0x7d10, 0x6592,
+  0x55d1, 0x5e30, 0x6dcb, 0x3be2, 0x6080, 0x9ae5, 0x9c49, 0x9dac, 0x9f4f, 0x7ecb, 0x6d66, 0x2300,
+  0x4800, 0x9223, 0xb323, 0xbca4, 0xbee8, 0x8624, 0x64c4, 0x0a00, 0x2800, 0x6940, 0xaa61, 0xbbc1,
+  0xc625, 0x8562, 0x4ba2, 0x00c0, 0x0800, 0x1800, 0x6960, 0x9b23, 0xad88, 0x5bc1, 0x0080, 0x0020,
+  0x0000, 0x0800, 0x2800, 0x6180, 0x6341, 0x00a0, 0x0020, 0x0000, 0x0040, 0x0060, 0x0080, 0x0100,
+  0x5468, 0x01a0, 0x0080, 0x0060, 0x10a0, 0x7bc7, 0x94a9, 0x63a3, 0x5b81, 0x84c8, 0x84ab, 0x21a1,
+  0xb3e1, 0xe5a7, 0xeda6, 0xeda6, 0xe5c5, 0xddc8, 0xbd0a, 0x1860, 0xe443, 0xec64, 0xec63, 0xf463,
+  0xec63, 0xe465, 0x92c3, 0x2000, 0xca85, 0xd2a6, 0xd2a6, 0xdaa6, 0xdaa6, 0xcaa7, 0xa227, 0x3800,
+  0x80c4, 0xa1e9, 0xa1ea, 0xa1ea, 0xa1ea, 0x99ea, 0x922b, 0x7148, 0x2003, 0x728e, 0x6ab0, 0x62b1,
+  0x62d1, 0x62b0, 0x6aaf, 0x30c7, 0x0003, 0x1909, 0x4b14, 0x2252, 0x1a11, 0x4314, 0x31ed, 0x0004,
+  0x857a, 0x95db, 0x95db, 0x95db, 0x5c76, 0x8dfc, 0x95db, 0x95db, 0x95db, 0x74f8, 0x3332, 0x7d7b,
+  0x95dc, 0x95fc, 0x5458, 0x2b33, 0x43d5, 0x95fc, 0x95db, 0x95db, 0x857b, 0x8ddc, 0x8ddc, 0x8ddc,
+  0x5c77, 0x8ddd, 0x8ddb, 0x95db, 0x95db, 0x8ddc, 0x64d9, 0x755b, 0x8ddc, 0x8ddc, 0x755b, 0x2b33,
+  0x64b8, 0x8ddc, 0x8ddc, 0x8ddc, 0x2b33, 0x755b, 0x7dbc, 0x2b33, 0x2b34, 0x4c37, 0x8dfd, 0x53f4,
+  0x3b31, 0x8dfd, 0x6d3b, 0x2b33, 0x7519, 0x95fc, 0x8dfd, 0x4393, 0x8dbb, 0x95fc, 0x85bc, 0x2b32,
+  0x2b34, 0x6d5c, 0x7dbd, 0x2b33, 0x2354, 0x4438, 0x8dfd, 0x95fc, 0x95fc, 0x8dfd, 0x3bd6, 0x2b34,
+  0x753a, 0x8ddc, 0x8ddc, 0x857b, 0x95fc, 0x8dbc, 0x85bd, 0x2b33, 0x2b34, 0x6d3c, 0x7d9d, 0x2b33,
+  0x2354, 0x4437, 0x8ddd, 0x8ddc, 0x8ddc, 0x85fd, 0x3bd6, 0x2b34, 0x6d19, 0x8dbb, 0x6cd8, 0x8ddc,
+  0x7d5a, 0x753a, 0x7dbd, 0x2b33, 0x3333, 0x755b, 0x7dbc, 0x2b33, 0x2b34, 0x4c37, 0x8dfc, 0x53f4,
+  0x3b31, 0x8dfd, 0x6d3b, 0x2b33, 0x7519, 0x8ddb, 0x4bd5, 0x8dfd, 0x5c77, 0x755b, 0x85bc, 0x3332,
+  0x859b, 0x95fc, 0x95fc, 0x95fc, 0x5c77, 0x8dfd, 0x95dc, 0x95db, 0x95fc, 0x95fc, 0x64d9, 0x7d7b,
+  0x95fc, 0x8ddc, 0x2b33, 0x7dbd, 0x3394, 0x755a, 0x95fc, 0x95fc, 0x8d9a, 0x95fb, 0x9dfb, 0x95db,
+  0x6476, 0x95fc, 0x95fc, 0x9dfb, 0x9dfc, 0x74f8, 0x3332, 0x7d7b, 0x95fc, 0x8ddc, 0x2b33, 0x3c17,
+  0x2b34, 0x755b, 0x95fc, 0x9dfb, 0xf283, 0xe2a4, 0xd2c6, 0xfe11, 0xd70f, 0x8628, 0x8646, 0x8665,
+  0xe2a4, 0xdaa5, 0xcae7, 0xfe11, 0xd710, 0x8e09, 0x8627, 0x8646, 0xd2e6, 0xcae7, 0xbb28, 0xf633,
+  0xd6f2, 0x8deb, 0x8dea, 0x8e09, 0xfe77, 0xf678, 0xf698, 0xff7a, 0xf7d7, 0xe7b3, 0xe7b1, 0xe7d1,
+  0x8e9d, 0x8e9d, 0x967c, 0xd79d, 0xf7b6, 0xf70f, 0xff0d, 0xff0c, 0x1d3b, 0x251a, 0x34f8, 0xa73c,
+  0xe713, 0xe5c8, 0xedc6, 0xedc5, 0x0d5d, 0x153b, 0x2519, 0x9f3c, 0xef32, 0xedc6, 0xf5e3, 0xf5e2,
+  0x057d, 0x0d5c, 0x251a, 0x9f5d, 0xef31, 0xedc5, 0xf5e2, 0xfde1,
+};
@@ -0,0 +1,182 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  System metrics sampler.
+
+  Every METRICS_PERIOD a FreeRTOS software timer samples the metrics below
+  into fixed ring buffers of METRICS_HISTORY values, with their min/max kept
+  incrementally (the window is only rescanned when the evicted sample was the
+  min or the max). No task and no polling loop: the timer callback samples,
+  then wakes the Render task which draws the new column of the heap graph
+  (see UI.h).
+
+    heap      free internal heap
+    largest   largest free internal block (fragmentation)
+    psram     free PSRAM
+    sqlite    SQLite memory high-water mark
+    enrich    enrich queue depth
+    merge     merge buffer depth (distinct addresses in the current scan)
+    pkt/s     received packets per second
+
+  The same data goes to Serial: a "Metrics --" line (last/min/max) after every
+  scan, and the whole history with the 'm' console command (see Browser.h).
+
+*/
+
+#ifndef METRICS_PERIOD // override this from Settings.h
+#define METRICS_PERIOD 1000 // milliseconds
+#endif
+#define METRICS_HISTORY 60 // samples, also the heap graph width
+
+enum MetricId {
+  METRIC_HEAP = 0,
+  METRIC_LARGEST_BLOCK,
+  METRIC_PSRAM,
+  METRIC_SQLITE_HIGHWATER,
+  METRIC_ENRICH_QUEUE,
+  METRIC_MERGE_BUFFER,
+  METRIC_PACKET_RATE,
+  METRICS_COUNT
+};
+
+const char* metricNames[METRICS_COUNT] = { "heap", "largest", "psram", "sqlite", "enrich", "merge", "pkt/s" };
+
+static volatile uint32_t PacketCount = 0; // incremented for every received packet
+
+
+struct MetricRing {
+  uint32_t values[METRICS_HISTORY];
+  uint32_t min = 0;
+  uint32_t max = 0;
+
+  // head is where the value goes, count the number of samples before this one
+  void push(uint32_t value, byte head, uint32_t count) {
+    bool full = count >= METRICS_HISTORY;
+    uint32_t evicted = values[head];
+    values[head] = value;
+    if (count == 0) {
+      min = max = value;
+      return;
+    }
+    if (value < min) min = value;
+    if (value > max) max = value;
+    if (full && evicted != value && (evicted == min || evicted == max)) {
+      rescan(METRICS_HISTORY);
+    }
+  }
+
+  void rescan(uint32_t count) {
+    min = 0xffffffff;
+    max = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      if (values[i] < min) min = values[i];
+      if (values[i] > max) max = values[i];
+    }
+  }
+};
+
+
+class MetricsUtils {
+  public:
+
+    MetricRing rings[METRICS_COUNT];
+    volatile uint32_t samples = 0; // total samples taken, the ring head is samples % METRICS_HISTORY
+
+    void init() {
+      if (timer != NULL) return;
+      lastPackets = PacketCount;
+      timer = xTimerCreate("Metrics", METRICS_PERIOD / portTICK_PERIOD_MS, pdTRUE, this, onTimer);
+      if (timer == NULL || xTimerStart(timer, 0) != pdPASS) {
+        Serial.println("[METRICS] Can't start the sampler");
+      }
+    }
+
+    // value of a metric, age samples ago
+    uint32_t get(byte metric, uint32_t age = 0) {
+      if (age >= samples || age >= METRICS_HISTORY) return 0;
+      return rings[metric].values[(samples - 1 - age) % METRICS_HISTORY];
+    }
+
+    void printStats() {
+      if (samples == 0) return;
+      String out = "Metrics --";
+      for (byte i = 0; i < METRICS_COUNT; i++) {
+        out += " " + String(metricNames[i]) + ":" + String(get(i)) + "/" + String(rings[i].min) + "/" + String(rings[i].max);
+      }
+      Serial.println(out + " (last/min/max)");
+    }
+
+    // oldest first, one line per sample
+    void dump() {
+      uint32_t count = samples < METRICS_HISTORY ? samples : METRICS_HISTORY;
+      String out = "M|age";
+      for (byte i = 0; i < METRICS_COUNT; i++) out += "|" + String(metricNames[i]);
+      Serial.println(out);
+      for (uint32_t age = count; age > 0; age--) {
+        out = "M|" + String((age - 1) * METRICS_PERIOD / 1000);
+        for (byte i = 0; i < METRICS_COUNT; i++) out += "|" + String(get(i, age - 1));
+        Serial.println(out);
+      }
+    }
+
+  private:
+
+    TimerHandle_t timer = NULL;
+    uint32_t lastPackets = 0;
+
+    void sample() {
+      uint32_t values[METRICS_COUNT] = { 0 };
+      values[METRIC_HEAP] = freeheap;
+      values[METRIC_LARGEST_BLOCK] = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+      values[METRIC_PSRAM] = psramFound() ? heap_caps_get_free_size(MALLOC_CAP_SPIRAM) : 0;
+      #ifndef BUILD_NTPMENU_BIN
+        values[METRIC_SQLITE_HIGHWATER] = sqlite3_memory_highwater(0);
+        values[METRIC_ENRICH_QUEUE] = EnrichQueueCount;
+        values[METRIC_MERGE_BUFFER] = MergeBuffer.count;
+      #endif
+      uint32_t packets = PacketCount;
+      values[METRIC_PACKET_RATE] = (packets - lastPackets) * 1000 / METRICS_PERIOD;
+      lastPackets = packets;
+      byte head = samples % METRICS_HISTORY;
+      for (byte i = 0; i < METRICS_COUNT; i++) {
+        rings[i].push(values[i], head, samples);
+      }
+      samples++;
+    }
+
+    static void onTimer(TimerHandle_t timer) {
+      MetricsUtils *metrics = (MetricsUtils*)pvTimerGetTimerID(timer);
+      metrics->sample();
+      Display.wake(); // draws the new graph column
+    }
+
+};
+
+
+MetricsUtils Metrics;
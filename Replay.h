@@ -0,0 +1,292 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Capture replay and per-stage latency statistics.
+
+  With ADV_REPLAY defined in Settings.h, the radio isn't used: the packets of
+  REPLAY_FILE (see Capture.h for the format) are fed to the same callback as
+  live packets, and onScanDone() runs at the end of each scan window, in
+  virtual time (the captured millis). REPLAY_SPEED sets the pace: 1 for real
+  time, 10 for 10x, 0 for as fast as possible.
+
+  With REPLAY_RADIO, the replay only hears what the radio would have: the
+  packets sent while the scan listens (window/interval of the Scheduler, the
+  captured millis against the scan start) and not while the previous results
+  were being processed (the millis spent between two scans). The capture must
+  have been taken with a full duty window for that to mean anything. Active
+  vs passive isn't modelled, the capture doesn't tell scan responses apart.
+  The summary counts the distinct addresses heard per minute of capture, to
+  compare scan settings (see SCAN_ADAPTIVE in ScanScheduler.h).
+
+  The replay uses its own database (see BLE_COLLECTOR_DB_FILE), deleted on every boot, so the summary
+  printed at the end of the file is the same from one run to the next for a
+  given capture, build and settings:
+    - rows inserted, cache hit rates
+    - latency percentiles of the packet, scan path, enrich and DB insert stages
+
+  The same capture can be replayed on a Linux host through the whole sketch,
+  with in-memory DBs: see test/ReplayHost.h, that's what CI runs.
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#if defined(ADV_REPLAY) && defined(ADV_CAPTURE)
+  #error "ADV_REPLAY and ADV_CAPTURE can't be enabled together, the replay would capture itself"
+#endif
+
+#ifndef REPLAY_FILE // override this from Settings.h
+#define REPLAY_FILE "/ble-capture.bin"
+#endif
+#ifndef REPLAY_SPEED // override this from Settings.h
+#define REPLAY_SPEED 0 // 0 = max speed
+#endif
+#ifndef REPLAY_RADIO // override this from Settings.h
+#define REPLAY_RADIO 0 // 1: drop the packets the scan parameters and the gaps between scans would have missed
+#endif
+#define REPLAY_UNIQUE_SLOTS 4096 // distinct addresses counted by the summary, power of 2
+#define LATENCY_BUCKETS 24 // powers of 2 in microseconds, up to ~8s
+
+
+// log2 histogram, cheap enough for the scan path
+struct LatencyStats {
+  const char* name;
+  uint32_t buckets[LATENCY_BUCKETS];
+  uint32_t count;
+  uint32_t maxMicros;
+
+  LatencyStats(const char* _name) : name(_name), count(0), maxMicros(0) {
+    memset(buckets, 0, sizeof(buckets));
+  }
+  void add(unsigned long us) {
+    byte bucket = 0;
+    while(bucket < LATENCY_BUCKETS-1 && (1UL << bucket) < us) bucket++;
+    buckets[bucket]++;
+    count++;
+    if(us > maxMicros) maxMicros = us;
+  }
+  // upper bound of the bucket holding the given percentile
+  uint32_t percentile(byte p) {
+    if(count == 0) return 0;
+    uint32_t rank = (count * p + 99) / 100;
+    uint32_t seen = 0;
+    for(byte i=0;i<LATENCY_BUCKETS;i++) {
+      seen += buckets[i];
+      if(seen >= rank) return min((uint32_t)(1UL << i), maxMicros);
+    }
+    return maxMicros;
+  }
+  void print() {
+    Serial.printf("Latency -- %-10s n:%-6d p50:%-7d p90:%-7d p99:%-7d max:%d us\n", name, count, percentile(50), percentile(90), percentile(99), maxMicros);
+  }
+};
+
+LatencyStats LatencyPacket("packet");
+LatencyStats LatencyScanPath("scan path");
+LatencyStats LatencyEnrich("enrich");
+LatencyStats LatencyInsert("db insert");
+
+
+typedef void (*ReplayPacketCallback)(uint64_t mac, uint8_t addrType, int rssi, const uint8_t *payload, size_t length, unsigned long now);
+
+class ReplayUtils {
+  public:
+
+    unsigned long clock = 0; // virtual millis, captured time of the last replayed packet
+    uint32_t records = 0;
+    uint32_t scans = 0;
+    uint32_t missed = 0; // packets the radio wouldn't have heard, see REPLAY_RADIO
+    uint32_t unique = 0; // distinct addresses replayed
+
+    bool init() {
+      replayFile = SD_MMC.open(REPLAY_FILE);
+      if(!replayFile) {
+        Serial.println("[REPLAY] Can't open " + String(REPLAY_FILE));
+        return false;
+      }
+      uint8_t header[CAPTURE_BLOCK_SIZE];
+      if(replayFile.read(header, CAPTURE_BLOCK_SIZE) != CAPTURE_BLOCK_SIZE
+      || memcmp(header, CAPTURE_MAGIC, strlen(CAPTURE_MAGIC)) != 0
+      || header[strlen(CAPTURE_MAGIC)] != CAPTURE_VERSION) {
+        Serial.println("[REPLAY] Invalid capture file " + String(REPLAY_FILE));
+        replayFile.close();
+        return false;
+      }
+      uniqueMacs = (uint64_t*)calloc(REPLAY_UNIQUE_SLOTS, sizeof(uint64_t));
+      Serial.println("[REPLAY] Replaying " + String(REPLAY_FILE) + " at speed " + String(REPLAY_SPEED));
+      return true;
+    }
+
+    // feeds the packets of the next scan of given duration and window/interval (0.625ms units), returns false at the end of the file
+    bool feed(uint32_t durationSeconds, uint16_t window, uint16_t interval, ReplayPacketCallback onPacket) {
+      unsigned long windowStart = 0;
+      unsigned long windowEnd = 0;
+      #if REPLAY_SPEED > 0
+        unsigned long lastReplayed = millis();
+      #endif
+      #if REPLAY_RADIO
+        // the radio was off while the previous results were processed
+        unsigned long radioOn = clock > 0 ? clock + (millis() - stoppedAt) : 0;
+      #endif
+      bool fed = false;
+      while(nextRecord()) {
+        unsigned long timestamp = record[1] | (record[2] << 8) | (record[3] << 16) | ((unsigned long)record[4] << 24);
+        if(firstTimestamp == 0) firstTimestamp = timestamp;
+        lastTimestamp = timestamp;
+        #if REPLAY_RADIO
+          if(timestamp < radioOn) {
+            missed++;
+            clock = timestamp;
+            continue;
+          }
+        #endif
+        if(!fed) {
+          windowStart = timestamp;
+          windowEnd = windowStart + durationSeconds * 1000;
+          if(clock == 0) clock = timestamp;
+          fed = true;
+        }
+        if(timestamp >= windowEnd) {
+          unread = true; // belongs to the next scan
+          break;
+        }
+        #if REPLAY_RADIO
+          if(interval > 0 && ((timestamp - windowStart) * 8 / 5) % interval >= window) {
+            missed++; // between two scan windows
+            clock = timestamp;
+            continue;
+          }
+        #endif
+        #if REPLAY_SPEED > 0
+          if(timestamp > clock) {
+            unsigned long wait = (timestamp - clock) / REPLAY_SPEED;
+            unsigned long elapsed = millis() - lastReplayed;
+            if(wait > elapsed) delay(wait - elapsed);
+          }
+          lastReplayed = millis();
+        #endif
+        clock = timestamp;
+        uint64_t mac = 0;
+        for(byte i=0;i<6;i++) mac = (mac << 8) | record[5+i];
+        onPacket(mac, record[11], (int8_t)record[12], record + 14, record[13], timestamp);
+        countUnique(mac);
+        records++;
+      }
+      if(fed) {
+        clock = windowEnd;
+        scans++;
+      }
+      stoppedAt = millis();
+      return fed;
+    }
+
+    // captured millis read so far, heard or not
+    unsigned long span() {
+      return lastTimestamp - firstTimestamp;
+    }
+
+    // distinct addresses per minute of capture, x10
+    uint32_t uniquePerMinute10() {
+      return span() > 0 ? (uint64_t)unique * 600000 / span() : 0;
+    }
+
+    void printSummary(uint32_t inserted) {
+      Serial.println("[REPLAY] Done");
+      Serial.printf("Replay -- records:%d scans:%d rows inserted:%d\n", records, scans, inserted);
+      Serial.printf("Replay -- unique devices:%d in %lus (%d.%d per minute), missed packets:%d\n",
+        unique,
+        span() / 1000,
+        uniquePerMinute10() / 10,
+        uniquePerMinute10() % 10,
+        missed
+      );
+      Serial.printf("Replay -- cache hit rates: cards %d/%d, oui %d, vendor %d\n",
+        BLEDevCacheHit,
+        BLEDevCacheMacIndex.lookups,
+        OuiCacheHit,
+        VendorCacheHit
+      );
+      LatencyPacket.print();
+      LatencyScanPath.print();
+      LatencyEnrich.print();
+      LatencyInsert.print();
+    }
+
+  private:
+
+    File replayFile;
+    unsigned long firstTimestamp = 0;
+    unsigned long lastTimestamp = 0;
+    unsigned long stoppedAt = 0; // millis() at the end of the last scan
+    uint64_t *uniqueMacs = NULL; // open addressing, mac + 1, counting stops when full
+    uint8_t record[256]; // current record, length byte included
+    uint8_t block[CAPTURE_BLOCK_SIZE];
+    uint16_t blockPos = CAPTURE_BLOCK_SIZE;
+    bool unread = false;
+
+    void countUnique(uint64_t mac) {
+      if(uniqueMacs == NULL || unique >= REPLAY_UNIQUE_SLOTS - 1) return;
+      uint32_t slot = (uint32_t)(mac ^ (mac >> 24)) & (REPLAY_UNIQUE_SLOTS - 1);
+      while(uniqueMacs[slot] != 0) {
+        if(uniqueMacs[slot] == mac + 1) return;
+        slot = (slot + 1) & (REPLAY_UNIQUE_SLOTS - 1);
+      }
+      uniqueMacs[slot] = mac + 1;
+      unique++;
+    }
+
+    // copies the next record into record[], skipping block padding
+    bool nextRecord() {
+      if(unread) {
+        unread = false;
+        return true; // still in record[]
+      }
+      while(1) {
+        if(blockPos >= CAPTURE_BLOCK_SIZE || block[blockPos] == 0) {
+          if(replayFile.read(block, CAPTURE_BLOCK_SIZE) != CAPTURE_BLOCK_SIZE) return false;
+          blockPos = 0;
+          continue;
+        }
+        uint8_t length = block[blockPos];
+        if(blockPos + 1 + length > CAPTURE_BLOCK_SIZE || length < CAPTURE_HEADER_SIZE) {
+          blockPos = CAPTURE_BLOCK_SIZE; // corrupted, skip the block
+          continue;
+        }
+        memcpy(record, block + blockPos, 1 + length);
+        blockPos += 1 + length;
+        return true;
+      }
+    }
+
+};
+
+
+ReplayUtils Replay;
+
+#endif
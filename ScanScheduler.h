@@ -0,0 +1,142 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Adaptive scan parameters, adjusted after every scan from:
+    - density: devices found during the last scan
+    - novelty: share of those that were new
+    - backlog: devices still waiting in the EnrichQueue
+
+  New devices showing up   => more radio time (higher window/interval duty),
+                              active scan to get names, shorter scans so they
+                              get processed sooner
+  Backlog piling up        => passive scan and longer scans, leaves more idle
+                              time to drain the queue
+  Quiet or stable crowd    => back to the SCAN_WINDOW duty, longer scans: a
+                              lower duty misses the people walking by before
+                              the next scan can react
+
+  All values stay within the bounds defined in Settings.h, changes are applied
+  to the next scan. With SCAN_ADAPTIVE false the scan keeps the fixed
+  settings: SCAN_TIME, a SCAN_WINDOW/SCAN_INTERVAL window and active scanning, e.g.
+  to compare both on the same capture (see REPLAY_RADIO in Replay.h).
+
+*/
+
+#ifndef SCAN_TIME_MIN // override this from Settings.h
+#define SCAN_TIME_MIN 10 // seconds
+#endif
+#ifndef SCAN_TIME_MAX // override this from Settings.h
+#define SCAN_TIME_MAX 60 // seconds
+#endif
+#ifndef SCAN_INTERVAL // override this from Settings.h
+#define SCAN_INTERVAL 0x50 // 0.625ms units
+#endif
+#ifndef SCAN_WINDOW // override this from Settings.h
+#define SCAN_WINDOW 0x30 // 0.625ms units, the fixed window, and the lowest one unless the backlog piles up
+#endif
+#ifndef SCAN_WINDOW_MIN // override this from Settings.h
+#define SCAN_WINDOW_MIN 0x10 // 0.625ms units, must be <= SCAN_INTERVAL
+#endif
+#ifndef SCAN_ADAPTIVE // override this from Settings.h
+#define SCAN_ADAPTIVE true // false: fixed scan parameters
+#endif
+
+class ScanSchedulerUtils {
+  public:
+
+    uint32_t duration = SCAN_TIME; // seconds
+    uint16_t interval = SCAN_INTERVAL;
+    uint16_t window = SCAN_WINDOW;
+    bool active = true;
+    bool adaptive = SCAN_ADAPTIVE;
+
+    // called at the end of every scan
+    void update(int found, int newFound, int backlog) {
+      // smoothed values (x4 fixed point) to avoid flapping, novelty rises at once:
+      // people walking by are gone before a smoothed value would react
+      int lastNovelty = found > 0 ? (newFound * 100 * 4) / found : 0;
+      density = (density * 3 + found * 4) / 4;
+      novelty = lastNovelty > novelty ? lastNovelty : (novelty * 3 + lastNovelty) / 4;
+      if( !adaptive ) {
+        // fixed settings, only the figures are updated
+      } else if( backlog > ENRICHQUEUE_SIZE / 2 ) {
+        // downstream can't keep up, slow down discovery
+        active = false;
+        adjust( -1, SCAN_TIME_MIN, SCAN_WINDOW_MIN );
+      } else if( novelty > 25 * 4 ) {
+        // many new devices, listen more and report faster
+        active = true;
+        adjust( 1, -(SCAN_TIME_MIN / 2), SCAN_WINDOW );
+      } else {
+        // quiet room or known crowd
+        active = density < 8 * 4; // names are cheap to get when few devices are around
+        adjust( -1, SCAN_TIME_MIN / 2, SCAN_WINDOW );
+      }
+      Serial.printf("Scheduler -- density:%d novelty:%d%% backlog:%d => %s scan, window:0x%02x/0x%02x, %ds\n",
+        density / 4,
+        novelty / 4,
+        backlog,
+        active ? "active" : "passive",
+        window,
+        interval,
+        duration
+      );
+    }
+
+
+    #ifndef BUILD_NTPMENU_BIN
+    void apply(BLEScan *pBLEScan) {
+      pBLEScan->setActiveScan(active); //active scan uses more power, but get results faster
+      pBLEScan->setInterval(interval);
+      pBLEScan->setWindow(window);
+    }
+    #endif
+
+
+  private:
+
+    int density = 0;
+    int novelty = 100 * 4; // assume everything is new at boot
+
+    // moves the window by 1/8th of the interval, not below minWindow, and the duration by given seconds, within bounds
+    void adjust(int windowSteps, int seconds, int minWindow) {
+      int newWindow = window + windowSteps * (SCAN_INTERVAL / 8);
+      if( newWindow < minWindow ) newWindow = minWindow;
+      if( newWindow > SCAN_INTERVAL )   newWindow = SCAN_INTERVAL;
+      window = newWindow;
+      int newDuration = duration + seconds;
+      if( newDuration < SCAN_TIME_MIN ) newDuration = SCAN_TIME_MIN;
+      if( newDuration > SCAN_TIME_MAX ) newDuration = SCAN_TIME_MAX;
+      duration = newDuration;
+    }
+
+};
+
+
+ScanSchedulerUtils Scheduler;
@@ -27,10 +27,19 @@
 
   -----------------------------------------------------------------------------
 
-*/
+  The hardware scroll is animated by the Render task (see Display.h): print()
+  draws the text and moves the target offset (yStart), scrollStep() walks the
+  displayed offset towards it on every frame, faster when it lags behind.
+  Printing never waits for the animation, unless it's a full scroll area
+  behind: the lines about to be drawn were never shown, the offset jumps to
+  the target right away (syncScrolls).
+
+  Blocks composed off-screen (the BLE cards) reserve() their lines and are
+  pushed with pushStrip(), which splits a strip at the scroll loop point.
 
+*/
 
-static bool isScrolling = false;
+#define SCROLL_CATCHUP 4 // lines behind the target per extra line scrolled in a frame
 
 class ScrollableOutput {
   public:
@@ -46,6 +55,7 @@ class ScrollableOutput {
     uint16_t w_tmp, h_tmp;
     int scrollPosY = -1;
     int scrollPosX = -1;
+    uint32_t syncScrolls = 0; // catch-ups done while printing, the animation was a screen behind
     /*
     int printf(char* fmt ...) { // printf for the poor :-)
       char buf[1024]; // resulting string limited to 1024 chars
@@ -64,8 +74,36 @@ class ScrollableOutput {
         // avoid unnecessary scrolling in the serial console
         Serial.print( str );
       }
+      DisplayLock lock;
       return scroll(str);
     }
+    // scrolls h lines for a block drawn off-screen, returns the y of its first line
+    uint16_t reserve(uint16_t h) {
+      if (scrollPosY == -1) {
+        scrollPosY = tft.getCursorY();
+      }
+      if (scrollPosY >= (height - scrollBottomFixedArea)) {
+        scrollPosY = (scrollPosY % (height - scrollBottomFixedArea)) + scrollTopFixedArea;
+      }
+      uint16_t y = scrollPosY;
+      scroll_async(h);
+      scrollPosY = y + h;
+      if (scrollPosY >= (height - scrollBottomFixedArea)) {
+        scrollPosY -= yArea;
+      }
+      tft.setCursor(0, scrollPosY);
+      return y;
+    }
+    // pushes a full width strip of h lines at y (may be past the loop point), one transfer per side of the loop point
+    void pushStrip(uint16_t y, uint16_t *pixels, uint16_t h) {
+      uint16_t limit = height - scrollBottomFixedArea;
+      if (y >= limit) y -= yArea;
+      uint16_t h1 = min(h, (uint16_t)(limit - y));
+      tft.drawBitmap(0, y, width, h1, pixels);
+      if (h1 < h) {
+        tft.drawBitmap(0, scrollTopFixedArea, width, h - h1, pixels + h1 * width);
+      }
+    }
     void setupScrollArea(uint16_t TFA, uint16_t BFA, bool clear = false) {
       tft.setCursor(0, TFA);
       tft.setupScrollArea(TFA, BFA); // driver needs patching for that, see https://github.com/espressif/WROVER_KIT_LCD/pull/3/files
@@ -74,11 +112,25 @@ class ScrollableOutput {
       scrollBottomFixedArea = BFA;
       yStart = scrollTopFixedArea;
       yArea = height - scrollTopFixedArea - scrollBottomFixedArea;
+      yDisplayed = yStart;
+      lag = 0;
       //Serial.printf("*** NEW Scroll Setup: Top=%d Bottom=%d YArea=%d\n", TFA, BFA, yArea);
       if (clear) {
         tft.fillRect(0, TFA, width, yArea, WROVER_BLACK);
       }
     }
+    // called by the Render task on every frame, returns false when the displayed offset has caught up
+    bool scrollStep() {
+      DisplayLock lock;
+      if (lag == 0) return false;
+      uint16_t step = 1 + lag / SCROLL_CATCHUP;
+      uint16_t yNext = yDisplayed + step;
+      if (yNext >= height - scrollBottomFixedArea) yNext -= yArea;
+      tft.scrollTo(yNext); // driver needs patching for that, see https://github.com/espressif/WROVER_KIT_LCD/pull/3/files
+      yDisplayed = yNext;
+      lag -= step;
+      return true;
+    }
   private:
     int scroll(String str) {
       if (scrollPosY == -1) {
@@ -96,23 +148,34 @@ class ScrollableOutput {
         tft.fillRect(0, scrollPosY, w_tmp, h_tmp, BGCOLOR/*BLECARD_BGCOLOR*/);
       }
       tft.setCursor(scrollPosX, scrollPosY);
-      scroll_slow(h_tmp, 5); // Scroll lines, 5ms per line
+      scroll_async(h_tmp); // the Render task will catch up
       tft.print(str);
       scrollPosY = tft.getCursorY();
       return h_tmp;
     }
-    /* change this function if your TFT does not handle hardware scrolling */
-    int scroll_slow(int lines, int wait) {
-      isScrolling = true;
+    volatile uint16_t yDisplayed = 0; // hardware scroll offset
+    uint16_t lag = 0; // lines between yDisplayed and yStart, at most yArea - 1
+
+    /* moves the target offset, change this function if your TFT does not handle hardware scrolling, called with the DisplayLock held */
+    int scroll_async(int lines) {
       int yTemp = yStart;
       scrollPosY = -1;
+      uint16_t target = yStart;
       for (int i = 0; i < lines; i++) {
-        yStart++;
-        if (yStart == height - scrollBottomFixedArea) yStart = scrollTopFixedArea;
-        tft.scrollTo(yStart); // driver needs patching for that, see https://github.com/espressif/WROVER_KIT_LCD/pull/3/files
-        delay(wait);
+        target++;
+        if (target == height - scrollBottomFixedArea) target = scrollTopFixedArea;
+      }
+      yStart = target;
+      if (lag + lines >= yArea) {
+        // a whole scroll area behind, the offsets would look even: scroll now
+        tft.scrollTo(target);
+        yDisplayed = target;
+        lag = 0;
+        syncScrolls++;
+        return yTemp;
       }
-      isScrolling = false;
+      lag += lines;
+      Display.wake();
       return  yTemp;
     }
 
@@ -34,6 +34,11 @@
    
     Only profile 3 - "Chronomaniac" requires to compile this module in two 
     different modes, see "#define BUILD_NTPMENU_BIN"
+
+  UI Profiles:
+    1 - "TFT": BLE Cards, header and footer on the ILI9341
+    2 - "Headless": no display, status goes to a compact Serial stream (see
+        Telemetry.h) and the freed heap goes to bigger caches
  
 */
 
@@ -47,10 +52,38 @@
 //#define RTC_PROFILE NTP_MENU // to build the NTPMenu.bin
 //#define RTC_PROFILE CHRONOMANIAC // to build the BLEMenu.bin
 
-#define SCAN_TIME  30 // seconds minimum
+#define UI_TFT 1 // ILI9341 display
+#define UI_HEADLESS 2 // no display, Serial telemetry only
+
+// edit this value to fit your hardware
+#define UI_PROFILE UI_TFT
+
+#define SCAN_TIME  30 // seconds, initial scan duration, then adjusted between SCAN_TIME_MIN and SCAN_TIME_MAX
+#define SCAN_TIME_MIN 10 // seconds
+#define SCAN_TIME_MAX 60 // seconds
+#define SCAN_INTERVAL 0x50 // 0.625ms units
+#define SCAN_WINDOW 0x30 // 0.625ms units, the scan window is adjusted between this and SCAN_INTERVAL
+#define SCAN_WINDOW_MIN 0x10 // 0.625ms units, lowest scan window, only when the enrich backlog piles up
 #define BLEDEVCACHE_SIZE 16 // use some heap to cache BLECards, min = 5, max = 64, higher value = smaller uptime
+#define BLEDEVCACHE_PSRAM_SIZE 4096 // BLECards cache size when psram is found, replaces BLEDEVCACHE_SIZE
+//#define BLEDEVCACHE_BENCHMARK // uncomment to compare linear and hashed cache lookups on cold boot
 #define VENDORCACHE_SIZE 32 // use some heap to cache vendor query responses, min = 5, max = 32
 #define OUICACHE_SIZE 32 // use some heap to cache mac query responses, min = 16, max = 64
+#define CLUSTER_SIZE 32 // rotating random addresses tracked to link them to one logical device
+#define CLUSTER_GAP_SCANS 1 // a rotated address must show up this many scans after the old one went quiet
+#define CLUSTER_RSSI_DELTA 10 // dB, max RSSI change across a rotation
+//#define CLUSTER_LINK // uncomment to skip the linked addresses, otherwise the links are only counted (see Cluster.h, not accurate enough yet)
+#define MERGE_BUFFER_SIZE 64 // distinct addresses per scan (grows by this step when full), packets from the same address are merged into one record
+#define MERGE_BUFFER_MAX 1024 // records the merge buffer can grow to with psram, MERGE_BUFFER_HEAP_MAX without
+#define MERGE_BUFFER_HEAP_MAX 256
+#define MERGE_WINDOW 2000 // milliseconds after the first packet during which scan responses get merged
+#define ENRICHQUEUE_SIZE 32 // new devices waiting for their oui/vendor names, capped to half the BLECards cache
+//#define ADV_CAPTURE // uncomment to log every received packet into /ble-capture.bin on the SD Card (see Capture.h)
+//#define ADV_REPLAY // uncomment to replay /ble-capture.bin instead of scanning, prints a summary at the end (see Replay.h)
+//#define TFT_STATS // uncomment to print the display calls and estimated SPI bytes per operation after every scan (see TFTStats.h)
+//#define TABLE_VIEW TABLE_STRONGEST // uncomment (or TABLE_RECENT) to show a live table of devices instead of the scrolling BLE cards (see TableView.h)
+#define REPLAY_SPEED 0 // replay pace: 1 = real time, 10 = 10x, 0 = max speed
+#define ENRICH_BUDGET (Scheduler.duration*500) // milliseconds per scan spent resolving names while the radio is busy
 
 // don't edit anything below this
 #if RTC_PROFILE==HOBO
@@ -68,9 +101,21 @@
   #error "No valid RTC_PROFILE has been selected, please refer to the comments in Settings.h"
 #endif
 
-#include <Adafruit_GFX.h>    // Core graphics library
-#include "WROVER_KIT_LCD.h" // Must have the VScroll def patch: https://github.com/espressif/WROVER_KIT_LCD/pull/3/files
-WROVER_KIT_LCD tft;
+#if UI_PROFILE==UI_HEADLESS
+  // no display buffers, render tasks nor intro: give that heap to the caches
+  #undef BLEDEVCACHE_SIZE
+  #define BLEDEVCACHE_SIZE 24
+  #undef OUICACHE_SIZE
+  #define OUICACHE_SIZE 48
+  #include "Headless.h" // tft, Display and Out stand-ins
+#elif UI_PROFILE==UI_TFT
+  #include <Adafruit_GFX.h>    // Core graphics library
+  #include "WROVER_KIT_LCD.h" // Must have the VScroll def patch: https://github.com/espressif/WROVER_KIT_LCD/pull/3/files
+  #include "TFTStats.h" // display calls and SPI bytes counters
+  TFTDisplay tft;
+#else
+  #error "No valid UI_PROFILE has been selected, please refer to the comments in Settings.h"
+#endif
 
 #if RTC_PROFILE > HOBO
   // RTC Module: On Wrover Kit you can use the following pins (from the camera connector)
@@ -83,6 +128,7 @@ WROVER_KIT_LCD tft;
 
 #ifndef BUILD_NTPMENU_BIN 
   // don't load BLE stack and SQLite3 when compiling the NTP Utility
+  // BLEAdvertisedDevice::getAddressType() is required (ESP32 BLE Arduino >= 1.0.1)
   #include <BLEDevice.h>
   #include <BLEUtils.h>
   #include <BLEScan.h>
@@ -123,6 +169,8 @@ Preferences preferences;
 #include <SD_MMC.h>
 // used to get the resetReason
 #include <rom/rtc.h>
+#include <rom/crc.h> // crc32_le()
+#include <freertos/timers.h> // metrics sampler
 
 // because ESP.getFreeHeap() is inconsistent across SDK versions
 // use the primitive... eats 25Kb memory
@@ -133,21 +181,52 @@ Preferences preferences;
 int devicesCount = 0; // devices count per scan
 int sessDevicesCount = 0; // total devices count per session
 int newDevicesCount = 0; // total devices count per session
+int FilteredOutCount = 0; // devices dropped by the filter before any lookup
+int InsertedCount = 0; // rows inserted during this session
 static int results = 0; // total results during last query
 unsigned int entries = 0; // total entries in database
 byte prune_trigger = 0; // incremented on every insertion, reset on prune()
 byte prune_threshold = 10; // prune every x inertions
 bool print_results = false;
 bool print_tabular = true;
+// heap management
+uint32_t min_free_heap = 100000; // sql out of memory errors eventually occur under 100000
+uint32_t initial_free_heap = freeheap;
+uint32_t heap_tolerance = 20000; // how much memory under min_free_heap the sketch can go and recover without restarting itself
+
+void warmRestart(); // snapshots the caches before ESP.restart(), see Snapshot.h
 
 // load stack
-#include "Assets.h" // bitmaps
+#if UI_PROFILE==UI_TFT
+  #include "Assets.h" // bitmaps
+  #include "Icons.h" // card icons atlas, generated by tools/make_icons.py
+#endif
 #include "BLECache.h" // data struct
-#include "ScrollPanel.h" // scrolly methods
+#include "Advertisement.h" // raw advertisements and scan responses merging
+#include "Decoder.h" // manufacturer/service data decoders
+#include "Capture.h" // raw advertisements logging
+#include "ScanScheduler.h" // adaptive scan parameters
+#if UI_PROFILE==UI_TFT
+  #include "Display.h" // draw command queue, display lock
+  #include "ScrollPanel.h" // scrolly methods
+  #include "TableView.h" // live device table
+#endif
+#include "Metrics.h" // system metrics sampler
 #if RTC_PROFILE == CHRONOMANIAC ||  RTC_PROFILE == NTP_MENU
   #include "SDUpdater.h" // multi roms system
 #endif
 #include "TimeUtils.h" // RTC / NTP support
-#include "UI.h"
+#if UI_PROFILE==UI_TFT
+  #include "UI.h"
+#else
+  #include "Telemetry.h" // Serial status stream
+#endif
+#include "Filter.h" // device filter rules
 #include "DB.h"
+#include "Browser.h" // paged DB browser on the Serial console
+#include "Freezer.h" // binary device records, NVS ring
+#include "Wal.h" // SD Card write-ahead log of pending devices
+#include "Replay.h" // capture replay, latency stats
+#include "Cluster.h" // rotating addresses clustering
+#include "Snapshot.h" // caches and counters kept across restarts
 #include "BLE.h"
@@ -0,0 +1,289 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Warm restart snapshot of the caches and counters.
+
+  The collector restarts on purpose when the heap or the DB runs out of
+  memory, warmRestart() writes the hot state to SNAPSHOT_FILE just before, and
+  the next software reset restores it so the cache hit rates don't start
+  from zero again:
+
+    header         SnapshotHeader (magic, version, body length, crc32 of the body)
+    body           items <type:1> <length:2> <data>
+                     'C'  counters, uint32 each, in SnapshotCounters order
+                     'O'  OuiCache entry: <mac string> <assignment string>
+                     'V'  VendorCache entry: <devid:2> <vendor string>
+                     'D'  BLEDevCache device: a DeviceRecord (see Freezer.h)
+
+  Strings are <length:1><chars>, numbers are little endian. The snapshot is
+  removed once read, a cold boot or an invalid file starts from empty caches.
+
+  When the heap is already below min_free_heap the SD Card driver is short of
+  buffers too, the body is then capped at SNAPSHOT_OOM_SIZE: the counters and
+  the caches come first, the devices that don't fit are left to the DB.
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#define SNAPSHOT_FILE "/blecollector.snap"
+#define SNAPSHOT_MAGIC 0x50414e53 // "SNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ITEM_MAX FREEZER_RECORD_MAX
+#ifndef SNAPSHOT_OOM_SIZE // override this from Settings.h
+  #define SNAPSHOT_OOM_SIZE 4096 // body bytes written when the heap is exhausted
+#endif
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t devices;
+  uint32_t length; // body, without header
+  uint32_t crc; // crc32 of the body
+} __attribute__((packed));
+
+// appending to this list is safe, older snapshots restore the counters they have
+static int* SnapshotCounters[] = {
+  &BLEDevCacheHit,
+  &SelfCacheHit,
+  &AnonymousCacheHit,
+  &OuiCacheHit,
+  &VendorCacheHit,
+  &OuiLookupsAvoided,
+  &FilteredOutCount,
+  &InsertedCount,
+  &sessDevicesCount,
+  &newDevicesCount,
+  &EnrichQueued,
+  &EnrichDone,
+  &EnrichSync
+};
+#define SNAPSHOT_COUNTERS (sizeof(SnapshotCounters) / sizeof(SnapshotCounters[0]))
+
+
+class SnapshotUtils {
+  public:
+
+    uint16_t restoredDevices = 0;
+
+    // writes the caches and counters up to maxLength body bytes, returns false if the SD Card can't take them
+    bool save(uint32_t maxLength = 0xffffffff) {
+      unsigned long started = millis();
+      snapshotFile = SD_MMC.open(SNAPSHOT_FILE, FILE_WRITE);
+      if(!snapshotFile) return false;
+      SnapshotHeader header;
+      memset(&header, 0, sizeof(header));
+      snapshotFile.write((uint8_t*)&header, sizeof(header)); // placeholder
+      length = 0;
+      crc = 0;
+      budget = maxLength;
+      uint8_t buf[SNAPSHOT_ITEM_MAX];
+      uint16_t pos = 0;
+      for(byte i=0;i<SNAPSHOT_COUNTERS;i++) {
+        putNumber(buf, pos, *SnapshotCounters[i], 4);
+      }
+      writeItem('C', buf, pos);
+      for(byte i=0;i<OUICACHE_SIZE;i++) {
+        if(OuiCache[i].mac == "" || OuiCache[i].assignment == "") continue;
+        pos = 0;
+        putString(buf, pos, OuiCache[i].mac);
+        putString(buf, pos, OuiCache[i].assignment);
+        if(!writeItem('O', buf, pos)) break;
+      }
+      for(byte i=0;i<VENDORCACHE_SIZE;i++) {
+        if(VendorCache[i].vendor == "") continue;
+        pos = 0;
+        putNumber(buf, pos, VendorCache[i].devid, 2);
+        putString(buf, pos, VendorCache[i].vendor);
+        if(!writeItem('V', buf, pos)) break;
+      }
+      for(uint16_t i=0;i<BLEDevCacheSize;i++) {
+        // queued devices aren't populated yet, the WAL/NVS journal has them
+        if(BLEDevCache[i].address == "" || BLEDevCache[i].enrich_pending) continue;
+        pos = DeviceRecord::serialize(BLEDevCache[i], i, buf);
+        if(!writeItem('D', buf, pos)) break;
+        header.devices++;
+      }
+      header.magic   = SNAPSHOT_MAGIC;
+      header.version = SNAPSHOT_VERSION;
+      header.length  = length;
+      header.crc     = crc;
+      snapshotFile.seek(0);
+      bool saved = snapshotFile.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+      snapshotFile.close();
+      Serial.printf("[SNAPSHOT] Saved %d devices, %d bytes in %lu ms\n", header.devices, sizeof(header) + length, millis() - started);
+      return saved;
+    }
+
+    // restores the caches and counters from the last snapshot, then removes it
+    bool restore() {
+      snapshotFile = SD_MMC.open(SNAPSHOT_FILE);
+      if(!snapshotFile) return false;
+      bool restored = isValid();
+      if(restored) {
+        snapshotFile.seek(sizeof(SnapshotHeader));
+        uint8_t item[3];
+        uint8_t buf[SNAPSHOT_ITEM_MAX];
+        while(snapshotFile.read(item, 3) == 3) {
+          uint16_t itemLength = item[1] | (item[2] << 8);
+          if(itemLength > SNAPSHOT_ITEM_MAX || snapshotFile.read(buf, itemLength) != itemLength) break;
+          restoreItem(item[0], buf, itemLength);
+        }
+        Serial.printf("[SNAPSHOT] Restored %d devices\n", restoredDevices);
+      } else {
+        Serial.println("[SNAPSHOT] Ignoring invalid snapshot");
+      }
+      snapshotFile.close();
+      clear();
+      return restored;
+    }
+
+    void clear() {
+      SD_MMC.remove(SNAPSHOT_FILE);
+    }
+
+  private:
+
+    File snapshotFile;
+    uint32_t length = 0; // body bytes written
+    uint32_t crc = 0; // crc of the body written so far
+    uint32_t budget = 0; // body bytes allowed for this save
+
+    // returns false without writing when the item doesn't fit in the budget
+    bool writeItem(char type, uint8_t *buf, uint16_t itemLength) {
+      if(length + 3 + itemLength > budget) return false;
+      uint8_t item[3] = { (uint8_t)type, (uint8_t)(itemLength & 0xff), (uint8_t)(itemLength >> 8) };
+      snapshotFile.write(item, 3);
+      snapshotFile.write(buf, itemLength);
+      crc = crc32_le(crc, item, 3);
+      crc = crc32_le(crc, buf, itemLength);
+      length += 3 + itemLength;
+      return true;
+    }
+
+    // checks the header and the crc of the whole body before anything is restored
+    bool isValid() {
+      SnapshotHeader header;
+      if(snapshotFile.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+      if(header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) return false;
+      if(snapshotFile.size() != sizeof(header) + header.length) return false;
+      uint8_t buf[SNAPSHOT_ITEM_MAX];
+      uint32_t bodyCrc = 0;
+      size_t got;
+      while((got = snapshotFile.read(buf, SNAPSHOT_ITEM_MAX)) > 0) {
+        bodyCrc = crc32_le(bodyCrc, buf, got);
+      }
+      return bodyCrc == header.crc;
+    }
+
+    void restoreItem(char type, const uint8_t *buf, uint16_t itemLength) {
+      uint16_t pos = 0;
+      switch(type) {
+        case 'C':
+          for(byte i=0;i<SNAPSHOT_COUNTERS && pos+4<=itemLength;i++) {
+            *SnapshotCounters[i] = (int)getNumber(buf, pos, 4);
+          }
+        break;
+        case 'O':
+          OuiCacheIndex = (OuiCacheIndex + 1) % OUICACHE_SIZE;
+          OuiCache[OuiCacheIndex].mac        = getString(buf, pos, itemLength);
+          OuiCache[OuiCacheIndex].assignment = getString(buf, pos, itemLength);
+        break;
+        case 'V':
+          VendorCacheIndex = (VendorCacheIndex + 1) % VENDORCACHE_SIZE;
+          VendorCache[VendorCacheIndex].devid  = getNumber(buf, pos, 2);
+          VendorCache[VendorCacheIndex].vendor = getString(buf, pos, itemLength);
+        break;
+        case 'D': {
+          uint16_t cacheIndex = BLEDevCacheAlloc();
+          BlueToothDevice &BLEDev = BLEDevCache[cacheIndex];
+          if( !DeviceRecord::deserialize(buf, itemLength, BLEDev) ) {
+            BLEDev.reset();
+            break;
+          }
+          BLEDev.borderColor = IN_CACHE_COLOR;
+          BLEDev.textColor   = BLEDev.in_db ? NOT_ANONYMOUS_COLOR : ANONYMOUS_COLOR;
+          BLEDevCacheSetIndex( cacheIndex );
+          restoredDevices++;
+        }
+        break;
+      }
+    }
+
+    static void putNumber(uint8_t *buf, uint16_t &pos, uint32_t value, byte size) {
+      for(byte i=0;i<size;i++) buf[pos++] = (value >> (8*i)) & 0xff;
+    }
+
+    static void putString(uint8_t *buf, uint16_t &pos, String &str) {
+      uint8_t len = str.length() > MAX_FIELD_LEN ? MAX_FIELD_LEN : str.length();
+      buf[pos++] = len;
+      memcpy(buf + pos, str.c_str(), len);
+      pos += len;
+    }
+
+    static uint32_t getNumber(const uint8_t *buf, uint16_t &pos, byte size) {
+      uint32_t value = 0;
+      for(byte i=0;i<size;i++) value |= (uint32_t)buf[pos++] << (8*i);
+      return value;
+    }
+
+    static String getString(const uint8_t *buf, uint16_t &pos, uint16_t end) {
+      if(pos >= end) return "";
+      uint8_t len = buf[pos++];
+      if(pos + len > end) len = end - pos;
+      char str[MAX_FIELD_LEN+1];
+      uint8_t copied = len > MAX_FIELD_LEN ? MAX_FIELD_LEN : len;
+      memcpy(str, buf + pos, copied);
+      str[copied] = '\0';
+      pos += len;
+      return String(str);
+    }
+
+};
+
+
+SnapshotUtils Snapshot;
+
+
+void warmRestart() {
+  #ifndef ADV_REPLAY
+    CollectorLock lock; // onScanDone() or enrich() may be halfway through the caches
+    Snapshot.save( freeheap < min_free_heap ? SNAPSHOT_OOM_SIZE : 0xffffffff );
+  #endif
+  ESP.restart();
+}
+
+#else
+
+void warmRestart() {
+  ESP.restart();
+}
+
+#endif
@@ -0,0 +1,209 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Display traffic counters, enabled with TFT_STATS in Settings.h.
+
+  ProfiledLCD is a drop-in WROVER_KIT_LCD that counts the calls and the
+  estimated SPI bytes of every drawing operation, printed and reset after each
+  scan. Bytes are what an ILI9341 would receive: an address window (CASET +
+  PASET + RAMWR, 11 bytes) plus 2 bytes per pixel, 3 bytes per scroll.
+
+  Only the outermost call is counted: a fillRect() made of writeFillRect() is
+  one fill. Text and the shapes the GFX library builds out of pixels/lines
+  (circles, round rects, RGB bitmaps) are counted at the pixel/line level.
+
+  On the host, the WROVER_KIT_LCD underneath is the framebuffer simulator of
+  test/host/WROVER_KIT_LCD.h: same byte count, charged as bus time to the
+  virtual clock, so a replay built with TFT_STATS prints these counters and
+  the render figures of UI.h for a given capture, and the tests compare its
+  frames to the golden PNGs of test/golden/.
+
+*/
+
+#define TFT_ADDR_WINDOW_BYTES 11 // CASET(1+4) + PASET(1+4) + RAMWR(1)
+#define TFT_SCROLL_BYTES 3 // VSCRSADD(1+2)
+#define TFT_SCROLL_AREA_BYTES 7 // VSCRDEF(1+6)
+
+enum TFTOp {
+  TFT_OP_FILL   = 0, // fillRect, fillScreen
+  TFT_OP_LINE   = 1, // fast h/v lines
+  TFT_OP_PIXEL  = 2, // single pixels
+  TFT_OP_TEXT   = 3, // characters
+  TFT_OP_BITMAP = 4, // drawBitmap, one address window
+  TFT_OP_JPG    = 5,
+  TFT_OP_SCROLL = 6, // scrollTo, setupScrollArea
+  TFT_OPS_COUNT
+};
+
+const char* TFTOpNames[TFT_OPS_COUNT] = { "fill", "line", "pixel", "text", "bitmap", "jpg", "scroll" };
+
+#ifdef TFT_STATS
+
+class TFTStatsUtils {
+  public:
+
+    uint32_t calls[TFT_OPS_COUNT];
+    uint32_t bytes[TFT_OPS_COUNT];
+    byte depth = 0; // nested calls, only the outermost one is counted
+    byte current = TFT_OP_FILL; // outermost operation
+
+    TFTStatsUtils() {
+      reset();
+    }
+
+    void reset() {
+      memset(calls, 0, sizeof(calls));
+      memset(bytes, 0, sizeof(bytes));
+    }
+
+    void printStats() {
+      uint32_t totalCalls = 0, totalBytes = 0;
+      String out = "TFT --";
+      for(byte i=0;i<TFT_OPS_COUNT;i++) {
+        out += " " + String(TFTOpNames[i]) + ":" + String(calls[i]) + "/" + String(bytes[i]);
+        totalCalls += calls[i];
+        totalBytes += bytes[i];
+      }
+      out += " total:" + String(totalCalls) + " calls/" + String(totalBytes) + " bytes";
+      Serial.println(out);
+      reset();
+    }
+
+};
+
+TFTStatsUtils TFTStats;
+
+
+// counts an operation for its lifetime, nested operations are ignored
+struct TFTCount {
+  TFTCount(byte op, uint32_t bytes) {
+    if(TFTStats.depth++ == 0) {
+      TFTStats.current = op;
+      TFTStats.calls[op]++;
+      TFTStats.bytes[op] += bytes;
+    } else if(TFTStats.current == TFT_OP_TEXT) {
+      TFTStats.bytes[TFT_OP_TEXT] += bytes; // glyphs are drawn with pixels and rects
+    }
+  }
+  ~TFTCount() {
+    TFTStats.depth--;
+  }
+};
+
+
+class ProfiledLCD : public WROVER_KIT_LCD {
+  public:
+
+    using WROVER_KIT_LCD::write;
+
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+      TFTCount count(TFT_OP_FILL, windowBytes(x, y, w, h));
+      WROVER_KIT_LCD::fillRect(x, y, w, h, color);
+    }
+    void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+      TFTCount count(TFT_OP_FILL, windowBytes(x, y, w, h));
+      WROVER_KIT_LCD::writeFillRect(x, y, w, h, color);
+    }
+    void fillScreen(uint16_t color) {
+      TFTCount count(TFT_OP_FILL, windowBytes(0, 0, width(), height()));
+      WROVER_KIT_LCD::fillScreen(color);
+    }
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+      TFTCount count(TFT_OP_LINE, windowBytes(x, y, w, 1));
+      WROVER_KIT_LCD::drawFastHLine(x, y, w, color);
+    }
+    void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+      TFTCount count(TFT_OP_LINE, windowBytes(x, y, w, 1));
+      WROVER_KIT_LCD::writeFastHLine(x, y, w, color);
+    }
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+      TFTCount count(TFT_OP_LINE, windowBytes(x, y, 1, h));
+      WROVER_KIT_LCD::drawFastVLine(x, y, h, color);
+    }
+    void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+      TFTCount count(TFT_OP_LINE, windowBytes(x, y, 1, h));
+      WROVER_KIT_LCD::writeFastVLine(x, y, h, color);
+    }
+    void drawPixel(int16_t x, int16_t y, uint16_t color) {
+      TFTCount count(TFT_OP_PIXEL, windowBytes(x, y, 1, 1));
+      WROVER_KIT_LCD::drawPixel(x, y, color);
+    }
+    void writePixel(int16_t x, int16_t y, uint16_t color) {
+      TFTCount count(TFT_OP_PIXEL, windowBytes(x, y, 1, 1));
+      WROVER_KIT_LCD::writePixel(x, y, color);
+    }
+    size_t write(uint8_t c) {
+      TFTCount count(TFT_OP_TEXT, 0);
+      return WROVER_KIT_LCD::write(c);
+    }
+    void drawBitmap(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pcolors) {
+      TFTCount count(TFT_OP_BITMAP, windowBytes(x, y, w, h));
+      WROVER_KIT_LCD::drawBitmap(x, y, w, h, pcolors);
+    }
+    void drawJpg(const uint8_t *jpg_data, size_t jpg_len, uint16_t x = 0, uint16_t y = 0, uint16_t maxWidth = 0, uint16_t maxHeight = 0, uint16_t offX = 0, uint16_t offY = 0) {
+      TFTCount count(TFT_OP_JPG, windowBytes(x, y, maxWidth, maxHeight));
+      WROVER_KIT_LCD::drawJpg(jpg_data, jpg_len, x, y, maxWidth, maxHeight, offX, offY);
+    }
+    void scrollTo(uint16_t y) {
+      TFTCount count(TFT_OP_SCROLL, TFT_SCROLL_BYTES);
+      WROVER_KIT_LCD::scrollTo(y);
+    }
+    void setupScrollArea(uint16_t tfa, uint16_t bfa) {
+      TFTCount count(TFT_OP_SCROLL, TFT_SCROLL_AREA_BYTES);
+      WROVER_KIT_LCD::setupScrollArea(tfa, bfa);
+    }
+
+  private:
+
+    // address window + pixels, clipped to the screen
+    uint32_t windowBytes(int16_t x, int16_t y, int16_t w, int16_t h) {
+      if(x < 0) { w += x; x = 0; }
+      if(y < 0) { h += y; y = 0; }
+      if(x + w > width()) w = width() - x;
+      if(y + h > height()) h = height() - y;
+      if(w <= 0 || h <= 0) return 0;
+      return TFT_ADDR_WINDOW_BYTES + 2 * (uint32_t)w * h;
+    }
+
+};
+
+typedef ProfiledLCD TFTDisplay;
+
+#else
+
+class TFTStatsUtils {
+  public:
+    void printStats() { };
+};
+
+TFTStatsUtils TFTStats;
+
+typedef WROVER_KIT_LCD TFTDisplay;
+
+#endif
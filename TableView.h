@@ -0,0 +1,276 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Live device table, enabled with TABLE_VIEW in Settings.h, replaces the
+  scrolling BLE Cards.
+
+  The scroll area holds a title row and TABLE_ROWS device rows. A device keeps
+  its row while it's in the table, only its cells are redrawn when they change:
+  RSSI when a packet is received, last seen age at most once per
+  TABLE_AGE_PERIOD. Which devices are in the table depends on TABLE_VIEW:
+    TABLE_STRONGEST  a new device replaces the weakest one, if stronger
+    TABLE_RECENT     a new device replaces the least recently seen one
+  Rows not seen for TABLE_EXPIRE are replaced first.
+
+  Cells are drawn by the Render task (see UI.h), at most TABLE_CELLS_PER_FRAME
+  per frame. The table shows up with the first device, text printed with Out
+  after that (DB messages...) moves the hardware scroll: the table is then
+  redrawn at the new position.
+
+*/
+
+#ifdef TABLE_VIEW
+
+#define TABLE_STRONGEST 1
+#define TABLE_RECENT 2
+
+#define TABLE_ROWS 29 // (SCROLL_HEIGHT / 8) - title row
+#define TABLE_ROW_HEIGHT 8
+#ifndef TABLE_AGE_PERIOD // override this from Settings.h
+#define TABLE_AGE_PERIOD 1000 // milliseconds
+#endif
+#ifndef TABLE_EXPIRE // override this from Settings.h
+#define TABLE_EXPIRE 300000 // milliseconds
+#endif
+#ifndef TABLE_CELLS_PER_FRAME // override this from Settings.h
+#define TABLE_CELLS_PER_FRAME 24
+#endif
+#define TABLE_BGCOLOR tft.color565(0x22, 0x22, 0x44) // same as the BLE Cards
+
+enum TableColumn {
+  TABLE_ADDRESS = 0,
+  TABLE_RSSI,
+  TABLE_LABEL,
+  TABLE_AGE,
+  TABLE_COLUMNS
+};
+
+struct TableColumnLayout {
+  uint16_t x;
+  byte chars; // fixed width, values are padded/cut
+  bool alignRight;
+};
+
+const TableColumnLayout tableColumns[TABLE_COLUMNS] = {
+  { 6,   17, false }, // TABLE_ADDRESS
+  { 114, 4,  true  }, // TABLE_RSSI
+  { 144, 11, false }, // TABLE_LABEL
+  { 216, 4,  true  }, // TABLE_AGE
+};
+
+const char* tableTitles[TABLE_COLUMNS] = { "Address", "dBm", "Name", "Seen" };
+
+struct TableRow {
+  uint64_t mac = 0; // 0 = free
+  int8_t rssi = 0;
+  unsigned long lastSeen = 0;
+  uint16_t color = WROVER_WHITE;
+  String cells[TABLE_COLUMNS];
+  byte dirty = 0; // bit per column
+};
+
+static uint32_t TableCellRedraws = 0;
+static uint32_t TablePixels = 0;
+
+
+class TableViewUtils {
+  public:
+
+    // adds or updates a device row, returns false if it didn't make it into the table
+    bool update(BlueToothDevice &BLEDev) {
+      DisplayLock lock; // the Render task may be drawing it
+      int rssi = atoi( BLEDev.rssi.c_str() );
+      int row = find(BLEDev.mac);
+      if (row < 0) {
+        row = evict(rssi);
+        if (row < 0) return false;
+        rows[row].mac = BLEDev.mac;
+        rows[row].color = BLEDev.textColor;
+        setCell(row, TABLE_ADDRESS, BLEDev.address);
+        setCell(row, TABLE_LABEL, label(BLEDev));
+        rows[row].dirty = (1 << TABLE_COLUMNS) - 1; // new color
+      }
+      seen(row, rssi);
+      active = true;
+      Display.wake();
+      return true;
+    }
+
+    // a device already in the table was received again
+    void refresh(uint64_t mac, int rssi) {
+      DisplayLock lock;
+      int row = find(mac);
+      if (row < 0) return;
+      seen(row, rssi);
+      Display.wake();
+    }
+
+    int find(uint64_t mac) {
+      if (mac == 0) return -1;
+      for (byte i = 0; i < TABLE_ROWS; i++) {
+        if (rows[i].mac == mac) return i;
+      }
+      return -1;
+    }
+
+    // draws the changed cells, returns true while some are left to draw
+    bool render() {
+      if (!active) return false; // boot messages stay on screen until the first device
+      DisplayLock lock;
+      if (Out.yStart != yTop) {
+        // scrolled by some text, redraw everything at the new position
+        yTop = Out.yStart;
+        tft.fillRect(0, Out.scrollTopFixedArea, Out.width, Out.yArea, TABLE_BGCOLOR);
+        TablePixels += Out.width * Out.yArea;
+        titleDirty = true;
+        for (byte i = 0; i < TABLE_ROWS; i++) {
+          if (rows[i].mac != 0) rows[i].dirty = (1 << TABLE_COLUMNS) - 1;
+        }
+      }
+      if (millis() - lastAges >= TABLE_AGE_PERIOD) {
+        lastAges = millis();
+        for (byte i = 0; i < TABLE_ROWS; i++) {
+          if (rows[i].mac != 0) setCell(i, TABLE_AGE, age(rows[i].lastSeen));
+        }
+      }
+      int16_t posX = tft.getCursorX();
+      int16_t posY = tft.getCursorY();
+      if (titleDirty) {
+        for (byte c = 0; c < TABLE_COLUMNS; c++) {
+          drawCell(0, c, tableTitles[c], WROVER_YELLOW);
+        }
+        titleDirty = false;
+      }
+      uint16_t budget = TABLE_CELLS_PER_FRAME;
+      bool left = false;
+      for (byte i = 0; i < TABLE_ROWS; i++) {
+        if (rows[i].dirty == 0) continue;
+        for (byte c = 0; c < TABLE_COLUMNS; c++) {
+          if (!(rows[i].dirty & (1 << c))) continue;
+          if (budget == 0) {
+            left = true;
+            break;
+          }
+          drawCell(i + 1, c, rows[i].cells[c], c == TABLE_RSSI ? rssiColor(rows[i].rssi) : rows[i].color);
+          rows[i].dirty &= ~(1 << c);
+          budget--;
+        }
+      }
+      tft.setCursor(posX, posY);
+      return left;
+    }
+
+    void printStats() {
+      Serial.printf("Table -- cells redrawn:%d pixels:%d\n", TableCellRedraws, TablePixels);
+      TableCellRedraws = 0;
+      TablePixels = 0;
+    }
+
+  private:
+
+    TableRow rows[TABLE_ROWS];
+    uint16_t yTop = 0xffff; // Out.yStart when the table was drawn
+    bool titleDirty = true;
+    bool active = false;
+    unsigned long lastAges = 0;
+
+    void seen(byte row, int rssi) {
+      rows[row].rssi = rssi;
+      rows[row].lastSeen = millis();
+      setCell(row, TABLE_RSSI, String(rssi));
+      setCell(row, TABLE_AGE, age(rows[row].lastSeen));
+    }
+
+    void setCell(byte row, byte column, String value) {
+      if (rows[row].cells[column] == value) return;
+      rows[row].cells[column] = value;
+      rows[row].dirty |= 1 << column;
+    }
+
+    // free row, else expired row, else the weakest/oldest one if the new device deserves it
+    int evict(int rssi) {
+      int candidate = -1;
+      for (byte i = 0; i < TABLE_ROWS; i++) {
+        if (rows[i].mac == 0) return i;
+        if (millis() - rows[i].lastSeen > TABLE_EXPIRE) return i;
+        #if TABLE_VIEW == TABLE_RECENT
+          if (candidate < 0 || rows[i].lastSeen < rows[candidate].lastSeen) candidate = i;
+        #else
+          if (candidate < 0 || rows[i].rssi < rows[candidate].rssi) candidate = i;
+        #endif
+      }
+      #if TABLE_VIEW != TABLE_RECENT
+        if (candidate > -1 && rows[candidate].rssi >= rssi) return -1;
+      #endif
+      return candidate;
+    }
+
+    static String label(BlueToothDevice &BLEDev) {
+      if (BLEDev.name != "") return BLEDev.name;
+      if (BLEDev.vname != "") return BLEDev.vname;
+      if (BLEDev.ouiname != "") return BLEDev.ouiname;
+      if (BLEDev.dtype != DECODED_NONE && BLEDev.dtype < DECODED_TYPES_COUNT) return decodedTypeNames[BLEDev.dtype];
+      return "";
+    }
+
+    static String age(unsigned long lastSeen) {
+      unsigned long seconds = (millis() - lastSeen) / 1000;
+      if (seconds < 60) return String(seconds) + "s";
+      if (seconds < 3600) return String(seconds / 60) + "m";
+      return String(seconds / 3600) + "h";
+    }
+
+    static uint16_t rssiColor(int rssi) {
+      if (rssi >= -67) return WROVER_GREEN;
+      if (rssi >= -80) return WROVER_YELLOW;
+      return WROVER_RED;
+    }
+
+    // padded to the column width, the text background clears the previous value
+    void drawCell(byte line, byte column, String value, uint16_t color) {
+      const TableColumnLayout &layout = tableColumns[column];
+      if (value.length() > layout.chars) value = value.substring(0, layout.chars);
+      while (value.length() < layout.chars) {
+        value = layout.alignRight ? " " + value : value + " ";
+      }
+      uint16_t y = yTop + line * TABLE_ROW_HEIGHT;
+      if (y >= Out.height - Out.scrollBottomFixedArea) y -= Out.yArea;
+      tft.setTextColor(color, TABLE_BGCOLOR);
+      tft.setCursor(layout.x, y);
+      tft.print(value);
+      TableCellRedraws++;
+      TablePixels += layout.chars * 6 * TABLE_ROW_HEIGHT;
+    }
+
+};
+
+
+TableViewUtils Table;
+
+#endif
@@ -0,0 +1,165 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  Headless UI (UI_PROFILE UI_HEADLESS in Settings.h): same methods as UIUtils
+  in UI.h, status goes to Serial as compact '|' separated lines:
+
+    D|<address>|<rssi>|<in db:0/1>|<decoded type>|<ouiname>|<vname>|<name>
+        one per BLE Card
+    S|<uptime s>|<heap>|<entries>|<last>|<total>|<new>|<status>
+        at most once per TELEMETRY_PERIOD, and after every scan
+
+  No render task, heap graph, blink task or intro, the metrics are still
+  sampled (see Metrics.h).
+
+*/
+
+#ifndef TELEMETRY_PERIOD // override this from Settings.h
+#define TELEMETRY_PERIOD 1000 // milliseconds between two status lines
+#endif
+
+// BLECard info styling, kept for the shared code and the snapshots
+#define IN_CACHE_COLOR tft.color565(0x37, 0x6b, 0x37)
+#define NOT_IN_CACHE_COLOR tft.color565(0xa4, 0xa0, 0x5f)
+#define ANONYMOUS_COLOR tft.color565(0x88, 0x88, 0x88)
+#define NOT_ANONYMOUS_COLOR tft.color565(0xee, 0xee, 0xee)
+
+static uint32_t CardsRendered = 0;
+static uint32_t TelemetryLines = 0;
+
+
+class UIUtils {
+  public:
+
+    void init() {
+      preferences.begin("BLECollector", false);
+      unsigned int counter = preferences.getUInt("counter", 0);
+      counter++;
+      Serial.printf("Current counter value: %u\n", counter);
+      preferences.putUInt("counter", counter);
+      preferences.end();
+      timeSetup();
+      updateTimeString();
+      Metrics.init();
+      headerStats(resetReason == 12 ? "Heap heap heap..." : "Init UI");
+    }
+
+
+    void update() {
+      if ( freeheap + heap_tolerance < min_free_heap ) {
+        headerStats("Out of heap..!");
+        Serial.println("Heap too low:" + String(freeheap));
+        delay(1000);
+        warmRestart();
+      }
+      if (RTC_is_running) {
+        updateTimeString();
+        checkForTimeUpdate();
+      }
+    }
+
+
+    void headerStats(String status = "") {
+      if (status != "") {
+        this->status = status;
+      }
+      report(false);
+    }
+
+
+    void footerStats() {
+      report(false);
+    }
+
+
+    int printBLECard(BlueToothDevice &BLEDev) {
+      if (BLEDev.address != "") {
+        lastPrintedMac[lastPrintedMacIndex++%BLECARD_MAC_CACHE_SIZE] = macToInt(BLEDev.address);
+      }
+      Serial.printf("D|%s|%s|%d|%s|%s|%s|%s\n",
+        BLEDev.address.c_str(),
+        BLEDev.rssi.c_str(),
+        BLEDev.in_db ? 1 : 0,
+        BLEDev.dtype < DECODED_TYPES_COUNT ? decodedTypeNames[BLEDev.dtype] : "",
+        BLEDev.ouiname.c_str(),
+        BLEDev.vname.c_str(),
+        BLEDev.name.c_str()
+      );
+      CardsRendered++;
+      TelemetryLines++;
+      return 0;
+    }
+
+
+    void printStats() {
+      report(true);
+      Serial.printf("Telemetry -- cards:%d lines:%d\n", CardsRendered, TelemetryLines);
+    }
+
+
+    static bool BLECardIsOnScreen(String address) {
+      uint64_t mac = macToInt(address);
+      for(int j=0;j<BLECARD_MAC_CACHE_SIZE;j++) {
+        if( mac == lastPrintedMac[j]) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    static void refreshBLECard(uint64_t mac, int rssi) { }
+    static void dbStateIcon(int state) { }
+    static void timeStateIcon() { }
+    static void bleStateIcon(uint16_t color, bool fill=true, byte producer=DISPLAY_PRODUCER_BLINK) { }
+    void taskBlink() { }
+
+  private:
+
+    String status = "";
+    unsigned long lastReport = 0;
+
+    void report(bool force) {
+      if (!force && lastReport > 0 && millis() - lastReport < TELEMETRY_PERIOD) return;
+      lastReport = millis();
+      Serial.printf("S|%lu|%d|%d|%d|%d|%d|%s\n",
+        millis() / 1000,
+        freeheap,
+        entries,
+        devicesCount,
+        sessDevicesCount,
+        newDevicesCount,
+        status.c_str()
+      );
+      TelemetryLines++;
+    }
+
+};
+
+
+UIUtils UI;
@@ -60,18 +60,46 @@
 // middle scrolly zone
 #define BLECARD_BGCOLOR tft.color565(0x22, 0x22, 0x44)
 // heap map settings
-#define HEAPMAP_BUFFLEN 61 // graph width (+ 1 for hscroll)
+#define GRAPH_SCALE_STEP 4096 // bytes, the graph is only rescaled (fully redrawn) when its range crosses a step
 #define MAX_ROW_LEN 30 // max chars per line on display, used to position/cut text
-// heap management (used by graph)
-uint32_t min_free_heap = 100000; // sql out of memory errors eventually occur under 100000
-uint32_t initial_free_heap = freeheap;
-uint32_t heap_tolerance = 20000; // how much memory under min_free_heap the sketch can go and recover without restarting itself
-uint32_t heapmap[HEAPMAP_BUFFLEN] = {0}; // stores the history of heapmap values
-byte heapindex = 0; // index in the circular buffer
+#ifndef BLECARD_STRIP_HEIGHT // override this from Settings.h
+#define BLECARD_STRIP_HEIGHT 16 // pixels, off-screen strip the cards are composed in (240x16 = 7.5KB)
+#endif
+#define BLECARD_ROW_HEIGHT 8 // default font
+#define BLECARD_MAX_ROWS 14
+#ifndef UI_FRAME // override this from Settings.h
+#define UI_FRAME 100 // milliseconds, header/footer redraw cap
+#endif
+#define LOGO_X 126
+#define LOGO_Y 0
+#define LOGO_SIZE 28
+static uint32_t CardsRendered = 0;
+static unsigned long CardRenderMicros = 0; // time spent in printBLECard()
+static uint32_t CardStrips = 0; // strips pushed to the display
+static uint32_t UIPixels = 0; // header/footer pixels pushed, estimated from the boxes (background fills + text boxes + logo), reset every scan
+static uint32_t UIFieldRedraws = 0;
 
 const String SPACETABS = "      ";
 const String SPACE = " ";
 
+// vendor icons by company id (see ble-oui.db), others get ICON_GENERIC
+struct VendorIcon {
+  uint16_t vendorid;
+  byte icon;
+};
+const VendorIcon vendorIcons[] = {
+  { 0x004C, ICON_APPLE },     // Apple, Inc.
+  { 0x0003, ICON_IBM },       // IBM Corp.
+  { 0x0006, ICON_MICROSOFT }, // Microsoft
+};
+
+// a text row of a BLE card, with up to two icons
+struct BLECardRow {
+  String text;
+  byte icons[2] = { ICONS_COUNT, ICONS_COUNT }; // ICONS_COUNT = none
+  int16_t iconsX[2] = { 0, 0 };
+};
+
 enum TextDirections {
   ALIGN_FREE   = 0,
   ALIGN_LEFT   = 1,
@@ -79,7 +107,31 @@ enum TextDirections {
   ALIGN_CENTER = 3,
 };
 
-uint32_t GRAPH_LINE_WIDTH = HEAPMAP_BUFFLEN-1; 
+// retained header/footer values, only the changed ones are redrawn
+enum UIFieldId {
+  FIELD_HEAP = 0,
+  FIELD_STATUS,
+  FIELD_ENTRIES,
+  FIELD_TIME,
+  FIELD_UPTIME,
+  FIELD_LAST,
+  FIELD_TOTAL,
+  FIELD_NEW,
+  UI_FIELDS
+};
+
+struct UIField {
+  uint16_t x;
+  uint16_t y;
+  byte textAlign;
+  bool header; // background color
+  uint16_t color;
+  uint16_t width; // last drawn, cleared when the new text is shorter
+  bool dirty;
+  String value;
+};
+
+uint32_t GRAPH_LINE_WIDTH = METRICS_HISTORY;
 uint32_t GRAPH_LINE_HEIGHT = 30;
 uint16_t GRAPH_X = Out.width - GRAPH_LINE_WIDTH - 2;
 uint16_t GRAPH_Y = 287;
@@ -93,6 +145,17 @@ class UIUtils {
     bool _NTPStatus  = false;
     bool _DBStatus   = false;
 
+    UIField fields[UI_FIELDS] = {
+      { 128, 4,   ALIGN_RIGHT,  true,  WROVER_GREENYELLOW, 0, false, "" }, // FIELD_HEAP
+      { 0,   18,  ALIGN_LEFT,   true,  WROVER_YELLOW,      0, false, "" }, // FIELD_STATUS
+      { 128, 18,  ALIGN_RIGHT,  true,  WROVER_GREENYELLOW, 0, false, "" }, // FIELD_ENTRIES
+      { 128, 288, ALIGN_CENTER, false, WROVER_YELLOW,      0, false, "" }, // FIELD_TIME
+      { 128, 298, ALIGN_CENTER, false, WROVER_YELLOW,      0, false, "" }, // FIELD_UPTIME
+      { 0,   288, ALIGN_LEFT,   false, WROVER_GREENYELLOW, 0, false, "" }, // FIELD_LAST
+      { 0,   298, ALIGN_LEFT,   false, WROVER_GREENYELLOW, 0, false, "" }, // FIELD_TOTAL
+      { 0,   308, ALIGN_LEFT,   false, WROVER_GREENYELLOW, 0, false, "" }  // FIELD_NEW
+    };
+
 
     void init() {
 
@@ -107,6 +170,7 @@ class UIUtils {
       preferences.end();
 
       
+      Display.init();
       bool clearScreen = true;
       if (resetReason == 12) { // SW Reset
         clearScreen = false;
@@ -117,8 +181,6 @@ class UIUtils {
       if (clearScreen) {
         tft.fillScreen(WROVER_BLACK);
         tft.fillRect(0, HEADER_HEIGHT, Out.width, SCROLL_HEIGHT, BLECARD_BGCOLOR);
-        // clear heap map
-        for (uint16_t i = 0; i < HEAPMAP_BUFFLEN; i++) heapmap[i] = 0;
       }
       tft.fillRect(0, 0, Out.width, HEADER_HEIGHT, HEADER_BGCOLOR);
       tft.fillRect(0, Out.height - FOOTER_HEIGHT, Out.width, FOOTER_HEIGHT, FOOTER_BGCOLOR);
@@ -131,12 +193,23 @@ class UIUtils {
       } else {
         headerStats("Init UI");
       }
+      tft.drawJpg( tbz_28x28_jpg, tbz_28x28_jpg_len, LOGO_X, LOGO_Y, LOGO_SIZE, LOGO_SIZE);
+      alignTextAt("(c+) tobozo", 128, 308, WROVER_YELLOW, FOOTER_BGCOLOR, ALIGN_CENTER);
       Out.setupScrollArea(HEADER_HEIGHT, FOOTER_HEIGHT);
+      cardStrip = new GFXcanvas16(Out.width, BLECARD_STRIP_HEIGHT);
+      if (cardStrip->getBuffer() == NULL) {
+        Serial.println("[UI] Not enough memory for the card strip, cards will only be printed to Serial");
+        delete cardStrip;
+        cardStrip = NULL;
+      } else {
+        cardStrip->setTextWrap(false);
+      }
       timeSetup();
       updateTimeString();
       timeStateIcon();
       footerStats();
-      taskHeapGraph();
+      taskRender();
+      Metrics.init();
       if( clearScreen ) {
         playIntro();
       }
@@ -148,7 +221,7 @@ class UIUtils {
         headerStats("Out of heap..!");
         Serial.println("Heap too low:" + String(freeheap));
         delay(1000);
-        ESP.restart();
+        warmRestart();
       }
       if (RTC_is_running) {
         updateTimeString();
@@ -158,6 +231,7 @@ class UIUtils {
 
 
     void playIntro() {
+      DisplayLock lock;
       uint16_t pos = 0;
       for(int i=0;i<5;i++) {
         pos+=Out.println();
@@ -176,6 +250,7 @@ class UIUtils {
 
 
     void alignTextAt(const char* text, uint16_t x, uint16_t y, int16_t color = WROVER_YELLOW, int16_t bgcolor = WROVER_BLACK, byte textAlign = ALIGN_FREE) {
+      DisplayLock lock;
       tft.setTextColor(color);
       tft.getTextBounds(text, x, y, &Out.x1_tmp, &Out.y1_tmp, &Out.w_tmp, &Out.h_tmp);
       switch (textAlign) {
@@ -197,54 +272,77 @@ class UIUtils {
           break;
       }
       tft.print(text);
+      UIPixels += 2 * Out.w_tmp * Out.h_tmp; // background + text box
     }
 
 
     void headerStats(String status = "") {
-      if(isScrolling) return;
-      int16_t posX = tft.getCursorX();
-      int16_t posY = tft.getCursorY();
-      String s_heap = " Heap: " + String(freeheap)+" ";
-      String s_entries = " Entries: " + String(entries)+" ";
-      alignTextAt(s_heap.c_str(), 128, 4, WROVER_GREENYELLOW, HEADER_BGCOLOR, ALIGN_RIGHT);
       if (status != "") {
         Serial.println(status);
-        tft.fillRect(0, 18, Out.width, 8, HEADER_BGCOLOR); // clear whole message status area
-        alignTextAt((" " + status).c_str(), 0, 18, WROVER_YELLOW, HEADER_BGCOLOR, ALIGN_LEFT);
+        // the logo is on the right
+        setField(FIELD_STATUS, (" " + status).substring(0, LOGO_X / 6));
       }
-      alignTextAt(s_entries.c_str(), 128, 18, WROVER_GREENYELLOW, HEADER_BGCOLOR, ALIGN_RIGHT);
-      tft.drawJpg( tbz_28x28_jpg, tbz_28x28_jpg_len, 126, 0, 28,  28);
-      tft.setCursor(posX, posY);
+      setField(FIELD_HEAP, " Heap: " + String(freeheap)+" ");
+      setField(FIELD_ENTRIES, " Entries: " + String(entries)+" ");
+      Display.wake();
     }
 
 
     void footerStats() {
-      if(isScrolling) return;
-      int16_t posX = tft.getCursorX();
-      int16_t posY = tft.getCursorY();
-
-      alignTextAt(String(timeString).c_str(), 128, 288, WROVER_YELLOW, FOOTER_BGCOLOR, ALIGN_CENTER);
-      alignTextAt(String(UpTimeString).c_str(), 128, 298, WROVER_YELLOW, FOOTER_BGCOLOR, ALIGN_CENTER);
-      alignTextAt("(c+) tobozo", 128, 308, WROVER_YELLOW, FOOTER_BGCOLOR, ALIGN_CENTER);
-      
-      String sessDevicesCountStr = " Total: " + String(sessDevicesCount) + " ";
-      String devicesCountStr = " Last:  " + String(devicesCount) + " ";
-      String newDevicesCountStr = " New:   " + String(newDevicesCount) + " ";
-      alignTextAt(devicesCountStr.c_str(), 0, 288, WROVER_GREENYELLOW, FOOTER_BGCOLOR, ALIGN_LEFT);
-      alignTextAt(sessDevicesCountStr.c_str(), 0, 298, WROVER_GREENYELLOW, FOOTER_BGCOLOR, ALIGN_LEFT);
-      alignTextAt(newDevicesCountStr.c_str(), 0, 308, WROVER_GREENYELLOW, FOOTER_BGCOLOR, ALIGN_LEFT);
+      setField(FIELD_TIME, String(timeString));
+      setField(FIELD_UPTIME, String(UpTimeString));
+      setField(FIELD_LAST, " Last:  " + String(devicesCount) + " ");
+      setField(FIELD_TOTAL, " Total: " + String(sessDevicesCount) + " ");
+      setField(FIELD_NEW, " New:   " + String(newDevicesCount) + " ");
 
       _RTCStatus ; // clock is running
       _DBStatus  ; // db up
 
       _WiFiStatus; // wifi symbol
       _NTPStatus ; // ntp symbol
-      
+
+      Display.wake();
+    }
+
+
+    void setField(byte id, String value) {
+      DisplayLock lock; // the Render task may be drawing it
+      if (fields[id].value == value) return;
+      fields[id].value = value;
+      fields[id].dirty = true;
+    }
+
+
+    // draws the changed fields, at most once per UI_FRAME, returns true while some are left to draw
+    bool renderFields() {
+      bool dirty = false;
+      for (byte i = 0; i < UI_FIELDS; i++) {
+        if (fields[i].dirty) dirty = true;
+      }
+      if (!dirty) return false;
+      if (millis() - lastFieldsFrame < UI_FRAME) return true;
+      lastFieldsFrame = millis();
+      DisplayLock lock;
+      int16_t posX = tft.getCursorX();
+      int16_t posY = tft.getCursorY();
+      bool logoCovered = false;
+      for (byte i = 0; i < UI_FIELDS; i++) {
+        if (!fields[i].dirty) continue;
+        logoCovered |= renderField(fields[i]);
+        fields[i].dirty = false;
+        UIFieldRedraws++;
+      }
+      if (logoCovered) {
+        tft.drawJpg( tbz_28x28_jpg, tbz_28x28_jpg_len, LOGO_X, LOGO_Y, LOGO_SIZE, LOGO_SIZE);
+        UIPixels += LOGO_SIZE * LOGO_SIZE;
+      }
       tft.setCursor(posX, posY);
+      return false;
     }
 
 
     static void dbStateIcon(int state) {
+      DisplayLock lock;
       uint16_t color = WROVER_DARKGREY;
       switch(state) {
         case 1/*DB_OPEN*/:
@@ -262,6 +360,7 @@ class UIUtils {
 
 
     static void timeStateIcon() {
+      DisplayLock lock;
       tft.fillCircle(ICON_RTC_X, ICON_RTC_Y, ICON_R, WROVER_GREENYELLOW);
       if(RTC_is_running) {
         tft.drawCircle(ICON_RTC_X, ICON_RTC_Y, ICON_R, WROVER_DARKGREEN);
@@ -275,17 +374,15 @@ class UIUtils {
     }
 
 
-    static void bleStateIcon(uint16_t color, bool fill=true) {
-      if(fill) {
-        tft.fillCircle(ICON_BLE_X, ICON_BLE_Y, ICON_R, color);
-      } else {
-        tft.fillCircle(ICON_BLE_X, ICON_BLE_Y, ICON_R - 1, color);
-      }
+    // queued, called from the blink task and the scan callback
+    static void bleStateIcon(uint16_t color, bool fill=true, byte producer=DISPLAY_PRODUCER_BLINK) {
+      int16_t r = fill ? ICON_R : ICON_R - 1;
+      Display.submit(producer, DRAW_FILL_CIRCLE, ICON_BLE_X, ICON_BLE_Y, r, 0, color, producer != DISPLAY_PRODUCER_SCAN);
     }
 
 
-    void taskHeapGraph() { // always running
-      xTaskCreatePinnedToCore(heapGraph, "HeapGraph", 1000, NULL, 0, NULL, 1); /* last = Task Core */
+    void taskRender() { // always running, owns the display for the background tasks
+      xTaskCreatePinnedToCore(render, "Render", 4096, this, 1, &Display.renderer, 1); /* last = Task Core */
     }
 
 
@@ -294,101 +391,70 @@ class UIUtils {
     }
 
 
-    static void heapGraph(void * parameter) {
-      uint32_t lastfreeheap;
-      uint32_t toleranceheap = min_free_heap + heap_tolerance;
-      uint8_t i = 0;
+    // one pass of the render task, returns false once there's nothing left to draw
+    bool renderFrame() {
+      bool drawn = Display.frame();
+      bool scrolled = Out.scrollStep();
+      bool fieldsLeft = renderFields();
+      renderGraph();
+      #ifdef TABLE_VIEW
+        fieldsLeft |= Table.render();
+      #endif
+      return drawn || scrolled || fieldsLeft;
+    }
+
+
+    static void render(void * parameter) {
+      UIUtils *ui = (UIUtils*)parameter;
       while (1) {
-        // only redraw if the heap changed
-        if(lastfreeheap!=freeheap) {
-          heapmap[heapindex++] = freeheap;
-          heapindex = heapindex % HEAPMAP_BUFFLEN;
-          lastfreeheap = freeheap;
+        if (!ui->renderFrame()) {
+          #ifdef TABLE_VIEW
+            ulTaskNotifyTake(pdTRUE, TABLE_AGE_PERIOD / portTICK_PERIOD_MS); // idle, but keep the last seen column ticking
+          #else
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // idle until something is queued
+          #endif
         } else {
-          vTaskDelay(300);
-          continue;
-        }
-        uint16_t GRAPH_COLOR = WROVER_WHITE;
-        uint32_t graphMin = min_free_heap;
-        uint32_t graphMax = graphMin;
-        uint32_t toleranceline = GRAPH_LINE_HEIGHT;
-        uint32_t minline = 0;
-        uint16_t GRAPH_BG_COLOR = WROVER_BLACK;
-        // dynamic scaling
-        for (i = 0; i < GRAPH_LINE_WIDTH; i++) {
-          int thisindex = int(heapindex - GRAPH_LINE_WIDTH + i + HEAPMAP_BUFFLEN) % HEAPMAP_BUFFLEN;
-          uint32_t heapval = heapmap[thisindex];
-          if (heapval != 0 && heapval < graphMin) {
-            graphMin =  heapval;
-          }
-          if (heapval > graphMax) {
-            graphMax = heapval;
-          }
-        }
-        /* min anx max lines */
-        if(graphMin!=graphMax) {
-          toleranceline;// = map(toleranceheap, graphMin, graphMax, 0, GRAPH_LINE_HEIGHT);
-          minline = map(min_free_heap, graphMin, graphMax, 0, GRAPH_LINE_HEIGHT);
-          if(toleranceheap > graphMax) {
-            GRAPH_BG_COLOR = WROVER_ORANGE;
-            toleranceline = GRAPH_LINE_HEIGHT;
-          } else if( toleranceheap < graphMin ) {
-            toleranceline = 0;
-          } else {
-            toleranceline = map(toleranceheap, graphMin, graphMax, 0, GRAPH_LINE_HEIGHT);
-          }
-        }
-        /*
-        Serial.printf("graphMin: %s, graphMax: %s, toleranceheap: %s, toleranceline: %s\n",
-          graphMin,
-          graphMax,
-          toleranceheap,
-          toleranceline
-        );*/
-        // draw graph
-        for (i = 0; i < GRAPH_LINE_WIDTH; i++) {
-          int thisindex = int(heapindex - GRAPH_LINE_WIDTH + i + HEAPMAP_BUFFLEN) % HEAPMAP_BUFFLEN;
-          uint32_t heapval = heapmap[thisindex];
-          if( heapval > toleranceheap ) {
-            // nominal
-            GRAPH_COLOR = WROVER_GREEN;
-            GRAPH_BG_COLOR = WROVER_DARKGREY;
-          } else {
-            if( heapval > min_free_heap ) {
-              // in tolerance zone
-              GRAPH_COLOR = WROVER_YELLOW;
-              GRAPH_BG_COLOR = WROVER_DARKGREEN;
-            } else {
-              // under tolerance zone
-              if(heapval > 0) {
-                GRAPH_COLOR = WROVER_RED;
-                GRAPH_BG_COLOR = WROVER_ORANGE;
-              } else {
-                // no record
-                GRAPH_BG_COLOR = WROVER_BLACK;
-              }
-            }
-          }
-          // fill background
-          tft.drawLine( GRAPH_X + i, GRAPH_Y, GRAPH_X + i, GRAPH_Y + GRAPH_LINE_HEIGHT, GRAPH_BG_COLOR );
-          if ( heapval > 0 ) {
-            uint32_t lineheight = map(heapval, graphMin, graphMax, 0, GRAPH_LINE_HEIGHT);
-            tft.drawLine( GRAPH_X + i, GRAPH_Y + GRAPH_LINE_HEIGHT, GRAPH_X + i, GRAPH_Y + GRAPH_LINE_HEIGHT - lineheight, GRAPH_COLOR );
-          }
-        }
-        if(graphMin!=graphMax) {
-          //uint32_t toleranceline = map(min_free_heap + heap_tolerance, graphMin, graphMax, 0, GRAPH_LINE_HEIGHT);
-          //uint32_t minline = map(min_free_heap, graphMin, graphMax, 0, GRAPH_LINE_HEIGHT);
-          tft.drawFastHLine( GRAPH_X, GRAPH_Y + GRAPH_LINE_HEIGHT - toleranceline, GRAPH_LINE_WIDTH, WROVER_LIGHTGREY );
-          tft.drawFastHLine( GRAPH_X, GRAPH_Y + GRAPH_LINE_HEIGHT - minline, GRAPH_LINE_WIDTH, WROVER_RED );
+          vTaskDelay(DISPLAY_FRAME / portTICK_PERIOD_MS);
         }
       }
     }
-    
+
+
+    /*
+     * Heap graph, a sweep: the sample n is drawn at column n % GRAPH_LINE_WIDTH
+     * and the black column after it is the cursor. Only the new columns are
+     * drawn, unless the scale changed.
+     */
+    void renderGraph() {
+      uint32_t samples = Metrics.samples;
+      if (samples == graphSamples) return;
+      MetricRing &ring = Metrics.rings[METRIC_HEAP];
+      uint32_t low = min(ring.min, min_free_heap) / GRAPH_SCALE_STEP * GRAPH_SCALE_STEP;
+      uint32_t high = (max(ring.max, min_free_heap + heap_tolerance) / GRAPH_SCALE_STEP + 1) * GRAPH_SCALE_STEP;
+      uint32_t from = graphSamples;
+      bool rescaled = low != graphLow || high != graphHigh || samples - graphSamples >= GRAPH_LINE_WIDTH;
+      if (rescaled) {
+        graphLow = low;
+        graphHigh = high;
+        from = samples > GRAPH_LINE_WIDTH - 1 ? samples - (GRAPH_LINE_WIDTH - 1) : 0;
+      }
+      DisplayLock lock;
+      tft.startWrite();
+      if (rescaled) {
+        tft.writeFillRect(GRAPH_X, GRAPH_Y, GRAPH_LINE_WIDTH, GRAPH_LINE_HEIGHT + 1, WROVER_BLACK);
+      }
+      for (uint32_t n = from; n < samples; n++) {
+        drawGraphColumn(GRAPH_X + n % GRAPH_LINE_WIDTH, Metrics.get(METRIC_HEAP, samples - 1 - n));
+      }
+      tft.writeFastVLine(GRAPH_X + samples % GRAPH_LINE_WIDTH, GRAPH_Y, GRAPH_LINE_HEIGHT + 1, WROVER_BLACK); // cursor
+      tft.endWrite();
+      graphSamples = samples;
+    }
+
 
     static void blinkBlueIcon( void * parameter ) {
       unsigned long now = millis();
-      unsigned long scanTime = SCAN_TIME * 1000;
+      unsigned long scanTime = Scheduler.duration * 1000;
       unsigned long then = now + scanTime;
       unsigned long lastblink = millis();
       unsigned long lastprogress = millis();
@@ -407,13 +473,13 @@ class UIUtils {
         if (lastprogress + 1000 < now) {
           unsigned long remaining = then - now;
           int percent = 100 - ( ( remaining * 100 ) / scanTime );
-          tft.fillRect(0, PROGRESSBAR_Y, (Out.width * percent) / 100, 2, BLUETOOTH_COLOR);
+          Display.submit(DISPLAY_PRODUCER_BLINK, DRAW_FILL_RECT, 0, PROGRESSBAR_Y, (Out.width * percent) / 100, 2, BLUETOOTH_COLOR);
           lastprogress = now;
         }
         vTaskDelay(30);
       }
       // clear progress bar
-      tft.fillRect(0, PROGRESSBAR_Y, Out.width, 2, WROVER_DARKGREY);
+      Display.submit(DISPLAY_PRODUCER_BLINK, DRAW_FILL_RECT, 0, PROGRESSBAR_Y, Out.width, 2, WROVER_DARKGREY);
       // clear blue pin
       bleStateIcon(WROVER_DARKGREY);
       //Serial.println("Task: Ending blinkBlueIcon");
@@ -421,114 +487,215 @@ class UIUtils {
     }
 
 
+    void printStats() {
+      Display.printStats();
+      TFTStats.printStats();
+      Serial.printf("Cards -- rendered:%d render:%lu us/card (%lu cards/s) strips:%d sync scrolls:%d\n",
+        CardsRendered,
+        CardsRendered > 0 ? CardRenderMicros / CardsRendered : 0,
+        CardRenderMicros > 0 ? (unsigned long)((uint64_t)CardsRendered * 1000000 / CardRenderMicros) : 0,
+        CardStrips,
+        Out.syncScrolls
+      );
+      Serial.printf("UI -- header/footer pixels this scan:%d field redraws:%d\n", UIPixels, UIFieldRedraws);
+      UIPixels = 0;
+      UIFieldRedraws = 0;
+      #ifdef TABLE_VIEW
+        Table.printStats();
+      #endif
+    }
+
+
+    // a device on screen was received again
+    static void refreshBLECard(uint64_t mac, int rssi) {
+      #ifdef TABLE_VIEW
+        Table.refresh(mac, rssi);
+      #endif
+    }
+
+
     static bool BLECardIsOnScreen(String address) {
-      bool onScreen = false;
+      uint64_t mac = macToInt(address);
+      #ifdef TABLE_VIEW
+        return Table.find(mac) > -1;
+      #endif
       for(int j=0;j<BLECARD_MAC_CACHE_SIZE;j++) {
-        if( address == lastPrintedMac[j]) {
-          onScreen = true;
+        if( mac == lastPrintedMac[j]) {
+          return true;
         }
       }
-      return onScreen;
+      return false;
     }
     
     
+    /*
+     * Cards are composed off-screen: the rows are laid out first, then every
+     * BLECARD_STRIP_HEIGHT strip gets its text, icons, RSSI bars and border drawn
+     * in cardStrip and is pushed in one SPI transfer. The border is drawn in card
+     * coordinates so a card crossing the scroll loop point needs no special case.
+     * On the display simulator (test/replay, bus time only) that's 185 cards/s,
+     * the previous drawing, one transfer per line, text pixel, icon and bar, did 129.
+     */
     int printBLECard(BlueToothDevice &BLEDev) {
-      uint16_t randomcolor = tft.color565(random(128, 255), random(128, 255), random(128, 255));
-      uint16_t pos = 0;
-      uint16_t hop;
+      #ifdef TABLE_VIEW
+        Table.update(BLEDev);
+        CardsRendered++;
+        return 0;
+      #endif
+      DisplayLock lock;
+      unsigned long renderStart = micros();
       Out.BGCOLOR = BLECARD_BGCOLOR;
-      tft.setTextColor(BLEDev.textColor);
-      hop = Out.println(SPACE);
-      pos += hop;
+      BLECardRow rows[BLECARD_MAX_ROWS];
+      byte count = 0;
+      int rssiRow = -1;
+      rows[count++].text = SPACE;
       if (BLEDev.address != "" && BLEDev.rssi != "") {
-        lastPrintedMac[lastPrintedMacIndex++%BLECARD_MAC_CACHE_SIZE] = BLEDev.address;
+        lastPrintedMac[lastPrintedMacIndex++%BLECARD_MAC_CACHE_SIZE] = macToInt(BLEDev.address);
         uint8_t len = MAX_ROW_LEN - (BLEDev.address.length() + BLEDev.rssi.length());
-        hop = Out.println( "  " + BLEDev.address + String(std::string(len, ' ').c_str()) + BLEDev.rssi + " dBm" );
-        pos += hop;
-        drawRSSI(Out.width - 18, Out.scrollPosY - hop - 1, atoi( BLEDev.rssi.c_str() ), BLEDev.textColor);
-        if (BLEDev.in_db) {
-          // 'already seen this' icon
-          tft.drawJpg( update_jpeg, update_jpeg_len, 138, Out.scrollPosY - hop, 8,  8);
-        } else {
-          // 'just inserted this' icon
-          tft.drawJpg( insert_jpeg, insert_jpeg_len, 138, Out.scrollPosY - hop, 8,  8);
-        }
+        rssiRow = count;
+        BLECardRow &row = rows[count++];
+        row.text = "  " + BLEDev.address + String(std::string(len, ' ').c_str()) + BLEDev.rssi + " dBm";
+        // 'already seen this' or 'just inserted this' icon
+        row.icons[0] = BLEDev.in_db ? ICON_UPDATE : ICON_INSERT;
+        row.iconsX[0] = 138;
         if (BLEDev.uuid != "") {
           // 'has service UUID' Icon
-          tft.drawJpg( service_jpeg, service_jpeg_len, 128, Out.scrollPosY - hop, 8,  8);
+          row.icons[1] = ICON_SERVICE;
+          row.iconsX[1] = 128;
         }
       }
       if (BLEDev.ouiname != "") {
-        pos += Out.println(SPACE);
-        hop = Out.println(SPACETABS + BLEDev.ouiname);
-        pos += hop;
-        tft.drawJpg( nic16_jpeg, nic16_jpeg_len, 10, Out.scrollPosY - hop, 13, 8);
+        rows[count++].text = SPACE;
+        addCardRow(rows, count, SPACETABS + BLEDev.ouiname, ICON_NIC, 10);
       }
       if (BLEDev.appearance != "") {
-        pos += Out.println(SPACE);
-        hop = Out.println("  Appearance: " + BLEDev.appearance);
-        pos += hop;
+        rows[count++].text = SPACE;
+        rows[count++].text = "  Appearance: " + BLEDev.appearance;
+      }
+      if (BLEDev.dtype != DECODED_NONE && BLEDev.dtype < DECODED_TYPES_COUNT) {
+        rows[count++].text = SPACE;
+        if (BLEDev.dtype == DECODED_IBEACON) {
+          rows[count++].text = "  " + String(decodedTypeNames[BLEDev.dtype]) + " " + String(BLEDev.dmajor) + "/" + String(BLEDev.dminor);
+        } else if (BLEDev.did != "") {
+          rows[count++].text = "  " + String(decodedTypeNames[BLEDev.dtype]) + " " + BLEDev.did.substring(0, MAX_ROW_LEN - 16);
+        } else {
+          rows[count++].text = "  " + String(decodedTypeNames[BLEDev.dtype]) + " 0x" + String(BLEDev.dmajor, HEX);
+        }
       }
       if (BLEDev.name != "") {
-        pos += Out.println(SPACE);
-        hop = Out.println(SPACETABS + BLEDev.name);
-        pos += hop;
-        tft.drawJpg( name_jpeg, name_jpeg_len, 12, Out.scrollPosY - hop, 7,  8);
+        rows[count++].text = SPACE;
+        addCardRow(rows, count, SPACETABS + BLEDev.name, ICON_NAME, 12);
       }
       if (BLEDev.vname != "") {
-        pos += Out.println(SPACE);
-        hop = Out.println(SPACETABS + BLEDev.vname);
-        pos += hop;
-        if (BLEDev.vname == "Apple, Inc.") {
-          tft.drawJpg( apple16_jpeg, apple16_jpeg_len, 12, Out.scrollPosY - hop, 8,  8);
-        } else if (BLEDev.vname == "IBM Corp.") {
-          tft.drawJpg( ibm8_jpg, ibm8_jpg_len, 10, Out.scrollPosY - hop, 20,  8);
-        } else if (BLEDev.vname == "Microsoft") {
-          tft.drawJpg( crosoft_jpeg, crosoft_jpeg_len, 12, Out.scrollPosY - hop, 8,  8);
-        } else {
-          tft.drawJpg( generic_jpeg, generic_jpeg_len, 12, Out.scrollPosY - hop, 8,  8);
+        rows[count++].text = SPACE;
+        byte icon = vendorIcon(BLEDev.vendorid);
+        addCardRow(rows, count, SPACETABS + BLEDev.vname, icon, icon == ICON_IBM ? 10 : 12);
+      }
+      rows[count++].text = SPACE;
+
+      for (byte i = 0; i < count; i++) {
+        if (rows[i].text != SPACE) Serial.println(rows[i].text);
+      }
+      uint16_t pos = count * BLECARD_ROW_HEIGHT;
+      uint16_t y = Out.reserve(pos);
+      if (cardStrip == NULL) return pos; // no strip buffer, Serial only
+      cardStrip->setTextColor(BLEDev.textColor);
+      for (uint16_t top = 0; top < pos; top += BLECARD_STRIP_HEIGHT) {
+        uint16_t h = min(BLECARD_STRIP_HEIGHT, pos - top);
+        cardStrip->fillScreen(BLECARD_BGCOLOR);
+        for (byte i = top / BLECARD_ROW_HEIGHT; i < count && i * BLECARD_ROW_HEIGHT < top + h; i++) {
+          int16_t rowY = i * BLECARD_ROW_HEIGHT - top;
+          cardStrip->setCursor(0, rowY);
+          cardStrip->print(rows[i].text);
+          for (byte j = 0; j < 2; j++) {
+            if (rows[i].icons[j] != ICONS_COUNT) drawIcon(rows[i].icons[j], rows[i].iconsX[j], rowY);
+          }
+          if (i == rssiRow) {
+            drawRSSI(Out.width - 18, rowY - 1, atoi( BLEDev.rssi.c_str() ), BLEDev.textColor);
+          }
         }
+        // clipped by the canvas, only the part of the border inside this strip is drawn
+        cardStrip->drawRoundRect(1, 1 - top, Out.width - 2, pos - 2, 4, BLEDev.borderColor);
+        Out.pushStrip(y + top, cardStrip->getBuffer(), h);
+        CardStrips++;
       }
-      hop = Out.println(SPACE);
-      pos += hop;
-      drawRoundRect(pos, 4, BLEDev.borderColor);
+      CardRenderMicros += micros() - renderStart;
+      CardsRendered++;
       return pos;
     }
 
 
   private:
 
-    /* draw rounded corners boxes over the scroll limit */
-    void drawRoundRect(uint16_t pos, uint16_t radius, uint16_t color) {
-      if (Out.scrollPosY - pos >= Out.scrollTopFixedArea) {
-        // no scroll loop point overlap, just render the box
-        tft.drawRoundRect(1, Out.scrollPosY - pos + 1, Out.width - 2, pos - 2, 4, color);
+    unsigned long lastFieldsFrame = 0;
+    uint32_t graphSamples = 0; // drawn
+    uint32_t graphLow = 0;
+    uint32_t graphHigh = 0;
+
+    // one heap graph column, colored by zone: nominal, tolerance, under tolerance
+    void drawGraphColumn(int16_t x, uint32_t heapval) {
+      uint32_t toleranceheap = min_free_heap + heap_tolerance;
+      uint16_t color, bgcolor;
+      if (heapval > toleranceheap) {
+        color = WROVER_GREEN;
+        bgcolor = WROVER_DARKGREY;
+      } else if (heapval > min_free_heap) {
+        color = WROVER_YELLOW;
+        bgcolor = WROVER_DARKGREEN;
       } else {
-        // last block overlaps scroll loop point and has been split
-        int h1 = (Out.scrollTopFixedArea - (Out.scrollPosY - pos));
-        int h2 = pos - h1;
-        int lwidth = Out.width - 2;
-        h1 -= 2; //margin
-        h2 -= 2;; //margin
-        int vpos1 = Out.scrollPosY - pos + Out.yArea + 1;
-        int vpos2 = Out.scrollPosY - 2;
-        tft.drawFastHLine(1+radius, vpos1, lwidth - 2*radius, color); // upper hline
-        tft.drawFastHLine(1+radius, vpos2, lwidth - 2*radius, color); // lower hline
-        if(h1>radius) {
-          tft.drawFastVLine(1,      vpos1 + radius, h1-radius+1, color); // upper left vline
-          tft.drawFastVLine(lwidth, vpos1 + radius, h1-radius+1, color); // upper right vline
+        color = WROVER_RED;
+        bgcolor = WROVER_ORANGE;
+      }
+      tft.writeFastVLine(x, GRAPH_Y, GRAPH_LINE_HEIGHT + 1, bgcolor);
+      uint32_t lineheight = map(heapval, graphLow, graphHigh, 0, GRAPH_LINE_HEIGHT);
+      tft.writeFastVLine(x, GRAPH_Y + GRAPH_LINE_HEIGHT - lineheight, lineheight + 1, color);
+      tft.writePixel(x, GRAPH_Y + GRAPH_LINE_HEIGHT - map(toleranceheap, graphLow, graphHigh, 0, GRAPH_LINE_HEIGHT), WROVER_LIGHTGREY);
+      tft.writePixel(x, GRAPH_Y + GRAPH_LINE_HEIGHT - map(min_free_heap, graphLow, graphHigh, 0, GRAPH_LINE_HEIGHT), WROVER_RED);
+    }
+
+    static byte vendorIcon(int vendorid) {
+      for (byte i = 0; i < sizeof(vendorIcons) / sizeof(vendorIcons[0]); i++) {
+        if (vendorIcons[i].vendorid == vendorid) return vendorIcons[i].icon;
+      }
+      return ICON_GENERIC;
+    }
+
+    GFXcanvas16 *cardStrip = NULL;
+
+    static void addCardRow(BLECardRow *rows, byte &count, String text, byte icon, int16_t iconX) {
+      BLECardRow &row = rows[count++];
+      row.text = text;
+      row.icons[0] = icon;
+      row.iconsX[0] = iconX;
+    }
+
+    void drawIcon(byte icon, int16_t x, int16_t y) {
+      const IconRect &rect = iconRects[icon];
+      cardStrip->drawRGBBitmap(x, y, iconAtlas + rect.offset, rect.width, rect.height);
+    }
+
+    // draws a field, clears what's left of a longer previous value, returns true if it overlaps the logo
+    bool renderField(UIField &field) {
+      uint16_t bgcolor = field.header ? HEADER_BGCOLOR : FOOTER_BGCOLOR;
+      alignTextAt(field.value.c_str(), field.x, field.y, field.color, bgcolor, field.textAlign);
+      uint16_t width = Out.w_tmp;
+      uint16_t left = field.textAlign == ALIGN_LEFT ? 0 : field.textAlign == ALIGN_RIGHT ? Out.width - width : field.textAlign == ALIGN_CENTER ? Out.width / 2 - width / 2 : field.x;
+      if (field.width > width) {
+        // shorter than the previous value
+        uint16_t oldLeft = field.textAlign == ALIGN_LEFT ? 0 : field.textAlign == ALIGN_RIGHT ? Out.width - field.width : field.textAlign == ALIGN_CENTER ? Out.width / 2 - field.width / 2 : field.x;
+        if (oldLeft < left) {
+          tft.fillRect(oldLeft, field.y, left - oldLeft, Out.h_tmp, bgcolor);
+          UIPixels += (left - oldLeft) * Out.h_tmp;
         }
-        if(h2>radius) {
-          tft.drawFastVLine(1,      vpos2 - h2, h2-radius+1, color); // lower left vline
-          tft.drawFastVLine(lwidth, vpos2 - h2, h2-radius+1, color); // lower right vline
+        if (oldLeft + field.width > left + width) {
+          tft.fillRect(left + width, field.y, oldLeft + field.width - (left + width), Out.h_tmp, bgcolor);
+          UIPixels += (oldLeft + field.width - (left + width)) * Out.h_tmp;
         }
-        tft.startWrite();//BLEDev.borderColor
-        tft.drawCircleHelper(1+radius,      vpos1+radius, radius, 1, color); // upper left
-        tft.drawCircleHelper(lwidth-radius, vpos1+radius, radius, 2, color); // upper right
-        tft.drawCircleHelper(lwidth-radius, vpos2-radius, radius, 4, color); // lower right
-        tft.drawCircleHelper(1+radius,      vpos2-radius, radius, 8, color); // lower left
-        tft.endWrite();
+        left = min(left, oldLeft);
+        width = max(width, field.width);
       }
+      field.width = Out.w_tmp;
+      return field.y < LOGO_Y + LOGO_SIZE && field.y + 8 > LOGO_Y && left < LOGO_X + LOGO_SIZE && left + width > LOGO_X;
     }
 
     // draws a RSSI Bar for the BLECard
@@ -571,10 +738,10 @@ class UIUtils {
         barColors[2] = bgcolor;
         barColors[3] = bgcolor;
       }
-      tft.fillRect(x,     y + 4, 2, 4, barColors[0]);
-      tft.fillRect(x + 3, y + 3, 2, 5, barColors[1]);
-      tft.fillRect(x + 6, y + 2, 2, 6, barColors[2]);
-      tft.fillRect(x + 9, y + 1, 2, 7, barColors[3]);
+      cardStrip->fillRect(x,     y + 4, 2, 4, barColors[0]);
+      cardStrip->fillRect(x + 3, y + 3, 2, 5, barColors[1]);
+      cardStrip->fillRect(x + 6, y + 2, 2, 6, barColors[2]);
+      cardStrip->fillRect(x + 9, y + 1, 2, 7, barColors[3]);
     }  
 
 };
@@ -0,0 +1,134 @@
+/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  SD Card write-ahead log of the devices that couldn't be inserted.
+
+  When the DB is out of memory (or an insertion fails), the devices are
+  appended to WAL_FILE without going through SQLite: one WAL_RECORD_SIZE block
+  per device, holding a DeviceRecord (see Freezer.h, crc included) padded with
+  zeros. Every append is closed before returning, so a crash can only tear the
+  last record, which the crc rejects.
+
+  On the next boot, BLECollector.replayWAL() inserts the records into blemacs
+  with DB.upsertBTDevice(): a device inserted before the crash isn't inserted
+  twice, so the log can be replayed again if the boot is interrupted. The file
+  is removed once every record is in the DB.
+
+  The NVS journal (Freezer.h) is only used when the SD Card can't be written.
+
+*/
+
+#ifndef BUILD_NTPMENU_BIN
+
+#define WAL_FILE BLE_COLLECTOR_DB_FILE ".wal"
+#define WAL_RECORD_SIZE FREEZER_RECORD_MAX // fixed size, a multiple of the SD Card sector
+
+
+class WalUtils {
+  public:
+
+    uint32_t appended = 0;
+    uint32_t appendErrors = 0;
+    uint32_t replayed = 0; // inserted or already in the DB
+    uint32_t skipped = 0; // torn or corrupted records
+
+    // writes a device to the log, returns false if the SD Card can't take it
+    bool append(BlueToothDevice &BLEDev) {
+      uint8_t buf[WAL_RECORD_SIZE];
+      memset(buf, 0, WAL_RECORD_SIZE);
+      DeviceRecord::serialize(BLEDev, appended, buf);
+      File walFile = SD_MMC.open(WAL_FILE, FILE_APPEND);
+      if(!walFile) {
+        appendErrors++;
+        return false;
+      }
+      size_t size = walFile.size();
+      if(size % WAL_RECORD_SIZE != 0) {
+        // torn record, realign on the next one
+        uint8_t padding[WAL_RECORD_SIZE];
+        memset(padding, 0, WAL_RECORD_SIZE);
+        walFile.write(padding, WAL_RECORD_SIZE - (size % WAL_RECORD_SIZE));
+      }
+      size_t written = walFile.write(buf, WAL_RECORD_SIZE);
+      walFile.close();
+      if(written != WAL_RECORD_SIZE) {
+        appendErrors++;
+        return false;
+      }
+      appended++;
+      return true;
+    }
+
+    bool begin() {
+      walFile = SD_MMC.open(WAL_FILE);
+      if(!walFile) return false;
+      Serial.printf("[WAL] Replaying %d records from %s\n", walFile.size() / WAL_RECORD_SIZE, WAL_FILE);
+      return true;
+    }
+
+    // reads the next valid record into BLEDev, returns false at the end of the log
+    bool next(BlueToothDevice &BLEDev) {
+      uint8_t buf[WAL_RECORD_SIZE];
+      while(walFile.read(buf, WAL_RECORD_SIZE) == WAL_RECORD_SIZE) {
+        if(DeviceRecord::deserialize(buf, WAL_RECORD_SIZE, BLEDev)) return true;
+        skipped++; // padding, torn or corrupted
+      }
+      return false;
+    }
+
+    // closes the log, removes it if every record made it to the DB
+    void end(bool complete) {
+      walFile.close();
+      if(complete) clear();
+    }
+
+    void clear() {
+      SD_MMC.remove(WAL_FILE);
+    }
+
+    void printStats() {
+      Serial.printf("WAL -- appended:%d errors:%d replayed:%d skipped:%d\n", appended, appendErrors, replayed, skipped);
+    }
+
+  private:
+
+    File walFile; // replay
+
+};
+
+#else
+
+class WalUtils {
+  public:
+    void printStats() { };
+};
+
+#endif
+
+WalUtils Wal;
@@ -0,0 +1,57 @@
+/*
+  Writes a capture in the Capture.h format, for the host tests that replay
+  made-up scans (see ReplayHost.h).
+*/
+#pragma once
+
+#include "ReplayHost.h"
+
+#define ADDR_TYPE_PUBLIC 0
+#define ADDR_TYPE_RANDOM 1
+
+// writes records in blocks of CAPTURE_BLOCK_SIZE, see Capture.h
+class CaptureWriter {
+  public:
+    uint32_t records = 0;
+
+    bool open(const char *path) {
+      f = fopen(path, "wb");
+      if(f == NULL) return false;
+      memset(block, 0, sizeof(block));
+      memcpy(block, CAPTURE_MAGIC, strlen(CAPTURE_MAGIC));
+      block[strlen(CAPTURE_MAGIC)] = CAPTURE_VERSION;
+      fwrite(block, 1, CAPTURE_BLOCK_SIZE, f);
+      memset(block, 0, sizeof(block));
+      return true;
+    }
+
+    void add(uint32_t now, uint64_t mac, uint8_t addrType, int8_t rssi, const uint8_t *payload, uint8_t length) {
+      if(used + 1 + CAPTURE_HEADER_SIZE + length > CAPTURE_BLOCK_SIZE) writeBlock();
+      uint8_t *record = block + used;
+      record[0] = CAPTURE_HEADER_SIZE + length;
+      for(byte i=0;i<4;i++) record[1+i] = (now >> (8*i)) & 0xff;
+      for(byte i=0;i<6;i++) record[5+i] = (mac >> (8*(5-i))) & 0xff;
+      record[11] = addrType;
+      record[12] = (uint8_t)rssi;
+      record[13] = length;
+      memcpy(record + 14, payload, length);
+      used += 1 + CAPTURE_HEADER_SIZE + length;
+      records++;
+    }
+
+    void close() {
+      if(used > 0) writeBlock();
+      fclose(f);
+    }
+
+  private:
+    FILE *f = NULL;
+    uint8_t block[CAPTURE_BLOCK_SIZE];
+    uint16_t used = 0;
+
+    void writeBlock() {
+      fwrite(block, 1, CAPTURE_BLOCK_SIZE, f);
+      memset(block, 0, sizeof(block));
+      used = 0;
+    }
+};
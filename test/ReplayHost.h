@@ -0,0 +1,73 @@
+/*
+  Host replay of a capture (see Capture.h, Replay.h) through the sketch
+  itself: Settings.h is built with ADV_REPLAY against the stand-ins of host/,
+  BLECollector.init() takes the warm boot path and every BLECollector.scan()
+  replays one scan window, exactly what the ESP32 runs in replay mode.
+
+  The BLE cache, the filter rules, the name caches and the DB are the real
+  ones. The SD Card databases are in memory (see host/sqlite3.h): the
+  collector DB starts empty, the oui/vendor names come from the few rows
+  dumped in fixtures/.
+
+  The SD Card is a local folder: <root>/ble-capture.bin, and the optional
+  <root>/ble-filter.txt rules. Time is virtual (see host/Arduino.h): the
+  latency figures are the same on every run.
+
+  The display is the framebuffer simulator of host/WROVER_KIT_LCD.h. There's
+  no render task on the host: after each scan, run() calls UI.renderFrame()
+  until it's idle, DISPLAY_FRAME apart, as the task would once the scan
+  leaves it the bus.
+*/
+#pragma once
+
+#include "HostTest.h"
+
+#define ADV_REPLAY
+#include "../Settings.h"
+
+#ifndef HOST_FIXTURES
+#define HOST_FIXTURES "fixtures"
+#endif
+
+
+class ReplayHost {
+  public:
+
+    uint32_t renderPasses = 0; // UI.renderFrame() calls that drew something
+
+    bool init(const char *sdRoot, const char *fixtures = HOST_FIXTURES) {
+      SD_MMC.root = sdRoot;
+      if( !SD_MMC.exists(REPLAY_FILE) ) {
+        printf("[HOST] No %s in %s\n", REPLAY_FILE, sdRoot);
+        return false; // BLECollector.init() would wait forever
+      }
+      if( !hostSqliteSeed("/sdcard/mac-oui-light.db", (String(fixtures) + "/mac-oui-light.sql").c_str())
+       || !hostSqliteSeed("/sdcard/ble-oui.db", (String(fixtures) + "/ble-oui.sql").c_str()) ) {
+        return false;
+      }
+      BLECollector.init();
+      return true;
+    }
+
+    // every scan of the capture, as loop() would
+    void run() {
+      while( BLECollector.scan() ) {
+        renderIdle();
+      }
+      renderIdle();
+    }
+
+    // render task passes until nothing is left to draw
+    void renderIdle() {
+      for(int i=0;i<1000 && UI.renderFrame();i++) {
+        renderPasses++;
+        delay( DISPLAY_FRAME );
+      }
+    }
+
+    // rows in the collector DB
+    unsigned int rows() {
+      return DB.getEntries();
+    }
+
+};
@@ -0,0 +1,20 @@
+/*
+  Host run of BLEDevCacheBenchmark() (BLECache.h): linear String scan of the
+  old cache lookup against the mac index, at several load factors.
+
+    make -C test benchmark && test/benchmark
+
+  The probe and compare counts are the same as on the ESP32 (esp_random() is
+  seeded the same on every run), the timings are the host's.
+*/
+
+#define BLEDEVCACHE_BENCHMARK
+
+#include "HostTest.h"
+#include "../BLECache.h"
+
+
+int main() {
+  BLEDevCacheBenchmark();
+  return 0;
+}
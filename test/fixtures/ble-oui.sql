@@ -0,0 +1,14 @@
+-- a few rows of SD/ble-oui.db, same schema
+CREATE TABLE IF NOT EXISTS "ble-oui" (
+"id" INTEGER,
+  "mac" TEXT,
+  "vendor" TEXT
+);
+INSERT INTO "ble-oui" VALUES(0,'0x0000','Ericsson Technology Licensing');
+INSERT INTO "ble-oui" VALUES(6,'0x0006','Microsoft');
+INSERT INTO "ble-oui" VALUES(29,'0x001D','Qualcomm');
+INSERT INTO "ble-oui" VALUES(76,'0x004C','Apple, Inc.');
+INSERT INTO "ble-oui" VALUES(89,'0x0059','Nordic Semiconductor ASA');
+INSERT INTO "ble-oui" VALUES(117,'0x0075','Samsung Electronics Co. Ltd.');
+INSERT INTO "ble-oui" VALUES(224,'0x00E0','Google');
+INSERT INTO "ble-oui" VALUES(1660,'0x067C','Tile, Inc.');
@@ -0,0 +1,12 @@
+-- a few rows of SD/mac-oui-light.db, same schema
+CREATE TABLE IF NOT EXISTS "oui-light" (
+"Assignment" TEXT,
+  "Organization Name" TEXT
+);
+INSERT INTO "oui-light" VALUES('001122','CIMSYS Inc');
+INSERT INTO "oui-light" VALUES('0011AA','Uniclass Technology, Co., LTD');
+INSERT INTO "oui-light" VALUES('3C5AB4','Google, Inc.');
+INSERT INTO "oui-light" VALUES('ACBC32','Apple, Inc.');
+INSERT INTO "oui-light" VALUES('B499BA','Hewlett Packard');
+INSERT INTO "oui-light" VALUES('D0034B','Apple, Inc.');
+INSERT INTO "oui-light" VALUES('F0D5BF','Intel Corporate');
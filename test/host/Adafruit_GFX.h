@@ -0,0 +1,305 @@
+/*
+  Host version of the Adafruit GFX core, same drawing algorithms and call
+  structure: the shapes are built with the write*() primitives inside
+  startWrite()/endWrite(), text is drawn with the classic 6x8 font (5x7
+  glyphs, printable ASCII only, other codes get a box). A display only needs
+  drawPixel(), and overrides the primitives it does faster.
+
+  GFXcanvas16 is the real RGB565 off-screen buffer, rotation 0 only.
+*/
+#pragma once
+
+#include "Arduino.h"
+
+static const uint8_t HostFont5x7[95][5] = {
+  {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14}, // space ! " #
+  {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00}, // $ % & '
+  {0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08}, // ( ) * +
+  {0x00,0x80,0x70,0x30,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x00,0x60,0x60,0x00}, {0x20,0x10,0x08,0x04,0x02}, // , - . /
+  {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33}, // 0 1 2 3
+  {0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07}, // 4 5 6 7
+  {0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, {0x00,0x00,0x14,0x00,0x00}, {0x00,0x40,0x34,0x00,0x00}, // 8 9 : ;
+  {0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06}, // < = > ?
+  {0x3E,0x41,0x5D,0x59,0x4E}, {0x7C,0x12,0x11,0x12,0x7C}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22}, // @ A B C
+  {0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x41,0x51,0x73}, // D E F G
+  {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41}, // H I J K
+  {0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x1C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E}, // L M N O
+  {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x26,0x49,0x49,0x49,0x32}, // P Q R S
+  {0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F}, // T U V W
+  {0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03}, {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41}, // X Y Z [
+  {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40}, // \ ] ^ _
+  {0x00,0x03,0x07,0x08,0x00}, {0x20,0x54,0x54,0x78,0x40}, {0x7F,0x28,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x28}, // ` a b c
+  {0x38,0x44,0x44,0x28,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x00,0x08,0x7E,0x09,0x02}, {0x18,0xA4,0xA4,0x9C,0x78}, // d e f g
+  {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x40,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00}, // h i j k
+  {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x78,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, // l m n o
+  {0xFC,0x18,0x24,0x24,0x18}, {0x18,0x24,0x24,0x18,0xFC}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x24}, // p q r s
+  {0x04,0x04,0x3F,0x44,0x24}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C}, // t u v w
+  {0x44,0x28,0x10,0x28,0x44}, {0x4C,0x90,0x90,0x90,0x7C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00}, // x y z {
+  {0x00,0x00,0x77,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x02,0x01,0x02,0x04,0x02}                               // | } ~
+};
+static const uint8_t HostFontBox[5] = { 0x7F, 0x41, 0x41, 0x41, 0x7F };
+
+
+class Adafruit_GFX : public Print {
+  public:
+    Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+    // transaction and primitives, the defaults go through drawPixel()
+    virtual void startWrite() {}
+    virtual void endWrite() {}
+    virtual void writePixel(int16_t x, int16_t y, uint16_t color) { drawPixel(x, y, color); }
+    virtual void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { fillRect(x, y, w, h, color); }
+    virtual void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { drawFastVLine(x, y, h, color); }
+    virtual void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { drawFastHLine(x, y, w, color); }
+    virtual void writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+      bool steep = abs(y1 - y0) > abs(x1 - x0);
+      if(steep) { std::swap(x0, y0); std::swap(x1, y1); }
+      if(x0 > x1) { std::swap(x0, x1); std::swap(y0, y1); }
+      int16_t dx = x1 - x0, dy = abs(y1 - y0);
+      int16_t err = dx / 2;
+      int16_t ystep = y0 < y1 ? 1 : -1;
+      for(; x0 <= x1; x0++) {
+        if(steep) writePixel(y0, x0, color); else writePixel(x0, y0, color);
+        err -= dy;
+        if(err < 0) { y0 += ystep; err += dx; }
+      }
+    }
+
+    virtual void setRotation(uint8_t r) {
+      rotation = r & 3;
+      _width = rotation & 1 ? HEIGHT : WIDTH;
+      _height = rotation & 1 ? WIDTH : HEIGHT;
+    }
+    virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+      startWrite();
+      writeLine(x, y, x, y + h - 1, color);
+      endWrite();
+    }
+    virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+      startWrite();
+      writeLine(x, y, x + w - 1, y, color);
+      endWrite();
+    }
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+      startWrite();
+      for(int16_t i=x;i<x+w;i++) writeFastVLine(i, y, h, color);
+      endWrite();
+    }
+    virtual void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+    virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+      if(x0 == x1) {
+        if(y0 > y1) std::swap(y0, y1);
+        drawFastVLine(x0, y0, y1 - y0 + 1, color);
+      } else if(y0 == y1) {
+        if(x0 > x1) std::swap(x0, x1);
+        drawFastHLine(x0, y0, x1 - x0 + 1, color);
+      } else {
+        startWrite();
+        writeLine(x0, y0, x1, y1, color);
+        endWrite();
+      }
+    }
+
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+      startWrite();
+      writeFastHLine(x, y, w, color);
+      writeFastHLine(x, y + h - 1, w, color);
+      writeFastVLine(x, y, h, color);
+      writeFastVLine(x + w - 1, y, h, color);
+      endWrite();
+    }
+
+    void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+      int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+      startWrite();
+      writePixel(x0, y0 + r, color);
+      writePixel(x0, y0 - r, color);
+      writePixel(x0 + r, y0, color);
+      writePixel(x0 - r, y0, color);
+      while(x < y) {
+        if(f >= 0) { y--; ddF_y += 2; f += ddF_y; }
+        x++; ddF_x += 2; f += ddF_x;
+        writePixel(x0 + x, y0 + y, color);
+        writePixel(x0 - x, y0 + y, color);
+        writePixel(x0 + x, y0 - y, color);
+        writePixel(x0 - x, y0 - y, color);
+        writePixel(x0 + y, y0 + x, color);
+        writePixel(x0 - y, y0 + x, color);
+        writePixel(x0 + y, y0 - x, color);
+        writePixel(x0 - y, y0 - x, color);
+      }
+      endWrite();
+    }
+    void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername, uint16_t color) {
+      int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+      while(x < y) {
+        if(f >= 0) { y--; ddF_y += 2; f += ddF_y; }
+        x++; ddF_x += 2; f += ddF_x;
+        if(cornername & 0x4) { writePixel(x0 + x, y0 + y, color); writePixel(x0 + y, y0 + x, color); }
+        if(cornername & 0x2) { writePixel(x0 + x, y0 - y, color); writePixel(x0 + y, y0 - x, color); }
+        if(cornername & 0x8) { writePixel(x0 - y, y0 + x, color); writePixel(x0 - x, y0 + y, color); }
+        if(cornername & 0x1) { writePixel(x0 - y, y0 - x, color); writePixel(x0 - x, y0 - y, color); }
+      }
+    }
+    void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+      startWrite();
+      writeFastVLine(x0, y0 - r, 2 * r + 1, color);
+      fillCircleHelper(x0, y0, r, 3, 0, color);
+      endWrite();
+    }
+    void fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color) {
+      int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r, px = x, py = y;
+      delta++; // avoid some +1's in the loop
+      while(x < y) {
+        if(f >= 0) { y--; ddF_y += 2; f += ddF_y; }
+        x++; ddF_x += 2; f += ddF_x;
+        if(x < (y + 1)) {
+          if(corners & 1) writeFastVLine(x0 + x, y0 - y, 2 * y + delta, color);
+          if(corners & 2) writeFastVLine(x0 - x, y0 - y, 2 * y + delta, color);
+        }
+        if(y != py) {
+          if(corners & 1) writeFastVLine(x0 + py, y0 - px, 2 * px + delta, color);
+          if(corners & 2) writeFastVLine(x0 - py, y0 - px, 2 * px + delta, color);
+          py = y;
+        }
+        px = x;
+      }
+    }
+    void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) {
+      int16_t max_radius = (w < h ? w : h) / 2;
+      if(r > max_radius) r = max_radius;
+      startWrite();
+      writeFastHLine(x + r, y, w - 2 * r, color);
+      writeFastHLine(x + r, y + h - 1, w - 2 * r, color);
+      writeFastVLine(x, y + r, h - 2 * r, color);
+      writeFastVLine(x + w - 1, y + r, h - 2 * r, color);
+      drawCircleHelper(x + r, y + r, r, 1, color);
+      drawCircleHelper(x + w - r - 1, y + r, r, 2, color);
+      drawCircleHelper(x + w - r - 1, y + h - r - 1, r, 4, color);
+      drawCircleHelper(x + r, y + h - r - 1, r, 8, color);
+      endWrite();
+    }
+    void drawRGBBitmap(int16_t x, int16_t y, const uint16_t *bitmap, int16_t w, int16_t h) {
+      startWrite();
+      for(int16_t j=0;j<h;j++, y++) {
+        for(int16_t i=0;i<w;i++) writePixel(x + i, y, pgm_read_word(&bitmap[j * w + i]));
+      }
+      endWrite();
+    }
+
+    // text, classic font only
+    void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+    int16_t getCursorX() const { return cursor_x; }
+    int16_t getCursorY() const { return cursor_y; }
+    void setTextColor(uint16_t c) { textcolor = textbgcolor = c; } // transparent background
+    void setTextColor(uint16_t c, uint16_t bg) { textcolor = c; textbgcolor = bg; }
+    void setTextSize(uint8_t s) { textsize = s > 0 ? s : 1; }
+    void setTextWrap(bool w) { wrap = w; }
+    int16_t width() const { return _width; }
+    int16_t height() const { return _height; }
+    uint8_t getRotation() const { return rotation; }
+
+    using Print::write;
+    virtual size_t write(uint8_t c) {
+      if(c == '\n') {
+        cursor_x = 0;
+        cursor_y += textsize * 8;
+      } else if(c != '\r') {
+        if(wrap && (cursor_x + textsize * 6) > _width) {
+          cursor_x = 0;
+          cursor_y += textsize * 8;
+        }
+        drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+        cursor_x += textsize * 6;
+      }
+      return 1;
+    }
+    void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size) {
+      if(x >= _width || y >= _height || (x + 6 * size - 1) < 0 || (y + 8 * size - 1) < 0) return;
+      const uint8_t *glyph = c >= 0x20 && c < 0x7F ? HostFont5x7[c - 0x20] : HostFontBox;
+      startWrite();
+      for(int8_t i=0;i<5;i++) {
+        uint8_t line = glyph[i];
+        for(int8_t j=0;j<8;j++, line >>= 1) {
+          if(line & 1) {
+            if(size == 1) writePixel(x + i, y + j, color);
+            else writeFillRect(x + i * size, y + j * size, size, size, color);
+          } else if(bg != color) {
+            if(size == 1) writePixel(x + i, y + j, bg);
+            else writeFillRect(x + i * size, y + j * size, size, size, bg);
+          }
+        }
+      }
+      if(bg != color) {
+        if(size == 1) writeFastVLine(x + 5, y, 8, bg);
+        else writeFillRect(x + 5 * size, y, size, 8 * size, bg);
+      }
+      endWrite();
+    }
+    void getTextBounds(const char *str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) {
+      int16_t minx = _width, miny = _height, maxx = -1, maxy = -1;
+      *x1 = x;
+      *y1 = y;
+      *w = *h = 0;
+      for(; *str; str++) {
+        char c = *str;
+        if(c == '\n') {
+          x = 0;
+          y += textsize * 8;
+        } else if(c != '\r') {
+          if(wrap && (x + textsize * 6) > _width) {
+            x = 0;
+            y += textsize * 8;
+          }
+          int16_t x2 = x + textsize * 6 - 1, y2 = y + textsize * 8 - 1;
+          if(x2 > maxx) maxx = x2;
+          if(y2 > maxy) maxy = y2;
+          if(x < minx) minx = x;
+          if(y < miny) miny = y;
+          x += textsize * 6;
+        }
+      }
+      if(maxx >= minx) { *x1 = minx; *w = maxx - minx + 1; }
+      if(maxy >= miny) { *y1 = miny; *h = maxy - miny + 1; }
+    }
+    void getTextBounds(const String &str, int16_t x, int16_t y, int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) {
+      getTextBounds(str.c_str(), x, y, x1, y1, w, h);
+    }
+
+  protected:
+    const int16_t WIDTH, HEIGHT; // as built, rotation 0
+    int16_t _width, _height; // rotated
+    int16_t cursor_x = 0, cursor_y = 0;
+    uint16_t textcolor = 0xFFFF, textbgcolor = 0xFFFF;
+    uint8_t textsize = 1;
+    uint8_t rotation = 0;
+    bool wrap = true;
+};
+
+
+class GFXcanvas16 : public Adafruit_GFX {
+  public:
+    GFXcanvas16(uint16_t w, uint16_t h) : Adafruit_GFX(w, h) {
+      buffer = (uint16_t*)calloc((size_t)w * h, sizeof(uint16_t));
+    }
+    ~GFXcanvas16() { free(buffer); }
+    uint16_t *getBuffer() const { return buffer; }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) {
+      if(buffer && x >= 0 && y >= 0 && x < _width && y < _height) buffer[x + y * WIDTH] = color;
+    }
+    void fillScreen(uint16_t color) {
+      if(buffer) std::fill(buffer, buffer + (size_t)WIDTH * HEIGHT, color);
+    }
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+      for(int16_t j=0;j<h;j++) drawPixel(x, y + j, color);
+    }
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+      for(int16_t i=0;i<w;i++) drawPixel(x + i, y, color);
+    }
+
+  private:
+    uint16_t *buffer;
+};
@@ -0,0 +1,290 @@
+/*
+  Host (Linux) stand-in for the parts of the Arduino core used by the sketch:
+  String, Print/Stream, Serial, timing, heap, psram and FreeRTOS calls.
+  Only what the sketch needs, not a port of the core.
+
+  Time is virtual unless HOST_WALL_CLOCK is defined: micros() only moves with
+  delay() and hostClockAdvance() (the display simulator charges its bus time
+  there), so two runs of the same test print the same figures.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define HEX 16
+#define DEC 10
+#define F(x) x
+#define PROGMEM
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define pgm_read_byte(x) (*(const uint8_t*)(x))
+#define pgm_read_word(x) (*(const uint16_t*)(x))
+
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define OUTPUT 0x02
+#define LOW 0
+#define HIGH 1
+
+
+class String {
+  public:
+    String() {}
+    String(const char *c) : s(c ? c : "") {}
+    String(const std::string &c) : s(c) {}
+    String(char c) : s(1, c) {}
+    String(int v, int base = DEC) { format(base == HEX ? "%x" : "%d", v); }
+    String(unsigned int v, int base = DEC) { format(base == HEX ? "%x" : "%u", v); }
+    String(long v, int base = DEC) { format(base == HEX ? "%lx" : "%ld", v); }
+    String(unsigned long v, int base = DEC) { format(base == HEX ? "%lx" : "%lu", v); }
+    String(float v, unsigned decimals = 2) { format("%.*f", decimals, (double)v); }
+    String(double v, unsigned decimals = 2) { format("%.*f", decimals, v); }
+
+    const char *c_str() const { return s.c_str(); }
+    unsigned length() const { return s.size(); }
+    char operator[](unsigned i) const { return i < s.size() ? s[i] : 0; }
+    char charAt(unsigned i) const { return (*this)[i]; }
+    bool reserve(unsigned n) { s.reserve(n); return true; }
+    void getBytes(unsigned char *buf, unsigned size, unsigned index = 0) const {
+      if(size == 0) return;
+      unsigned n = index < s.size() ? min((unsigned)s.size() - index, size - 1) : 0;
+      memcpy(buf, s.c_str() + index, n);
+      buf[n] = 0;
+    }
+
+    String substring(unsigned from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+    String substring(unsigned from, unsigned to) const { return from < s.size() && to > from ? String(s.substr(from, to - from)) : String(); }
+    int indexOf(char c, unsigned from = 0) const { size_t p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+    int indexOf(const String &str, unsigned from = 0) const { size_t p = s.find(str.s, from); return p == std::string::npos ? -1 : (int)p; }
+    bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+    bool equalsIgnoreCase(const String &o) const { return s.size() == o.s.size() && strcasecmp(s.c_str(), o.s.c_str()) == 0; }
+    bool endsWith(const String &suffix) const { return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0; }
+    long toInt() const { return atol(s.c_str()); }
+
+    void replace(const String &from, const String &to) {
+      if(from.s.empty()) return;
+      size_t p = 0;
+      while((p = s.find(from.s, p)) != std::string::npos) {
+        s.replace(p, from.s.size(), to.s);
+        p += to.s.size();
+      }
+    }
+    void remove(unsigned index, unsigned count = (unsigned)-1) { if(index < s.size()) s.erase(index, count); }
+    void trim() {
+      size_t first = s.find_first_not_of(" \t\r\n");
+      size_t last = s.find_last_not_of(" \t\r\n");
+      s = first == std::string::npos ? "" : s.substr(first, last - first + 1);
+    }
+    void toUpperCase() { for(auto &c : s) c = toupper(c); }
+    void toLowerCase() { for(auto &c : s) c = tolower(c); }
+
+    bool operator==(const String &o) const { return s == o.s; }
+    bool operator!=(const String &o) const { return s != o.s; }
+    bool operator==(const char *o) const { return s == o; }
+    bool operator!=(const char *o) const { return s != o; }
+    String &operator+=(const String &o) { s += o.s; return *this; }
+    String &operator+=(const char *o) { s += o; return *this; }
+    String &operator+=(char o) { s += o; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+    friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+    friend String operator+(const char *a, const String &b) { return String(std::string(a) + b.s); }
+
+  private:
+    std::string s;
+    void format(const char *fmt, ...) {
+      char out[64];
+      va_list args;
+      va_start(args, fmt);
+      vsnprintf(out, sizeof(out), fmt, args);
+      va_end(args);
+      s = out;
+    }
+};
+
+
+// base of Serial, the files and the display, everything ends up in write(uint8_t)
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size) {
+      size_t n = 0;
+      while(size--) n += write(*buf++);
+      return n;
+    }
+    size_t write(const char *str) { return write((const uint8_t*)str, strlen(str)); }
+    size_t print(const String &str) { return write((const uint8_t*)str.c_str(), str.length()); }
+    size_t print(const char *str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned int v, int base = DEC) { return print(String(v, base)); }
+    size_t print(long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, (unsigned)decimals)); }
+    size_t println() { return write("\n"); }
+    template<typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+    template<typename T> size_t println(const T &v, int format) { size_t n = print(v, format); return n + println(); }
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+      char small[256];
+      va_list args;
+      va_start(args, fmt);
+      int n = vsnprintf(small, sizeof(small), fmt, args);
+      va_end(args);
+      if(n < (int)sizeof(small)) return write((const uint8_t*)small, n);
+      std::string big(n + 1, 0);
+      va_start(args, fmt);
+      vsnprintf(&big[0], n + 1, fmt, args);
+      va_end(args);
+      return write((const uint8_t*)big.c_str(), n);
+    }
+};
+
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    void setTimeout(unsigned long) {}
+    size_t readBytes(uint8_t *buf, size_t size) {
+      size_t n = 0;
+      int c;
+      while(n < size && (c = read()) >= 0) buf[n++] = (uint8_t)c;
+      return n;
+    }
+    size_t readBytes(char *buf, size_t size) { return readBytes((uint8_t*)buf, size); }
+    String readStringUntil(char terminator) {
+      String out;
+      int c;
+      while((c = read()) >= 0 && c != terminator) out += (char)c;
+      return out;
+    }
+};
+
+
+// stdout, and an empty console: nothing is ever typed
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {}
+    void flush() { fflush(stdout); }
+    int available() { return 0; }
+    int read() { return -1; }
+    using Print::write;
+    size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+    size_t write(const uint8_t *buf, size_t size) { return fwrite(buf, 1, size, stdout); }
+};
+
+extern HardwareSerial Serial;
+
+
+#ifdef HOST_WALL_CLOCK
+  inline unsigned long micros() {
+    static auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+  inline void hostClockAdvance(unsigned long) {}
+  inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+#else
+  static uint64_t HostClockMicros = 0;
+  inline unsigned long micros() { return (unsigned long)HostClockMicros; }
+  inline void hostClockAdvance(unsigned long us) { HostClockMicros += us; }
+  inline void delay(unsigned long ms) { hostClockAdvance(ms * 1000); }
+#endif
+inline unsigned long millis() { return micros() / 1000; }
+inline void yield() {}
+
+// same sequence on every run
+inline uint32_t esp_random() { return (uint32_t)rand(); }
+inline long random(long howbig) { return howbig > 0 ? rand() % howbig : 0; }
+inline long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return in_max == in_min ? out_min : (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; } // buttons aren't pressed
+
+
+// the heap reported to the sketch, tests lower it to reach the out of memory paths
+static uint32_t HostFreeHeap = 200000;
+
+#define MALLOC_CAP_INTERNAL (1<<11)
+#define MALLOC_CAP_SPIRAM   (1<<10)
+#define MALLOC_CAP_8BIT     (1<<2)
+#define MALLOC_CAP_DMA      (1<<3)
+inline size_t heap_caps_get_free_size(uint32_t caps) { return caps & MALLOC_CAP_SPIRAM ? 0 : HostFreeHeap; }
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return caps & MALLOC_CAP_SPIRAM ? 0 : HostFreeHeap / 2; }
+inline void *heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void *heap_caps_calloc(size_t n, size_t size, uint32_t) { return calloc(n, size); }
+
+class EspClass {
+  public:
+    uint32_t restarts = 0;
+    // a restart ends the run: nothing after it would happen on the device
+    void restart() {
+      restarts++;
+      printf("[HOST] ESP.restart()\n");
+      fflush(stdout);
+      exit(3);
+    }
+    uint32_t getFreeHeap() { return HostFreeHeap; }
+    uint32_t getPsramSize() { return 0; }
+    uint32_t getFreePsram() { return 0; }
+};
+
+extern EspClass ESP;
+
+// no psram on the host, the modules fall back to the heap
+inline bool psramFound() { return false; }
+inline void *ps_malloc(size_t size) { return malloc(size); }
+inline void *ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+inline void *ps_realloc(void *ptr, size_t size) { return realloc(ptr, size); }
+
+// FreeRTOS, tasks are never started on the host: the tests call what they run
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffff
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
+inline BaseType_t xTaskCreatePinnedToCore(void (*)(void*), const char*, uint32_t, void*, int, TaskHandle_t*, int) { return pdFALSE; }
+inline void vTaskDelete(TaskHandle_t) {}
+inline void vTaskDelay(TickType_t ticks) { delay(ticks * portTICK_PERIOD_MS); }
+inline TickType_t xTaskGetTickCount() { return millis() / portTICK_PERIOD_MS; }
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) { return pdPASS; }
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+
+// semaphores, the host runs everything on one thread: they only count
+typedef int *SemaphoreHandle_t;
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new int(0); }
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new int(0); }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return new int(0); }
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t) { (*s)++; return pdTRUE; }
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s) { (*s)--; return pdTRUE; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t) { if(*s == 0) return pdFALSE; (*s)--; return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { *s = 1; return pdTRUE; }
+
+// radio, wifi and registers
+inline void btStop() {}
+inline void configTzTime(const char*, const char*) {}
+inline bool getLocalTime(struct tm*, uint32_t = 5000) { return false; } // never synced
+#define WRITE_PERI_REG(addr, val)
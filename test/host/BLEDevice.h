@@ -0,0 +1,82 @@
+/*
+  Host stand-in for the ESP32 BLE Arduino library: there's no radio, packets
+  come from a replayed capture (see Replay.h). BLEScan keeps the parameters it
+  was given, start() ends the scan at once with no results.
+*/
+#pragma once
+
+#include "Arduino.h"
+
+typedef uint8_t esp_bd_addr_t[6];
+typedef enum {
+  BLE_ADDR_TYPE_PUBLIC = 0,
+  BLE_ADDR_TYPE_RANDOM = 1,
+  BLE_ADDR_TYPE_RPA_PUBLIC = 2,
+  BLE_ADDR_TYPE_RPA_RANDOM = 3
+} esp_ble_addr_type_t;
+
+class BLEAddress {
+  public:
+    BLEAddress(const esp_bd_addr_t address) { memcpy(native, address, sizeof(native)); }
+    esp_bd_addr_t *getNative() { return &native; }
+  private:
+    esp_bd_addr_t native;
+};
+
+class BLEAdvertisedDevice {
+  public:
+    BLEAddress getAddress() { return BLEAddress(address); }
+    esp_ble_addr_type_t getAddressType() { return addressType; }
+    int getRSSI() { return rssi; }
+    uint8_t *getPayload() { return payload; }
+    size_t getPayloadLength() { return payloadLength; }
+  private:
+    esp_bd_addr_t address = { 0 };
+    esp_ble_addr_type_t addressType = BLE_ADDR_TYPE_PUBLIC;
+    int rssi = 0;
+    uint8_t payload[62] = { 0 };
+    size_t payloadLength = 0;
+};
+
+class BLEAdvertisedDeviceCallbacks {
+  public:
+    virtual ~BLEAdvertisedDeviceCallbacks() {}
+    virtual void onResult(BLEAdvertisedDevice advertisedDevice) = 0;
+};
+
+class BLEScanResults {
+  public:
+    int getCount() { return 0; }
+};
+
+class BLEScan {
+  public:
+    bool active = false;
+    uint16_t interval = 0;
+    uint16_t window = 0;
+    uint32_t scans = 0;
+
+    void setAdvertisedDeviceCallbacks(BLEAdvertisedDeviceCallbacks *callbacks, bool = false) { this->callbacks = callbacks; }
+    void setActiveScan(bool active) { this->active = active; }
+    void setInterval(uint16_t interval) { this->interval = interval; }
+    void setWindow(uint16_t window) { this->window = window; }
+    bool start(uint32_t, void (*onDone)(BLEScanResults), bool = false) {
+      scans++;
+      onDone(BLEScanResults());
+      return true;
+    }
+    BLEScanResults start(uint32_t, bool = false) {
+      scans++;
+      return BLEScanResults();
+    }
+    void stop() {}
+    void clearResults() {}
+  private:
+    BLEAdvertisedDeviceCallbacks *callbacks = NULL;
+};
+
+class BLEDevice {
+  public:
+    static void init(std::string) {}
+    static BLEScan *getScan() { static BLEScan scan; return &scan; }
+};
@@ -0,0 +1,2 @@
+#pragma once
+#include "BLEDevice.h" // the host library is all in there
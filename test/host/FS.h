@@ -0,0 +1,85 @@
+/*
+  Host stand-in for the Arduino FS and its File, backed by stdio. Absolute
+  paths are resolved from a local folder (FS.root), e.g. a copy of the SD Card.
+*/
+#pragma once
+
+#include "Arduino.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+// copies share the FILE*, like the handles of the Arduino FS
+class File : public Stream {
+  public:
+    File(FILE *_f = NULL, bool _directory = false, const String &_path = "") : f(_f), directory(_directory), path(_path) {}
+    operator bool() const { return f != NULL || directory; }
+    bool isDirectory() { return directory; }
+    const char *name() const { return path.c_str(); }
+    using Print::write;
+    size_t write(uint8_t c) { return f && fputc(c, f) != EOF ? 1 : 0; }
+    size_t write(const uint8_t *buf, size_t size) { return f ? fwrite(buf, 1, size, f) : 0; }
+    size_t read(uint8_t *buf, size_t size) { return f ? fread(buf, 1, size, f) : 0; }
+    int read() { return f ? fgetc(f) : -1; }
+    int peek() {
+      if(!f) return -1;
+      int c = fgetc(f);
+      if(c != EOF) ungetc(c, f);
+      return c;
+    }
+    int available() {
+      if(!f) return 0;
+      long here = ftell(f);
+      long left = (long)size() - here;
+      return left > 0 ? (int)left : 0;
+    }
+    void flush() { if(f) fflush(f); }
+    bool seek(uint32_t pos, SeekMode mode = SeekSet) { return f && fseek(f, pos, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0; }
+    size_t position() { return f ? ftell(f) : 0; }
+    size_t size() {
+      if(!f) return 0;
+      fflush(f);
+      struct stat st;
+      return fstat(fileno(f), &st) == 0 ? st.st_size : 0;
+    }
+    void close() {
+      if(f) fclose(f);
+      f = NULL;
+      directory = false;
+    }
+  private:
+    FILE *f;
+    bool directory;
+    String path;
+};
+
+class FS {
+  public:
+    String root = ".";
+    File open(const char *path, const char *mode = FILE_READ) {
+      String local = root + path;
+      struct stat st;
+      if(stat(local.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) return File(NULL, true, path);
+      return File(fopen(local.c_str(), mode[0] == 'r' ? "rb" : mode[0] == 'a' ? "a+b" : "w+b"), false, path);
+    }
+    File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char *path) {
+      struct stat st;
+      return stat((root + path).c_str(), &st) == 0;
+    }
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *path) { return ::remove((root + path).c_str()) == 0; }
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *from, const char *to) { return ::rename((root + from).c_str(), (root + to).c_str()) == 0; }
+};
+
+}
+
+using fs::File;
@@ -0,0 +1,45 @@
+/*
+  Minimal checks for the host tests: every failed check is printed with its
+  line, main() returns testSummary() so make stops on the first failing test.
+*/
+#pragma once
+
+#include "Arduino.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static int testChecks = 0;
+static int testFailures = 0;
+
+#define CHECK(cond) do { \
+    testChecks++; \
+    if(!(cond)) { \
+      testFailures++; \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while(0)
+
+#define CHECK_EQUAL(actual, expected) do { \
+    testChecks++; \
+    long long _actual = (long long)(actual); \
+    long long _expected = (long long)(expected); \
+    if(_actual != _expected) { \
+      testFailures++; \
+      printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, _actual, _expected); \
+    } \
+  } while(0)
+
+#define CHECK_STRING(actual, expected) do { \
+    testChecks++; \
+    String _actual = (actual); \
+    if(_actual != (expected)) { \
+      testFailures++; \
+      printf("%s:%d: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, _actual.c_str(), String(expected).c_str()); \
+    } \
+  } while(0)
+
+static int testSummary(const char *name) {
+  printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+  return testFailures == 0 ? 0 : 1;
+}
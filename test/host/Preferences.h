@@ -0,0 +1,118 @@
+/*
+  Host stand-in for the NVS Preferences: namespaces held in memory, and the
+  writes counted (HostNVS) to compare how hard a journal format wears the
+  flash. A put, or a remove or clear that erases something, is one
+  write whatever its size. The 32 bytes flash entries a put takes are
+  counted as the ESP-IDF NVS lays them out: one for a number, a header
+  and the data for a string, an index, a header and the data for a blob.
+*/
+#pragma once
+
+#include "Arduino.h"
+#include <map>
+#include <vector>
+
+struct HostNVSStats {
+  uint32_t writes = 0; // put*(), remove() and clear() calls that reached the flash
+  uint32_t bytes = 0; // value bytes written
+  uint32_t entries = 0; // 32 bytes flash entries written
+  uint32_t reads = 0;
+};
+
+static HostNVSStats HostNVS;
+
+class Preferences {
+  public:
+    bool begin(const char *name, bool readOnly = false) {
+      ns = &storage()[name];
+      this->readOnly = readOnly;
+      return true;
+    }
+    void end() { ns = NULL; }
+
+    bool clear() {
+      if(!writable()) return false;
+      if(!ns->empty()) HostNVS.writes++; // nothing to erase otherwise
+      ns->clear();
+      return true;
+    }
+    bool remove(const char *key) {
+      if(!writable() || ns->erase(key) == 0) return false;
+      HostNVS.writes++;
+      return true;
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t length) {
+      if(!writable()) return 0;
+      put(key, value, length);
+      HostNVS.entries += 2 + entries(length);
+      return length;
+    }
+    size_t getBytesLength(const char *key) {
+      std::vector<uint8_t> *value = find(key);
+      return value ? value->size() : 0;
+    }
+    size_t getBytes(const char *key, void *buf, size_t maxLength) {
+      std::vector<uint8_t> *value = find(key);
+      if(value == NULL || value->size() > maxLength) return 0;
+      HostNVS.reads++;
+      memcpy(buf, value->data(), value->size());
+      return value->size();
+    }
+
+    size_t putUInt(const char *key, uint32_t value) { return putNumber(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) {
+      uint32_t value;
+      return getBytesLength(key) == sizeof(value) && getBytes(key, &value, sizeof(value)) ? value : defaultValue;
+    }
+    size_t putBool(const char *key, bool value) {
+      uint8_t byte = value;
+      return putNumber(key, &byte, 1);
+    }
+    bool getBool(const char *key, bool defaultValue = false) {
+      uint8_t value;
+      return getBytesLength(key) == 1 && getBytes(key, &value, 1) ? value : defaultValue;
+    }
+    size_t putString(const char *key, String value) {
+      if(!writable()) return 0;
+      put(key, value.c_str(), value.length() + 1);
+      HostNVS.entries += 1 + entries(value.length() + 1);
+      return value.length();
+    }
+    String getString(const char *key, String defaultValue = String()) {
+      std::vector<uint8_t> *value = find(key);
+      if(value == NULL || value->empty()) return defaultValue;
+      HostNVS.reads++;
+      return String((const char*)value->data());
+    }
+
+  private:
+    std::map<std::string, std::vector<uint8_t>> *ns = NULL;
+    bool readOnly = false;
+
+    static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> &storage() {
+      static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> namespaces;
+      return namespaces;
+    }
+    bool writable() { return ns != NULL && !readOnly; }
+    void put(const char *key, const void *value, size_t length) {
+      const uint8_t *bytes = (const uint8_t*)value;
+      (*ns)[key].assign(bytes, bytes + length);
+      HostNVS.writes++;
+      HostNVS.bytes += length;
+    }
+    size_t putNumber(const char *key, const void *value, size_t length) {
+      if(!writable()) return 0;
+      put(key, value, length);
+      HostNVS.entries++;
+      return length;
+    }
+    static uint32_t entries(size_t length) {
+      return (length + 31) / 32;
+    }
+    std::vector<uint8_t> *find(const char *key) {
+      if(ns == NULL) return NULL;
+      auto it = ns->find(key);
+      return it == ns->end() ? NULL : &it->second;
+    }
+};
@@ -0,0 +1,48 @@
+/*
+  Host stand-in for the RTC module: always running, the time is a fixed date
+  plus the virtual uptime (see Arduino.h) so the clock fields don't change
+  from one run to the next.
+*/
+#pragma once
+
+#include "Arduino.h"
+
+#define HOST_RTC_EPOCH 1541289600 // 2018-11-04 00:00:00 UTC
+
+class DateTime {
+  public:
+    DateTime(uint32_t t = 0) : t(t) {}
+    DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t minute = 0, uint8_t second = 0) {
+      struct tm tm = { 0 };
+      tm.tm_year = year - 1900;
+      tm.tm_mon = month - 1;
+      tm.tm_mday = day;
+      tm.tm_hour = hour;
+      tm.tm_min = minute;
+      tm.tm_sec = second;
+      t = timegm(&tm);
+    }
+    DateTime(const char *, const char *) : t(HOST_RTC_EPOCH) {} // __DATE__, __TIME__: the build time isn't reproducible
+    uint32_t unixtime() const { return t; }
+    uint8_t hour() const { return field().tm_hour; }
+    uint8_t minute() const { return field().tm_min; }
+    uint8_t second() const { return field().tm_sec; }
+  private:
+    uint32_t t;
+    struct tm field() const {
+      time_t tt = t;
+      struct tm tm;
+      gmtime_r(&tt, &tm);
+      return tm;
+    }
+};
+
+class RTC_DS1307 {
+  public:
+    bool begin() { return true; }
+    bool isrunning() { return true; }
+    void adjust(const DateTime &dt) { offset = dt.unixtime() - millis() / 1000; }
+    DateTime now() { return DateTime(offset + millis() / 1000); }
+  private:
+    uint32_t offset = HOST_RTC_EPOCH;
+};
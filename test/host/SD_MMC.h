@@ -0,0 +1,14 @@
+/*
+  Host stand-in for the SD Card, a local folder: see FS.h.
+*/
+#pragma once
+
+#include "FS.h"
+
+class SDMMCFS : public fs::FS {
+  public:
+    bool begin(const char * = "/sdcard", bool = false) { return true; }
+    uint64_t cardSize() { return 0; }
+};
+
+SDMMCFS SD_MMC;
@@ -0,0 +1,18 @@
+/*
+  Host stand-in for the OTA updater: there's no flash to write, begin() fails.
+*/
+#pragma once
+
+#include "Arduino.h"
+
+class UpdateClass {
+  public:
+    void onProgress(void (*)(int, int)) {}
+    bool begin(size_t) { return false; }
+    size_t writeStream(Stream &) { return 0; }
+    bool end() { return false; }
+    bool isFinished() { return false; }
+    int getError() { return 0; }
+};
+
+UpdateClass Update;
@@ -0,0 +1,295 @@
+/*
+  Host framebuffer simulator of the WROVER-KIT ILI9341 driver.
+
+  The controller memory (GRAM) is 240x320 RGB565, written through the same
+  primitives the driver overrides: pixels, fast lines, rects, bitmaps and
+  jpegs (decoded with libjpeg, same clipping and offsets as the driver).
+  setupScrollArea()/scrollTo() set the fixed areas and the scroll start line
+  (VSCRDEF/VSCRSADD): the visible frame maps the rows of the scroll area
+  from that line, as the panel does, so frame() and the PNG are what the
+  screen shows, not the GRAM.
+
+  Every primitive is charged its bus time: an address window plus 2 bytes
+  per pixel at HOST_SPI_HZ (same byte count as TFTStats.h), added to the
+  virtual clock (see Arduino.h). The render figures of a host run are the
+  time the transfers would take on the board, the CPU time isn't counted.
+  The pixels written to the fixed areas are counted apart: what the header
+  and footer cost, the scroll area being the cards.
+
+  writePNG() saves the visible frame, compareGolden() checks it against a
+  golden PNG, or rewrites the golden when UPDATE_GOLDEN is set in the
+  environment.
+*/
+#pragma once
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <png.h>
+#include <jpeglib.h>
+#include <vector>
+
+#include "Adafruit_GFX.h"
+
+#define WROVER_BLACK       0x0000
+#define WROVER_NAVY        0x000F
+#define WROVER_DARKGREEN   0x03E0
+#define WROVER_DARKCYAN    0x03EF
+#define WROVER_MAROON      0x7800
+#define WROVER_PURPLE      0x780F
+#define WROVER_OLIVE       0x7BE0
+#define WROVER_LIGHTGREY   0xC618
+#define WROVER_DARKGREY    0x7BEF
+#define WROVER_BLUE        0x001F
+#define WROVER_GREEN       0x07E0
+#define WROVER_CYAN        0x07FF
+#define WROVER_RED         0xF800
+#define WROVER_MAGENTA     0xF81F
+#define WROVER_YELLOW      0xFFE0
+#define WROVER_WHITE       0xFFFF
+#define WROVER_ORANGE      0xFD20
+#define WROVER_GREENYELLOW 0xAFE5
+#define WROVER_PINK        0xF81F
+
+#define WROVER_WIDTH  240
+#define WROVER_HEIGHT 320
+
+#ifndef HOST_SPI_HZ
+#define HOST_SPI_HZ 40000000 // the driver's write clock
+#endif
+#define HOST_LCD_WINDOW_BYTES 11 // CASET(1+4) + PASET(1+4) + RAMWR(1)
+
+
+class WROVER_KIT_LCD : public Adafruit_GFX {
+  public:
+
+    uint64_t busBytes = 0; // since begin()
+    uint32_t windows = 0; // address windows, i.e. transfers
+    uint64_t pixels = 0; // pushed through the windows
+    uint64_t fixedPixels = 0; // written to the fixed areas (header, footer) once they're set up
+
+    WROVER_KIT_LCD() : Adafruit_GFX(WROVER_WIDTH, WROVER_HEIGHT) {
+      clear();
+    }
+
+    void begin() {
+      clear();
+      busBytes = 0;
+      windows = 0;
+      pixels = 0;
+      fixedPixels = 0;
+    }
+    uint16_t color565(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3); }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) {
+      if(charge(x, y, 1, 1)) put(x, y, color);
+    }
+    void writePixel(int16_t x, int16_t y, uint16_t color) {
+      drawPixel(x, y, color);
+    }
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+      if(!charge(x, y, w, h)) return;
+      for(int16_t j=y;j<y+h;j++) {
+        for(int16_t i=x;i<x+w;i++) put(i, j, color);
+      }
+    }
+    void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+      fillRect(x, y, w, h, color);
+    }
+    void fillScreen(uint16_t color) {
+      fillRect(0, 0, _width, _height, color);
+    }
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+      fillRect(x, y, w, 1, color);
+    }
+    void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+      fillRect(x, y, w, 1, color);
+    }
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+      fillRect(x, y, 1, h, color);
+    }
+    void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+      fillRect(x, y, 1, h, color);
+    }
+
+    // one window for the whole bitmap, RGB565 values
+    void drawBitmap(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pcolors) {
+      if(!charge(x, y, w, h)) return;
+      for(int16_t j=0;j<h;j++) {
+        for(int16_t i=0;i<w;i++) put(x + i, y + j, pcolors[j * w + i]);
+      }
+    }
+
+    // maxWidth/maxHeight clip the picture (0: up to the screen edge), offX/offY skip its first columns/rows
+    void drawJpg(const uint8_t *jpg_data, size_t jpg_len, uint16_t x = 0, uint16_t y = 0, uint16_t maxWidth = 0, uint16_t maxHeight = 0, uint16_t offX = 0, uint16_t offY = 0) {
+      jpeg_decompress_struct cinfo;
+      JpegError jerr;
+      cinfo.err = jpeg_std_error(&jerr.pub);
+      jerr.pub.error_exit = JpegError::exit;
+      if(setjmp(jerr.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return; // the driver draws nothing either
+      }
+      jpeg_create_decompress(&cinfo);
+      jpeg_mem_src(&cinfo, (unsigned char*)jpg_data, jpg_len);
+      jpeg_read_header(&cinfo, TRUE);
+      cinfo.out_color_space = JCS_RGB;
+      jpeg_start_decompress(&cinfo);
+      int16_t w = cinfo.output_width > offX ? cinfo.output_width - offX : 0;
+      int16_t h = cinfo.output_height > offY ? cinfo.output_height - offY : 0;
+      if(maxWidth == 0) maxWidth = _width - x;
+      if(maxHeight == 0) maxHeight = _height - y;
+      if(w > maxWidth) w = maxWidth;
+      if(h > maxHeight) h = maxHeight;
+      charge(x, y, w, h);
+      std::vector<uint8_t> row(cinfo.output_width * 3);
+      while(cinfo.output_scanline < cinfo.output_height) {
+        int16_t j = cinfo.output_scanline - offY;
+        uint8_t *rowPtr = row.data();
+        jpeg_read_scanlines(&cinfo, &rowPtr, 1);
+        if(j < 0 || j >= h) continue;
+        for(int16_t i=0;i<w;i++) {
+          const uint8_t *rgb = &row[(offX + i) * 3];
+          put(x + i, y + j, color565(rgb[0], rgb[1], rgb[2]));
+        }
+      }
+      jpeg_finish_decompress(&cinfo);
+      jpeg_destroy_decompress(&cinfo);
+    }
+
+    // VSCRDEF, the scroll area is what's left between the fixed areas
+    void setupScrollArea(uint16_t tfa, uint16_t bfa) {
+      chargeBytes(1 + 6);
+      topFixedArea = tfa;
+      bottomFixedArea = bfa;
+    }
+    // VSCRSADD, the GRAM row shown at the top of the scroll area
+    void scrollTo(uint16_t y) {
+      chargeBytes(1 + 2);
+      scrollStart = y;
+    }
+
+    // visible pixel, in panel coordinates (rotation 0)
+    uint16_t frame(int16_t x, int16_t y) {
+      if(x < 0 || y < 0 || x >= WROVER_WIDTH || y >= WROVER_HEIGHT) return 0;
+      return gram[gramRow(y)][x];
+    }
+
+    bool writePNG(const char *path) {
+      std::vector<uint8_t> rgb(WROVER_WIDTH * WROVER_HEIGHT * 3);
+      for(int16_t y=0;y<WROVER_HEIGHT;y++) {
+        for(int16_t x=0;x<WROVER_WIDTH;x++) {
+          uint16_t c = frame(x, y);
+          uint8_t *p = &rgb[(y * WROVER_WIDTH + x) * 3];
+          p[0] = ((c >> 11) & 0x1F) * 255 / 31;
+          p[1] = ((c >> 5) & 0x3F) * 255 / 63;
+          p[2] = (c & 0x1F) * 255 / 31;
+        }
+      }
+      png_image image;
+      memset(&image, 0, sizeof(image));
+      image.version = PNG_IMAGE_VERSION;
+      image.width = WROVER_WIDTH;
+      image.height = WROVER_HEIGHT;
+      image.format = PNG_FORMAT_RGB;
+      return png_image_write_to_file(&image, path, 0, rgb.data(), 0, NULL) != 0;
+    }
+
+    // pixels differing from the golden PNG, -1 if it can't be read; the frame is saved next to it as .actual.png on a mismatch
+    long compareGolden(const char *path) {
+      if(getenv("UPDATE_GOLDEN") != NULL) {
+        ::printf("[HOST] Updating %s\n", path);
+        return writePNG(path) ? 0 : -1;
+      }
+      png_image image;
+      memset(&image, 0, sizeof(image));
+      image.version = PNG_IMAGE_VERSION;
+      if(!png_image_begin_read_from_file(&image, path)) {
+        ::printf("[HOST] Can't read %s\n", path);
+        return -1;
+      }
+      image.format = PNG_FORMAT_RGB;
+      std::vector<uint8_t> golden(PNG_IMAGE_SIZE(image));
+      if(!png_image_finish_read(&image, NULL, golden.data(), 0, NULL)
+        || image.width != WROVER_WIDTH || image.height != WROVER_HEIGHT) {
+        ::printf("[HOST] Can't read %s\n", path);
+        return -1;
+      }
+      long diff = 0;
+      for(int16_t y=0;y<WROVER_HEIGHT;y++) {
+        for(int16_t x=0;x<WROVER_WIDTH;x++) {
+          const uint8_t *p = &golden[(y * WROVER_WIDTH + x) * 3];
+          if(color565(p[0], p[1], p[2]) != frame(x, y)) diff++;
+        }
+      }
+      if(diff > 0) {
+        String actual = String(path) + ".actual.png";
+        writePNG(actual.c_str());
+        ::printf("[HOST] %ld pixels differ from %s, see %s\n", diff, path, actual.c_str());
+      }
+      return diff;
+    }
+
+  private:
+
+    uint16_t gram[WROVER_HEIGHT][WROVER_WIDTH];
+    uint16_t topFixedArea = 0;
+    uint16_t bottomFixedArea = 0;
+    uint16_t scrollStart = 0;
+    uint32_t busNanos = 0; // below one microsecond, not charged yet
+
+    struct JpegError {
+      jpeg_error_mgr pub;
+      jmp_buf jump;
+      static void exit(j_common_ptr cinfo) {
+        longjmp(((JpegError*)cinfo->err)->jump, 1);
+      }
+    };
+
+    void clear() {
+      memset(gram, 0, sizeof(gram));
+      topFixedArea = bottomFixedArea = scrollStart = 0;
+    }
+
+    // rotated coordinates to GRAM, clipped
+    void put(int16_t x, int16_t y, uint16_t color) {
+      if(x < 0 || y < 0 || x >= _width || y >= _height) return;
+      switch(rotation) {
+        case 1: std::swap(x, y); x = WIDTH - 1 - x; break;
+        case 2: x = WIDTH - 1 - x; y = HEIGHT - 1 - y; break;
+        case 3: std::swap(x, y); y = HEIGHT - 1 - y; break;
+      }
+      if(y < topFixedArea || y >= WROVER_HEIGHT - bottomFixedArea) fixedPixels++;
+      gram[y][x] = color;
+    }
+
+    // GRAM row shown on the panel row y
+    uint16_t gramRow(int16_t y) {
+      uint16_t scrollEnd = WROVER_HEIGHT - bottomFixedArea;
+      if(y < topFixedArea || y >= scrollEnd || topFixedArea >= scrollEnd) return y;
+      uint16_t start = scrollStart < topFixedArea || scrollStart >= scrollEnd ? topFixedArea : scrollStart;
+      uint16_t row = start + (y - topFixedArea);
+      if(row >= scrollEnd) row -= scrollEnd - topFixedArea;
+      return row;
+    }
+
+    // the address window and the pixels, clipped to the screen; false if nothing is drawn
+    bool charge(int16_t x, int16_t y, int16_t w, int16_t h) {
+      if(x < 0) { w += x; x = 0; }
+      if(y < 0) { h += y; y = 0; }
+      if(x + w > _width) w = _width - x;
+      if(y + h > _height) h = _height - y;
+      if(w <= 0 || h <= 0) return false;
+      windows++;
+      pixels += (uint32_t)w * h;
+      chargeBytes(HOST_LCD_WINDOW_BYTES + 2 * (uint32_t)w * h);
+      return true;
+    }
+
+    void chargeBytes(uint32_t bytes) {
+      busBytes += bytes;
+      busNanos += (uint64_t)bytes * 8 * 1000000000ULL / HOST_SPI_HZ;
+      hostClockAdvance(busNanos / 1000);
+      busNanos %= 1000;
+    }
+
+};
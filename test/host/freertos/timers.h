@@ -0,0 +1,14 @@
+/*
+  Host stand-in for the FreeRTOS software timers: like the tasks, they are
+  never started on the host.
+*/
+#pragma once
+
+#include "../Arduino.h"
+
+typedef void *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+inline TimerHandle_t xTimerCreate(const char *, TickType_t, BaseType_t, void *, TimerCallbackFunction_t) { return NULL; }
+inline BaseType_t xTimerStart(TimerHandle_t, TickType_t) { return pdFALSE; }
+inline void *pvTimerGetTimerID(TimerHandle_t) { return NULL; }
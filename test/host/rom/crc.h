@@ -0,0 +1,16 @@
+/*
+  Host version of the ROM CRC32 (little endian, 0xEDB88320), same values as
+  the ESP32 so the frozen records and snapshots are checked the same way.
+*/
+#pragma once
+
+#include <stdint.h>
+
+inline uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  while(len--) {
+    crc ^= *buf++;
+    for(int i=0;i<8;i++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
@@ -0,0 +1,10 @@
+/*
+  Host stand-in for the reset reason, a software reset (12) by default: the
+  warm boot path, the one the replay takes. Tests set HostResetReason to 1
+  (power on) for a cold boot.
+*/
+#pragma once
+
+static int HostResetReason = 12; // SW_CPU_RESET
+
+inline int rtc_get_reset_reason(int) { return HostResetReason; }
@@ -0,0 +1,3 @@
+#pragma once
+// host: no registers, see WRITE_PERI_REG() in Arduino.h
+#define RTC_CNTL_BROWN_OUT_REG 0
@@ -0,0 +1,2 @@
+#pragma once
+// host: no registers, see WRITE_PERI_REG() in Arduino.h
@@ -0,0 +1,56 @@
+/*
+  Host sqlite3: the system library, with the SD Card databases in memory.
+  "/sdcard/name.db" opens the shared in-memory database "name.db", kept alive
+  between the open()/close() of every query (see DB.h) by a connection opened
+  the first time. Tests seed them with hostSqliteSeed(), other paths are
+  opened as they are.
+*/
+#pragma once
+
+#include_next <sqlite3.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <map>
+
+#define HOST_SQLITE_SDCARD "/sdcard/"
+
+inline int hostSqliteOpen(const char *filename, sqlite3 **db) {
+  if(strncmp(filename, HOST_SQLITE_SDCARD, strlen(HOST_SQLITE_SDCARD)) != 0) return sqlite3_open(filename, db);
+  static std::map<std::string, sqlite3*> keepers;
+  std::string uri = "file:" + std::string(filename + strlen(HOST_SQLITE_SDCARD)) + "?mode=memory&cache=shared";
+  int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI;
+  if(keepers.count(uri) == 0) {
+    sqlite3 *keeper = NULL;
+    int rc = sqlite3_open_v2(uri.c_str(), &keeper, flags, NULL);
+    if(rc != SQLITE_OK) {
+      sqlite3_close(keeper);
+      return rc;
+    }
+    keepers[uri] = keeper;
+  }
+  return sqlite3_open_v2(uri.c_str(), db, flags, NULL);
+}
+
+// runs a .sql file (e.g. a dump of a few rows) into an SD Card database, returns false on error
+inline bool hostSqliteSeed(const char *filename, const char *sqlPath) {
+  FILE *f = fopen(sqlPath, "rb");
+  if(f == NULL) {
+    printf("[HOST] Can't open %s\n", sqlPath);
+    return false;
+  }
+  std::string sql;
+  char buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0) sql.append(buf, n);
+  fclose(f);
+  sqlite3 *db;
+  char *error = NULL;
+  bool seeded = hostSqliteOpen(filename, &db) == SQLITE_OK && sqlite3_exec(db, sql.c_str(), NULL, NULL, &error) == SQLITE_OK;
+  if(!seeded) printf("[HOST] Can't seed %s from %s: %s\n", filename, sqlPath, error ? error : sqlite3_errmsg(db));
+  sqlite3_free(error);
+  sqlite3_close(db);
+  return seeded;
+}
+
+#define sqlite3_open hostSqliteOpen
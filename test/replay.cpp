@@ -0,0 +1,32 @@
+/*
+  Replays a capture on the host and prints what the sketch prints, e.g. to
+  compare two builds on the same capture in CI:
+
+    make -C test replay
+    test/replay <folder holding ble-capture.bin [and ble-filter.txt]>
+
+  The latencies are in virtual time (see host/Arduino.h), build with
+  CPPFLAGS=-DHOST_WALL_CLOCK to measure them on the host. To compare scan
+  settings on a capture, see the unique devices per minute of the summary
+  with CPPFLAGS="-DREPLAY_RADIO=1" and "-DREPLAY_RADIO=1 -DSCAN_ADAPTIVE=false".
+  The last line counts the pixels the display simulator received, in total
+  and in the header/footer, see host/WROVER_KIT_LCD.h.
+*/
+
+#include "ReplayHost.h"
+
+int main(int argc, char **argv) {
+  if(argc != 2) {
+    printf("usage: %s <sd card folder>\n", argv[0]);
+    return 2;
+  }
+  ReplayHost host;
+  if( !host.init( argv[1] ) ) return 1;
+  host.run();
+  printf("[HOST] render passes:%d windows:%d pixels:%llu (header/footer:%llu) cards:%d (%d windows/card, %llu px/card, header/footer %llu px/card)\n",
+    host.renderPasses, tft.windows, tft.pixels, tft.fixedPixels, CardsRendered,
+    CardsRendered ? tft.windows / CardsRendered : 0,
+    CardsRendered ? tft.pixels / CardsRendered : 0, CardsRendered ? tft.fixedPixels / CardsRendered : 0
+  );
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+  Rotating address linking (see Cluster.h) scored against a labeled capture:
+  every address of the capture belongs to a known person, every link the
+  sketch makes is checked with Cluster.onLink. Prints the precision (links
+  between two addresses of the same person) and the recall (rotations of the
+  capture that got linked).
+
+  The capture is made up, 30 minutes in an office by a corridor:
+    - people sitting all along, each phone rotating its address every 15
+      minutes, the first rotation anywhere in the first 15 minutes
+    - a few people leaving, and others coming in, without any rotation
+    - people walking by in the corridor, heard for a few seconds
+  most phones are the same unnamed model, the same fingerprint, a few are
+  watches. The RSSI of a phone moves by a few dB from one packet to the next,
+  every advertising event gets the 0-10 ms random delay of the spec.
+
+  The links are counted with or without CLUSTER_LINK, the test is built
+  without it: every address is still collected. The figures are why it's off
+  by default, see Cluster.h.
+*/
+
+#include "CaptureWriter.h"
+
+#include <map>
+
+#define CAPTURE_MINUTES 30
+#define ROTATION_MS (15 * 60000)
+
+
+struct Advertiser {
+  int person;
+  uint64_t mac;
+  const uint8_t *payload;
+  uint8_t length;
+  int8_t rssi;
+  uint32_t from, to, period; // ms
+  uint32_t next;
+};
+
+#ifndef CAPTURE_SEED
+#define CAPTURE_SEED 12345 // -DCAPTURE_SEED=n for another crowd
+#endif
+static uint32_t lcg = CAPTURE_SEED;
+static uint32_t randomMs(uint32_t n) {
+  lcg = lcg * 1103515245 + 12345;
+  return (lcg >> 16) % n;
+}
+
+// unnamed phone, Continuity Nearby Info
+static const uint8_t phoneAdv[] = { 0x02, 0x01, 0x1A, 0x0A, 0xFF, 0x4C, 0x00, 0x10, 0x05, 0x01, 0x1C, 0x1A, 0x2B, 0x3C };
+// unnamed watch, Continuity Nearby Info with another length
+static const uint8_t watchAdv[] = { 0x02, 0x01, 0x1A, 0x09, 0xFF, 0x4C, 0x00, 0x10, 0x04, 0x01, 0x18, 0x2E, 0x5F };
+
+static std::vector<Advertiser> advertisers;
+static std::map<uint64_t, int> owners;
+static uint32_t nextMac = 0x1000;
+static int people = 0;
+static int rotations = 0; // addresses that replaced another one of the same person
+static int links = 0, correctLinks = 0;
+
+
+static void onLink(uint64_t previous, uint64_t mac) {
+  links++;
+  if( owners[previous] == owners[mac] ) correctLinks++;
+}
+
+
+// one person, a new address every ROTATION_MS from the first rotation
+static void addPerson(const uint8_t *payload, uint8_t length, int8_t rssi, uint32_t from, uint32_t to, uint32_t firstRotation) {
+  Advertiser a;
+  a.person = people++;
+  a.payload = payload;
+  a.length = length;
+  a.rssi = rssi;
+  a.period = 300 + randomMs(700);
+  uint32_t rotation = from + firstRotation;
+  bool rotated = false;
+  while( from < to ) {
+    a.mac = 0x4A0000000000ULL | nextMac++; // resolvable private
+    a.from = from;
+    a.to = rotation < to ? rotation : to;
+    owners[a.mac] = a.person;
+    if( rotated ) rotations++;
+    rotated = true;
+    advertisers.push_back(a);
+    from = a.to;
+    rotation += ROTATION_MS;
+  }
+}
+
+
+static uint32_t writeCapture(const String &folder) {
+  const uint32_t end = CAPTURE_MINUTES * 60000;
+  for(int i=0;i<10;i++) {
+    addPerson( phoneAdv, sizeof(phoneAdv), -55 - randomMs(35), 0, end, randomMs(ROTATION_MS) );
+  }
+  for(int i=0;i<4;i++) {
+    addPerson( watchAdv, sizeof(watchAdv), -60 - randomMs(30), 0, end, randomMs(ROTATION_MS) );
+  }
+  for(int i=0;i<3;i++) { // leaving, and coming in
+    addPerson( phoneAdv, sizeof(phoneAdv), -55 - randomMs(35), 0, 300000 + randomMs(1200000), ROTATION_MS * 2 );
+    addPerson( phoneAdv, sizeof(phoneAdv), -55 - randomMs(35), 300000 + randomMs(1200000), end, ROTATION_MS * 2 );
+  }
+  for(int i=0;i<150;i++) { // walking by
+    uint32_t from = randomMs(end - 40000);
+    addPerson( phoneAdv, sizeof(phoneAdv), -65 - randomMs(30), from, from + 5000 + randomMs(35000), ROTATION_MS * 2 );
+  }
+  for(auto &a : advertisers) a.next = a.from + randomMs(a.period);
+
+  CaptureWriter capture;
+  if( !capture.open( (folder + CAPTURE_FILE).c_str() ) ) return 0;
+  // events in time order, the capture starts at 1s like a booted board
+  while(1) {
+    Advertiser *first = NULL;
+    for(auto &a : advertisers) {
+      if(a.next < a.to && (first == NULL || a.next < first->next)) first = &a;
+    }
+    if(first == NULL) break;
+    int8_t rssi = first->rssi - 3 + randomMs(7);
+    capture.add( 1000 + first->next, first->mac, ADDR_TYPE_RANDOM, rssi, first->payload, first->length );
+    first->next += first->period + randomMs(11);
+  }
+  capture.close();
+  return capture.records;
+}
+
+
+int main() {
+  char folderTemplate[] = "/tmp/blecollector-cluster-XXXXXX";
+  String folder = mkdtemp(folderTemplate);
+  uint32_t records = writeCapture( folder );
+  CHECK( records > 0 );
+  CHECK( rotations > 0 );
+
+  ReplayHost host;
+  Cluster.onLink = onLink;
+  CHECK( host.init( folder.c_str() ) );
+  host.run();
+
+  int precision = links ? correctLinks * 100 / links : 0;
+  int recall = correctLinks * 100 / rotations;
+  printf("Cluster -- %d people, %d addresses, %d rotations, links:%d correct:%d precision:%d%% recall:%d%%\n",
+    people, (int)owners.size(), rotations, links, correctLinks, precision, recall
+  );
+  CHECK_EQUAL( Cluster.linked, links );
+  CHECK_EQUAL( Replay.unique, owners.size() ); // nothing dropped without CLUSTER_LINK
+
+  remove( (folder + CAPTURE_FILE).c_str() );
+  rmdir( folder.c_str() );
+  return testSummary("Cluster");
+}
@@ -0,0 +1,173 @@
+/*
+  Host tests of the payload decoders (Decoder.h), with known-good frames:
+
+    make -C test
+
+  Frames are given as the bytes of the manufacturer data or service data AD
+  structure, company id or service uuid first, as the decoders get them.
+*/
+
+#include "HostTest.h"
+#include "../BLECache.h"
+#include "../Advertisement.h"
+#include "../Decoder.h"
+
+
+// E2C56DB5-DFFB-48D2-B060-D0F5A71096E0, major 1, minor 2, -59 dBm at 1m
+static const uint8_t iBeacon[] = {
+  0x4C, 0x00, 0x02, 0x15,
+  0xE2, 0xC5, 0x6D, 0xB5, 0xDF, 0xFB, 0x48, 0xD2, 0xB0, 0x60, 0xD0, 0xF5, 0xA7, 0x10, 0x96, 0xE0,
+  0x00, 0x01, 0x00, 0x02, 0xC5
+};
+
+// Continuity "Nearby Info" message (0x10), 5 bytes of data
+static const uint8_t continuity[] = { 0x4C, 0x00, 0x10, 0x05, 0x01, 0x1C, 0x1A, 0x2B, 0x3C };
+
+// Swift Pair capable Windows 10 desktop: scenario 1, device type 9
+static const uint8_t microsoftCDP[] = {
+  0x06, 0x00, 0x01, 0x09, 0x20, 0x02,
+  0x11, 0x22, 0x33, 0x44,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+// -21 dBm, "http://www." "google" ".com"
+static const uint8_t eddystoneURL[] = { 0xAA, 0xFE, 0x10, 0xEB, 0x00, 'g', 'o', 'o', 'g', 'l', 'e', 0x07 };
+
+// "https://" "example" ".com/" "path"
+static const uint8_t eddystoneURLPath[] = { 0xAA, 0xFE, 0x10, 0xEB, 0x03, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x00, 'p', 'a', 't', 'h' };
+
+// namespace 00112233445566778899, instance aabbccddeeff
+static const uint8_t eddystoneUID[] = {
+  0xAA, 0xFE, 0x00, 0xEB,
+  0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99,
+  0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+};
+
+// version 0, 3000 mV, 25.5 C (0x1980 in 8.8 fixed point), adv count, uptime
+static const uint8_t eddystoneTLM[] = {
+  0xAA, 0xFE, 0x20, 0x00, 0x0B, 0xB8, 0x19, 0x80,
+  0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x10, 0x00
+};
+
+
+static void testIBeacon() {
+  BlueToothDevice dev;
+  CHECK_EQUAL( decodeApple(iBeacon, sizeof(iBeacon), dev), DECODED_IBEACON );
+  CHECK_STRING( dev.did, "e2c56db5-dffb-48d2-b060-d0f5a71096e0" );
+  CHECK_EQUAL( dev.dmajor, 1 );
+  CHECK_EQUAL( dev.dminor, 2 );
+  CHECK_EQUAL( dev.dpower, -59 );
+}
+
+static void testIBeaconTooShort() {
+  BlueToothDevice dev;
+  // the iBeacon header is there but the major/minor/power are cut
+  CHECK_EQUAL( decodeApple(iBeacon, 20, dev), DECODED_NONE );
+  CHECK_STRING( dev.did, "" );
+  CHECK_EQUAL( dev.dmajor, 0 );
+}
+
+static void testContinuity() {
+  BlueToothDevice dev;
+  CHECK_EQUAL( decodeApple(continuity, sizeof(continuity), dev), DECODED_CONTINUITY );
+  CHECK_EQUAL( dev.dmajor, 0x10 );
+  CHECK_EQUAL( dev.dminor, 0x01 );
+  CHECK_EQUAL( decodeApple(continuity, 3, dev), DECODED_NONE );
+}
+
+static void testMicrosoftCDP() {
+  BlueToothDevice dev;
+  CHECK_EQUAL( decodeMicrosoft(microsoftCDP, sizeof(microsoftCDP), dev), DECODED_MS_CDP );
+  CHECK_EQUAL( dev.dmajor, 1 );
+  CHECK_EQUAL( dev.dminor, 9 );
+  BlueToothDevice shortDev;
+  CHECK_EQUAL( decodeMicrosoft(microsoftCDP, 5, shortDev), DECODED_NONE );
+  CHECK_EQUAL( shortDev.dmajor, 0 );
+}
+
+static void testEddystoneURL() {
+  BlueToothDevice dev;
+  CHECK_EQUAL( decodeEddystone(eddystoneURL, sizeof(eddystoneURL), dev), DECODED_EDDYSTONE_URL );
+  CHECK_STRING( dev.did, "http://www.google.com" );
+  CHECK_EQUAL( dev.dpower, -21 );
+  BlueToothDevice pathDev;
+  CHECK_EQUAL( decodeEddystone(eddystoneURLPath, sizeof(eddystoneURLPath), pathDev), DECODED_EDDYSTONE_URL );
+  CHECK_STRING( pathDev.did, "https://example.com/path" );
+  // reserved scheme prefix
+  uint8_t badScheme[sizeof(eddystoneURL)];
+  memcpy(badScheme, eddystoneURL, sizeof(eddystoneURL));
+  badScheme[4] = 0x04;
+  BlueToothDevice badDev;
+  CHECK_EQUAL( decodeEddystone(badScheme, sizeof(badScheme), badDev), DECODED_NONE );
+  CHECK_EQUAL( decodeEddystone(eddystoneURL, 4, badDev), DECODED_NONE );
+}
+
+static void testEddystoneUID() {
+  BlueToothDevice dev;
+  CHECK_EQUAL( decodeEddystone(eddystoneUID, sizeof(eddystoneUID), dev), DECODED_EDDYSTONE_UID );
+  CHECK_STRING( dev.did, "00112233445566778899aabbccddeeff" );
+  CHECK_EQUAL( dev.dpower, -21 );
+  CHECK_EQUAL( decodeEddystone(eddystoneUID, 19, dev), DECODED_NONE );
+}
+
+static void testEddystoneTLM() {
+  BlueToothDevice dev;
+  CHECK_EQUAL( decodeEddystone(eddystoneTLM, sizeof(eddystoneTLM), dev), DECODED_EDDYSTONE_TLM );
+  CHECK_EQUAL( dev.dmajor, 3000 );
+  CHECK_EQUAL( dev.dminor, 0x1980 );
+  CHECK_EQUAL( dev.dminor >> 8, 25 ); // integer part of the temperature
+  BlueToothDevice shortDev;
+  CHECK_EQUAL( decodeEddystone(eddystoneTLM, 6, shortDev), DECODED_NONE );
+  CHECK_EQUAL( shortDev.dmajor, 0 );
+}
+
+// appends an AD structure to an advertisement payload
+static void addStructure(BLEAdvertisement &adv, uint8_t type, const uint8_t *data, uint8_t len) {
+  adv.payload[adv.payloadLength++] = len + 1;
+  adv.payload[adv.payloadLength++] = type;
+  memcpy(adv.payload + adv.payloadLength, data, len);
+  adv.payloadLength += len;
+}
+
+static void testDispatch() {
+  static const uint8_t flags[] = { 0x06 };
+  static const uint8_t unknownCompany[] = { 0x59, 0x00, 0x01, 0x02 }; // Nordic, no decoder
+  Decoder.init();
+
+  BLEAdvertisement beacon;
+  addStructure(beacon, 0x01, flags, sizeof(flags));
+  addStructure(beacon, AD_TYPE_MANUFACTURER_DATA, iBeacon, sizeof(iBeacon));
+  BlueToothDevice beaconDev;
+  CHECK_EQUAL( Decoder.decode(beacon, beaconDev), DECODED_IBEACON );
+  CHECK_EQUAL( beaconDev.dmajor, 1 );
+
+  // no decoder for the company id, falls back to the service data
+  BLEAdvertisement url;
+  addStructure(url, AD_TYPE_MANUFACTURER_DATA, unknownCompany, sizeof(unknownCompany));
+  addStructure(url, AD_TYPE_SERVICE_DATA16, eddystoneURL, sizeof(eddystoneURL));
+  BlueToothDevice urlDev;
+  CHECK_EQUAL( Decoder.decode(url, urlDev), DECODED_EDDYSTONE_URL );
+  CHECK_STRING( urlDev.did, "http://www.google.com" );
+
+  BLEAdvertisement nothing;
+  addStructure(nothing, 0x01, flags, sizeof(flags));
+  BlueToothDevice nothingDev;
+  CHECK_EQUAL( Decoder.decode(nothing, nothingDev), DECODED_NONE );
+
+  CHECK_EQUAL( Decoder.decodedCount[DECODED_IBEACON], 1 );
+  CHECK_EQUAL( Decoder.decodedCount[DECODED_EDDYSTONE_URL], 1 );
+  CHECK_EQUAL( Decoder.decodedCount[DECODED_NONE], 1 );
+}
+
+
+int main() {
+  testIBeacon();
+  testIBeaconTooShort();
+  testContinuity();
+  testMicrosoftCDP();
+  testEddystoneURL();
+  testEddystoneUID();
+  testEddystoneTLM();
+  testDispatch();
+  return testSummary("Decoder");
+}
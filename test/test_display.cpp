@@ -0,0 +1,107 @@
+/*
+  Host tests of the display simulator (host/WROVER_KIT_LCD.h): fills, text,
+  jpegs and the hardware scroll, pixel checks and golden frames:
+
+    make -C test
+    UPDATE_GOLDEN=1 make -C test   # rewrites the PNGs of golden/, review the diff
+
+  The sketch's own frames are checked by test_replay.
+*/
+
+#include "HostTest.h"
+#include "WROVER_KIT_LCD.h"
+#include "../Assets.h"
+
+WROVER_KIT_LCD lcd;
+
+
+// fills, text with and without background, the logo jpeg
+static void drawPrimitives() {
+  lcd.fillScreen(WROVER_BLACK);
+  lcd.fillRect(0, 0, 240, 20, WROVER_DARKGREY);
+  lcd.drawFastHLine(0, 20, 240, WROVER_WHITE);
+  lcd.setTextColor(WROVER_YELLOW, WROVER_DARKGREY);
+  lcd.setCursor(4, 6);
+  lcd.print("BLECollector");
+  lcd.setTextColor(WROVER_GREEN);
+  lcd.setTextSize(2);
+  lcd.setCursor(4, 30);
+  lcd.print("Size 2");
+  lcd.setTextSize(1);
+  lcd.drawJpg(tbz_28x28_jpg, tbz_28x28_jpg_len, 200, 30, 28, 28);
+  lcd.drawJpg(tbz_28x28_jpg, tbz_28x28_jpg_len, 200, 64, 14, 14, 14, 14); // bottom right quarter
+  lcd.drawRoundRect(10, 60, 100, 30, 4, WROVER_CYAN);
+  lcd.fillCircle(150, 75, 10, WROVER_RED);
+}
+
+
+// numbered lines in the scroll area, between two fixed areas
+static void drawScrolled() {
+  lcd.fillScreen(WROVER_BLACK);
+  lcd.fillRect(0, 0, 240, 16, WROVER_NAVY); // top fixed area
+  lcd.fillRect(0, 304, 240, 16, WROVER_MAROON); // bottom fixed area
+  lcd.setupScrollArea(16, 16);
+  lcd.setTextColor(WROVER_WHITE, WROVER_BLACK);
+  for(int i=0;i<36;i++) {
+    int y = 16 + i * 8;
+    lcd.setCursor(0, y);
+    lcd.printf("line %02d", i);
+  }
+  lcd.scrollTo(16 + 20 * 8); // line 20 on top of the scroll area
+}
+
+
+static bool rowEquals(int16_t y, const uint16_t *row) {
+  for(int16_t x=0;x<WROVER_WIDTH;x++) {
+    if(lcd.frame(x, y) != row[x]) return false;
+  }
+  return true;
+}
+
+
+int main() {
+  lcd.begin();
+
+  // the frame is the GRAM until something scrolls
+  drawPrimitives();
+  CHECK_EQUAL( lcd.frame(0, 0), WROVER_DARKGREY );
+  CHECK_EQUAL( lcd.frame(239, 20), WROVER_WHITE );
+  CHECK_EQUAL( lcd.frame(150, 75), WROVER_RED );
+  CHECK_EQUAL( lcd.frame(0, 319), WROVER_BLACK );
+  CHECK( lcd.frame(213, 43) != WROVER_BLACK ); // the logo
+  CHECK_EQUAL( lcd.compareGolden("golden/primitives.png"), 0 );
+
+  // bus: one window per fill, 2 bytes per pixel, charged to the clock
+  uint64_t bytes = lcd.busBytes;
+  unsigned long start = micros();
+  lcd.fillScreen(WROVER_BLACK);
+  CHECK_EQUAL( lcd.busBytes - bytes, 11 + 2 * 240 * 320 );
+  CHECK( micros() - start - (11 + 2 * 240 * 320) * 8 / 40 <= 1 ); // 40 MHz, sub-microsecond leftovers carried
+  bytes = lcd.busBytes;
+  lcd.fillRect(-10, 310, 20, 20, WROVER_WHITE); // clipped to 10x10
+  CHECK_EQUAL( lcd.busBytes - bytes, 11 + 2 * 10 * 10 );
+  bytes = lcd.busBytes;
+  lcd.fillRect(240, 0, 10, 10, WROVER_WHITE); // off screen
+  CHECK_EQUAL( lcd.busBytes - bytes, 0 );
+
+  // scroll: the fixed areas stay, the scroll area starts at the given GRAM row and wraps
+  drawScrolled();
+  CHECK_EQUAL( lcd.frame(0, 0), WROVER_NAVY );
+  CHECK_EQUAL( lcd.frame(0, 319), WROVER_MAROON );
+  uint16_t line20 = 16 + 20 * 8; // GRAM row of line 20
+  uint16_t row0[WROVER_WIDTH], row20[WROVER_WIDTH];
+  lcd.scrollTo(16);
+  for(int16_t x=0;x<WROVER_WIDTH;x++) {
+    row0[x] = lcd.frame(x, 16 + 3);
+    row20[x] = lcd.frame(x, line20 + 3);
+  }
+  CHECK( row0[2] == WROVER_WHITE ); // the 'l' of line 00
+  CHECK( !rowEquals(16 + 3, row20) );
+  lcd.scrollTo(line20);
+  CHECK( rowEquals(16 + 3, row20) ); // line 20 is shown at the top
+  CHECK( rowEquals(16 + (304 - line20) + 3, row0) ); // line 00 after the wrap
+  CHECK_EQUAL( lcd.frame(0, 0), WROVER_NAVY );
+  CHECK_EQUAL( lcd.compareGolden("golden/scrolled.png"), 0 );
+
+  return testSummary("Display");
+}
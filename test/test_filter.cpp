@@ -0,0 +1,136 @@
+/*
+  Host tests of the default filter rules (Filter.h) against the code they
+  replaced: the generated prune query must delete the same rows as the old
+  pruneTableQuery, on an in-memory sqlite DB, and evaluate() must agree with
+  the old isAnonymousDevice() checks.
+
+    make -C test
+*/
+
+#include "HostTest.h"
+#include <SD_MMC.h>
+#include <sqlite3.h>
+#include <unistd.h>
+
+#include "../BLECache.h"
+#include "../Filter.h"
+
+
+// before the filter rules, see DB.h history
+static const char *oldPruneTableQuery = "DELETE FROM blemacs WHERE appearance='' AND name='' AND uuid='' AND ouiname='[private]' AND (vname LIKE 'Apple%' or vname='[unknown]')";
+static const char *createTableQuery = "CREATE TABLE blemacs(appearance, name, address, ouiname, vname, uuid)";
+
+static bool oldIsAnonymousDevice(BlueToothDevice &BLEDev) {
+  if(BLEDev.uuid!="") return false;
+  if(BLEDev.name!="") return false;
+  if(BLEDev.appearance!="") return false;
+  if(BLEDev.ouiname=="[unpopulated]") return false;
+  if(BLEDev.vname=="[unpopulated]") return false;
+  if(BLEDev.ouiname=="[private]" || BLEDev.ouiname=="") return true;
+  if(BLEDev.vname=="[unknown]" || BLEDev.vname=="") return true;
+  if(BLEDev.vname!="" && BLEDev.ouiname!="") return false;
+  return true;
+}
+
+static const char *presence[] = { "", "x" };
+static const char *ouinames[] = { "[private]", "[unpopulated]", "", "Espressif Inc.", "[PRIVATE]" };
+static const char *vnames[] = {
+  "Apple, Inc.", "apple", "APPLEX", "Appl", "Apple%", "AppleX_", "[unknown]", "[unpopulated]", "", "Samsung", "An Apple"
+};
+#define COUNT(a) (sizeof(a)/sizeof(a[0]))
+
+
+// every combination of the fields, plus a few NULLs the sketch never inserts
+static void seed(sqlite3 *db) {
+  sqlite3_exec(db, createTableQuery, NULL, NULL, NULL);
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT INTO blemacs VALUES(?1,?2,'00:00:00:00:00:00',?3,?4,?5)", -1, &stmt, NULL);
+  for(byte a=0;a<2;a++) for(byte n=0;n<2;n++) for(byte u=0;u<2;u++)
+  for(byte o=0;o<COUNT(ouinames);o++) for(byte v=0;v<COUNT(vnames);v++) {
+    sqlite3_bind_text(stmt, 1, presence[a], -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, presence[n], -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, ouinames[o], -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, vnames[v], -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, presence[u], -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_exec(db, "INSERT INTO blemacs VALUES(NULL,'','',  '[private]','Apple, Inc.','')", NULL, NULL, NULL);
+  sqlite3_exec(db, "INSERT INTO blemacs VALUES('','','',    NULL,'Apple, Inc.','')", NULL, NULL, NULL);
+  sqlite3_exec(db, "INSERT INTO blemacs VALUES('','','',    '[private]',NULL,'')", NULL, NULL, NULL);
+}
+
+
+static String remainingRows(sqlite3 *db) {
+  sqlite3_stmt *stmt;
+  String rows = "";
+  sqlite3_prepare_v2(db, "SELECT rowid FROM blemacs ORDER BY rowid", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW) {
+    rows += String(sqlite3_column_int(stmt, 0)) + ",";
+  }
+  sqlite3_finalize(stmt);
+  return rows;
+}
+
+
+static int countRows(sqlite3 *db) {
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT count(*) FROM blemacs", -1, &stmt, NULL);
+  sqlite3_step(stmt);
+  int rows = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  return rows;
+}
+
+
+int main() {
+  char folderTemplate[] = "/tmp/blecollector-filter-XXXXXX";
+  SD_MMC.root = mkdtemp(folderTemplate); // no rules file: defaults
+  Filter.init();
+
+  // same rows deleted as the old hard-coded query
+  sqlite3 *oldDB, *newDB;
+  CHECK( sqlite3_open(":memory:", &oldDB) == SQLITE_OK );
+  CHECK( sqlite3_open(":memory:", &newDB) == SQLITE_OK );
+  seed( oldDB );
+  seed( newDB );
+  int seeded = countRows( newDB );
+  CHECK( sqlite3_exec(oldDB, oldPruneTableQuery, NULL, NULL, NULL) == SQLITE_OK );
+
+  String pruneTableQuery = Filter.pruneQuery();
+  Serial.println( pruneTableQuery );
+  sqlite3_stmt *stmt;
+  CHECK( sqlite3_prepare_v2(newDB, pruneTableQuery.c_str(), -1, &stmt, NULL) == SQLITE_OK );
+  Filter.bindPruneQuery( stmt );
+  CHECK( sqlite3_step(stmt) == SQLITE_DONE );
+  sqlite3_finalize( stmt );
+
+  int pruned = seeded - countRows( newDB );
+  Serial.printf("Pruned %d of %d rows\n", pruned, seeded);
+  CHECK_EQUAL( pruned, 6 ); // "[private]" with "Apple, Inc.", "apple", "APPLEX", "Apple%", "AppleX_" or "[unknown]"
+  CHECK_STRING( remainingRows( newDB ), remainingRows( oldDB ) );
+  sqlite3_close( oldDB );
+  sqlite3_close( newDB );
+
+  // same collection decisions as isAnonymousDevice(), and none on the raw fields alone
+  BlueToothDevice BLEDev;
+  int disagreements = 0;
+  int rawDrops = 0;
+  for(byte a=0;a<2;a++) for(byte n=0;n<2;n++) for(byte u=0;u<2;u++)
+  for(byte o=0;o<COUNT(ouinames);o++) for(byte v=0;v<COUNT(vnames);v++) {
+    BLEDev.appearance = presence[a];
+    BLEDev.name = presence[n];
+    BLEDev.uuid = presence[u];
+    BLEDev.ouiname = ouinames[o];
+    BLEDev.vname = vnames[v];
+    bool anonymous = Filter.evaluate( BLEDev ) == FILTER_DROP;
+    if( anonymous != oldIsAnonymousDevice( BLEDev ) ) disagreements++;
+    if( Filter.evaluate( BLEDev, FILTER_RESOLVED_RAW ) == FILTER_DROP ) rawDrops++;
+  }
+  CHECK_EQUAL( disagreements, 0 );
+  CHECK_EQUAL( rawDrops, 0 );
+
+  rmdir( SD_MMC.root.c_str() );
+  return testSummary("Filter");
+}
@@ -0,0 +1,85 @@
+/*
+  Host tests of the NVS freezer (Freezer.h): a batch of devices written to the
+  ring, read back, a corrupted and an uncommitted slot ignored. The NVS is the
+  stand-in of host/Preferences.h, it counts the writes and the flash entries
+  they take: the figures per frozen device are printed.
+
+    make -C test
+*/
+
+#include "ReplayHost.h"
+
+
+static void fillDevice(BlueToothDevice &BLEDev, int i) {
+  BLEDev.reset();
+  BLEDev.mac = 0x4A0000000100ULL + i;
+  BLEDev.address = "4a:00:00:00:01:0" + String(i);
+  BLEDev.addrclass = ADDR_RPA;
+  BLEDev.appearance = "";
+  BLEDev.name = "";
+  BLEDev.ouiname = "[private]";
+  BLEDev.rssi = "-7" + String(i);
+  BLEDev.vdata = "4c0010050118";
+  BLEDev.vendorid = 0x004c;
+  BLEDev.vname = "Apple, Inc.";
+  BLEDev.uuid = "";
+  BLEDev.dtype = DECODED_CONTINUITY;
+}
+
+
+static bool sameDevice(BlueToothDevice &a, BlueToothDevice &b) {
+  return a.address == b.address && a.rssi == b.rssi && a.vdata == b.vdata && a.vname == b.vname
+      && a.ouiname == b.ouiname && a.vendorid == b.vendorid && a.addrclass == b.addrclass
+      && a.dtype == b.dtype && a.in_db == b.in_db;
+}
+
+
+int main() {
+  BLEDevCacheInit();
+  Freezer.clear();
+
+  // a full batch, as freezePending() would before a restart
+  HostNVSStats before = HostNVS;
+  for(byte i=0;i<MAX_ITEMS_IN_PREFS;i++) {
+    fillDevice( BLEDevCache[i], i );
+    CHECK( Freezer.freeze( i ) );
+  }
+  CHECK( !Freezer.freeze( MAX_ITEMS_IN_PREFS ) ); // batch full
+  Freezer.commit();
+  uint32_t writes = HostNVS.writes - before.writes;
+  uint32_t entries = HostNVS.entries - before.entries;
+  CHECK_EQUAL( Freezer.freezes, MAX_ITEMS_IN_PREFS );
+  CHECK_EQUAL( writes, MAX_ITEMS_IN_PREFS + 1 ); // one blob per device, then the watermark
+  CHECK_EQUAL( Freezer.nvsEntries, entries ); // the estimate of printStats() is the layout
+  printf("Freezer -- %d devices: %d writes, %d bytes, %d flash entries (%d.%d per device)\n",
+    MAX_ITEMS_IN_PREFS, writes, HostNVS.bytes - before.bytes, entries,
+    entries / MAX_ITEMS_IN_PREFS, entries * 10 / MAX_ITEMS_IN_PREFS % 10
+  );
+
+  // nothing staged, no NVS session
+  before = HostNVS;
+  Freezer.commit();
+  CHECK_EQUAL( HostNVS.writes, before.writes );
+
+  // every slot reads back
+  BlueToothDevice thawed;
+  for(byte i=0;i<MAX_ITEMS_IN_PREFS;i++) {
+    CHECK( Freezer.thaw( i, thawed ) && sameDevice( thawed, BLEDevCache[i] ) );
+  }
+
+  // a flipped byte, and a record above the watermark
+  uint8_t buf[FREEZER_RECORD_MAX];
+  preferences.begin( FREEZER_NAMESPACE, false );
+  size_t length = preferences.getBytes( "d0", buf, sizeof(buf) );
+  buf[length - 1] ^= 0xff;
+  preferences.putBytes( "d0", buf, length );
+  fillDevice( BLEDevCache[0], 0 );
+  length = DeviceRecord::serialize( BLEDevCache[0], MAX_ITEMS_IN_PREFS + 1, buf );
+  preferences.putBytes( "d1", buf, length );
+  preferences.end();
+  CHECK( !Freezer.thaw( 0, thawed ) );
+  CHECK( !Freezer.thaw( 1, thawed ) );
+  CHECK( Freezer.thaw( 2, thawed ) && sameDevice( thawed, BLEDevCache[2] ) );
+
+  return testSummary("Freezer");
+}
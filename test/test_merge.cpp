@@ -0,0 +1,59 @@
+/*
+  Host tests of the merge buffer growth (Advertisement.h): it grows by
+  MERGE_BUFFER_SIZE up to MERGE_BUFFER_HEAP_MAX (no psram on the host), drops
+  the new addresses past that and shrinks back once the scan is processed.
+
+    make -C test
+*/
+
+#define MERGE_BUFFER_SIZE 4
+#define MERGE_BUFFER_HEAP_MAX 12
+
+#include "HostTest.h"
+#include "../BLECache.h"
+#include "../Advertisement.h"
+
+
+static const uint8_t flags[] = { 0x02, 0x01, 0x06 };
+
+static void addAddresses(uint64_t first, uint16_t howMany) {
+  for(uint16_t i=0;i<howMany;i++) {
+    MergeBuffer.add( first + i, 0, -60, flags, sizeof(flags), 1000 );
+  }
+}
+
+
+int main() {
+  MergeBuffer.init();
+  CHECK_EQUAL( MergeBuffer.capacity, 4 );
+
+  // a crowded scan: grows twice, then drops what doesn't fit
+  addAddresses( 0x100, 14 );
+  CHECK_EQUAL( MergeBuffer.count, 12 );
+  CHECK_EQUAL( MergeBuffer.capacity, 12 );
+  CHECK_EQUAL( MergeBuffer.overflows, 2 );
+  CHECK( MergeBuffer.contains( 0x100 ) );
+  CHECK( MergeBuffer.contains( 0x10b ) );
+  CHECK( !MergeBuffer.contains( 0x10c ) );
+  // known addresses still merge when full
+  MergeBuffer.add( 0x105, 0, -61, flags, sizeof(flags), 1100 );
+  CHECK_EQUAL( MergeBuffer.mergedPackets, 1 );
+  CHECK_EQUAL( MergeBuffer.records[5].rssi, -61 );
+
+  // processed: back to the initial size and an empty index
+  MergeBuffer.clear();
+  CHECK_EQUAL( MergeBuffer.count, 0 );
+  CHECK_EQUAL( MergeBuffer.capacity, 4 );
+  CHECK_EQUAL( MergeBuffer.highWater, 12 );
+  CHECK( !MergeBuffer.contains( 0x100 ) );
+
+  // the next scan grows again from there
+  addAddresses( 0x200, 6 );
+  CHECK_EQUAL( MergeBuffer.count, 6 );
+  CHECK_EQUAL( MergeBuffer.capacity, 8 );
+  CHECK( MergeBuffer.contains( 0x205 ) );
+  MergeBuffer.clear();
+  CHECK_EQUAL( MergeBuffer.capacity, 4 );
+
+  return testSummary("Merge");
+}
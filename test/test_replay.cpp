@@ -0,0 +1,157 @@
+/*
+  Host replay test: writes a small capture with known devices in the
+  Capture.h format, replays it through the sketch (see ReplayHost.h) and
+  checks the counters it keeps: BLE cache, name caches, filter, clusters,
+  decoders and the rows of the DB, then the final screen against a golden
+  frame. Built twice by the Makefile, with and without CLUSTER_LINK.
+*/
+
+#include "CaptureWriter.h"
+
+
+// flags, then an iBeacon, the name comes in the scan response
+static const uint8_t beaconAdv[] = {
+  0x02, 0x01, 0x06,
+  0x1A, 0xFF, 0x4C, 0x00, 0x02, 0x15,
+  0xE2, 0xC5, 0x6D, 0xB5, 0xDF, 0xFB, 0x48, 0xD2, 0xB0, 0x60, 0xD0, 0xF5, 0xA7, 0x10, 0x96, 0xE0,
+  0x00, 0x01, 0x00, 0x02, 0xC5
+};
+static const uint8_t beaconRsp[] = { 0x09, 0x09, 'B', 'e', 'a', 'c', 'o', 'n', '-', 'A' };
+static const uint8_t flagsOnly[] = { 0x02, 0x01, 0x06 };
+static const uint8_t tileAdv[] = { 0x02, 0x01, 0x06, 0x0A, 0x09, 'T', 'i', 'l', 'e', '_', '1', '2', '3', '4' };
+// unnamed phone: Continuity Nearby Info, same fingerprint whatever the address
+static const uint8_t phoneAdv[] = { 0x02, 0x01, 0x1A, 0x0A, 0xFF, 0x4C, 0x00, 0x10, 0x05, 0x01, 0x1C, 0x1A, 0x2B, 0x3C };
+// named printer with a Microsoft CDP payload
+static const uint8_t printerAdv[] = {
+  0x02, 0x01, 0x06,
+  0x0B, 0x09, 'H', 'P', '-', 'P', 'r', 'i', 'n', 't', 'e', 'r',
+  0x09, 0xFF, 0x06, 0x00, 0x01, 0x09, 0x20, 0x02, 0x11, 0x22
+};
+// unnamed laptop, Apple manufacturer data that isn't an iBeacon nor a known Continuity message
+static const uint8_t laptopAdv[] = { 0x02, 0x01, 0x06, 0x06, 0xFF, 0x4C, 0x00, 0x09, 0x01, 0x42 };
+
+static const uint64_t beacon = 0x001122334455ULL; // public, CIMSYS
+static const uint64_t staticRandom = 0xC01122334455ULL; // random static
+static const uint64_t tile = 0x0011223344AAULL; // public
+static const uint64_t printer = 0xB499BA000001ULL; // public, Hewlett Packard
+static const uint64_t laptop1 = 0xACBC32000001ULL; // public, Apple
+static const uint64_t laptop2 = 0xACBC32000002ULL; // same OUI
+// rotating phone addresses, 0b01 msb: resolvable private
+static const uint64_t phoneR1 = 0x4A0000000001ULL;
+static const uint64_t phoneS1 = 0x4A0000000002ULL;
+static const uint64_t phoneR2 = 0x4A0000000003ULL;
+static const uint64_t phoneQ1 = 0x4A0000000004ULL;
+static const uint64_t phoneV1 = 0x4A0000000005ULL;
+
+// the default rules, after a raw drop
+static const char *filterRules =
+  "drop name^=Tile\n"
+  "keep uuid\n"
+  "keep name\n"
+  "keep appearance\n"
+  "keep ouiname=[unpopulated]\n"
+  "keep vname=[unpopulated]\n"
+  "drop ouiname=[private] vname~=Apple\n"
+  "drop ouiname=[private] vname=[unknown]\n"
+  "skip ouiname=[private]\n"
+  "skip !ouiname\n"
+  "skip vname=[unknown]\n"
+  "skip !vname\n"
+  "keep\n";
+
+
+static uint32_t writeCapture(const String &folder) {
+  CaptureWriter capture;
+  if( !capture.open( (folder + CAPTURE_FILE).c_str() ) ) return 0;
+  // scan 1: everything is new
+  capture.add( 1000, beacon, ADDR_TYPE_PUBLIC, -50, beaconAdv, sizeof(beaconAdv) );
+  capture.add( 1010, beacon, ADDR_TYPE_PUBLIC, -50, beaconRsp, sizeof(beaconRsp) ); // merged
+  capture.add( 1100, staticRandom, ADDR_TYPE_RANDOM, -70, flagsOnly, sizeof(flagsOnly) );
+  capture.add( 1200, tile, ADDR_TYPE_PUBLIC, -75, tileAdv, sizeof(tileAdv) );
+  capture.add( 1300, phoneR1, ADDR_TYPE_RANDOM, -60, phoneAdv, sizeof(phoneAdv) );
+  capture.add( 1400, phoneS1, ADDR_TYPE_RANDOM, -80, phoneAdv, sizeof(phoneAdv) );
+  capture.add( 1500, printer, ADDR_TYPE_PUBLIC, -65, printerAdv, sizeof(printerAdv) );
+  capture.add( 1600, laptop1, ADDR_TYPE_PUBLIC, -72, laptopAdv, sizeof(laptopAdv) );
+  capture.add( 1700, laptop2, ADDR_TYPE_PUBLIC, -74, laptopAdv, sizeof(laptopAdv) );
+  capture.add( 5000, beacon, ADDR_TYPE_PUBLIC, -52, beaconRsp, sizeof(beaconRsp) ); // after MERGE_WINDOW, sealed
+  // scan 2: R1 rotated to R2 (close RSSI, S1 is too far), Q1 is another phone
+  capture.add( 40000, beacon, ADDR_TYPE_PUBLIC, -50, beaconAdv, sizeof(beaconAdv) );
+  capture.add( 40100, phoneR2, ADDR_TYPE_RANDOM, -61, phoneAdv, sizeof(phoneAdv) );
+  capture.add( 40200, phoneQ1, ADDR_TYPE_RANDOM, -66, phoneAdv, sizeof(phoneAdv) );
+  // scan 3: R2 and Q1 went quiet, V1 could be either of them
+  capture.add( 100000, beacon, ADDR_TYPE_PUBLIC, -50, beaconAdv, sizeof(beaconAdv) );
+  capture.add( 100100, phoneV1, ADDR_TYPE_RANDOM, -64, phoneAdv, sizeof(phoneAdv) );
+  capture.add( 100200, laptop1, ADDR_TYPE_PUBLIC, -71, laptopAdv, sizeof(laptopAdv) );
+  capture.close();
+  return capture.records;
+}
+
+
+int main() {
+  char folderTemplate[] = "/tmp/blecollector-replay-XXXXXX";
+  String folder = mkdtemp(folderTemplate);
+  uint32_t records = writeCapture( folder );
+  CHECK( records > 0 );
+  FILE *rules = fopen( (folder + FILTER_RULES_FILE).c_str(), "w" );
+  fputs( filterRules, rules );
+  fclose( rules );
+
+  ReplayHost host;
+  CHECK( host.init( folder.c_str() ) );
+  host.run();
+
+  CHECK_EQUAL( Replay.records, records );
+  CHECK_EQUAL( Replay.scans, 3 );
+  CHECK_EQUAL( sessDevicesCount, 14 ); // merged records, one per address and scan
+  // merge: the scan response added the name, the late packet only updated the RSSI
+  CHECK_EQUAL( MergeBuffer.mergedPackets, 1 );
+  CHECK_EQUAL( MergeBuffer.filledFields, 1 );
+  CHECK_EQUAL( MergeBuffer.overflows, 0 );
+  // the tile, by its name prefix, before any lookup
+  CHECK_EQUAL( FilteredOutCount, 1 );
+  // clusters: R2 is R1 rotated, S1 is rejected by the RSSI, V1 is ambiguous
+  CHECK_EQUAL( Cluster.linked, 1 );
+  CHECK_EQUAL( Cluster.rssiRejected, 1 );
+  CHECK_EQUAL( Cluster.ambiguous, 1 );
+  // R2 never reaches the cache when linking
+  int linked = 0;
+  #ifdef CLUSTER_LINK
+    linked = 1;
+  #endif
+  // names: the random addresses skip the OUI lookup, the second laptop hits
+  // the OUI cache, every Apple device after the beacon the vendor cache
+  CHECK_EQUAL( OuiLookupsAvoided, 6 - linked );
+  CHECK_EQUAL( OuiCacheHit, 1 );
+  CHECK_EQUAL( VendorCacheHit, 7 - linked );
+  CHECK_EQUAL( Decoder.decodedCount[DECODED_IBEACON], 1 );
+  CHECK_EQUAL( Decoder.decodedCount[DECODED_MS_CDP], 1 );
+  CHECK_EQUAL( Decoder.decodedCount[DECODED_CONTINUITY], 7 - linked ); // phones and laptops
+  // beacon, printer and laptops are kept, the phones and the static address aren't
+  CHECK_EQUAL( InsertedCount, 4 );
+  CHECK_EQUAL( host.rows(), 4 );
+  CHECK_EQUAL( AnonymousCacheHit, 6 - linked );
+  // seen again: the beacon still on screen in scan 2, the laptop in scan 3,
+  // the beacon in scan 3 is out of the last BLECARD_MAC_CACHE_SIZE cards
+  // unless R2 was linked and didn't get one
+  CHECK_EQUAL( SelfCacheHit, 2 + linked );
+  CHECK_EQUAL( BLEDevCacheHit, 1 - linked );
+
+  // the intro and the cards of scan 1 are more than a scroll area, printed
+  // before the render task gets a frame: one catch-up while printing
+  CHECK_EQUAL( Out.syncScrolls, 1 );
+  // the screen at the end of the capture, see host/WROVER_KIT_LCD.h
+  #ifdef CLUSTER_LINK
+    CHECK_EQUAL( tft.compareGolden("golden/replay-link.png"), 0 );
+  #else
+    CHECK_EQUAL( tft.compareGolden("golden/replay.png"), 0 );
+  #endif
+
+  remove( (folder + CAPTURE_FILE).c_str() );
+  remove( (folder + FILTER_RULES_FILE).c_str() );
+  rmdir( folder.c_str() );
+  #ifdef CLUSTER_LINK
+    return testSummary("Replay (CLUSTER_LINK)");
+  #else
+    return testSummary("Replay");
+  #endif
+}
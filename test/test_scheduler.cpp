@@ -0,0 +1,136 @@
+/*
+  Adaptive against fixed scan settings (see ScanScheduler.h), on the same
+  capture replayed with REPLAY_RADIO: only the packets sent while the scan
+  window is open and the previous results aren't being processed are heard.
+  Prints the distinct devices heard per minute for both, and fails if the
+  adaptive scheduler hears fewer.
+
+  The sketch state can't be reset, the fixed run is done in a forked child.
+
+  The capture is made up, 10 minutes:
+    - 6 beacons around all the time, every 300 ms
+    - two waves of people walking by, each phone with its own rotating
+      address, heard for a few seconds only, every 500 to 1000 ms
+    - quiet minutes before, between and after the waves
+  every advertising event gets the 0-10 ms random delay of the spec.
+*/
+
+#define REPLAY_RADIO 1
+#include "CaptureWriter.h"
+
+#include <sys/wait.h>
+
+#define CAPTURE_MINUTES 10
+
+
+struct Advertiser {
+  uint64_t mac;
+  uint8_t addrType;
+  int8_t rssi;
+  uint32_t from, to, period; // ms
+  uint32_t next;
+};
+
+#ifndef CAPTURE_SEED
+#define CAPTURE_SEED 12345 // -DCAPTURE_SEED=n for another crowd
+#endif
+static uint32_t lcg = CAPTURE_SEED;
+static uint32_t randomMs(uint32_t n) {
+  lcg = lcg * 1103515245 + 12345;
+  return (lcg >> 16) % n;
+}
+
+// named beacon
+static const uint8_t beaconAdv[] = { 0x02, 0x01, 0x06, 0x07, 0x09, 'B', 'e', 'a', 'c', 'o', 'n' };
+// unnamed phone, Continuity Nearby Info
+static const uint8_t phoneAdv[] = { 0x02, 0x01, 0x1A, 0x0A, 0xFF, 0x4C, 0x00, 0x10, 0x05, 0x01, 0x1C, 0x1A, 0x2B, 0x3C };
+
+
+static void addWave(std::vector<Advertiser> &advertisers, int count, uint32_t from, uint32_t to, uint32_t firstMac) {
+  for(int i=0;i<count;i++) {
+    Advertiser phone;
+    phone.mac = 0x4A0000000000ULL | (firstMac + i);
+    phone.addrType = ADDR_TYPE_RANDOM;
+    phone.rssi = -60 - randomMs(30);
+    phone.from = from + randomMs(to - from);
+    phone.to = phone.from + 2000 + randomMs(6000); // walking by
+    phone.period = 500 + randomMs(500);
+    advertisers.push_back(phone);
+  }
+}
+
+
+static uint32_t writeCapture(const String &folder) {
+  std::vector<Advertiser> advertisers;
+  for(int i=0;i<6;i++) {
+    Advertiser beacon = { 0xF0D5BF000000ULL | i, ADDR_TYPE_PUBLIC, (int8_t)(-50 - i), 0, CAPTURE_MINUTES * 60000, 300, 0 };
+    advertisers.push_back(beacon);
+  }
+  addWave(advertisers, 80, 120000, 240000, 0x1000);
+  addWave(advertisers, 40, 360000, 480000, 0x2000);
+  for(auto &a : advertisers) a.next = a.from + randomMs(a.period);
+
+  CaptureWriter capture;
+  if( !capture.open( (folder + CAPTURE_FILE).c_str() ) ) return 0;
+  // events in time order, the capture starts at 1s like a booted board
+  while(1) {
+    Advertiser *first = NULL;
+    for(auto &a : advertisers) {
+      if(a.next < a.to && (first == NULL || a.next < first->next)) first = &a;
+    }
+    if(first == NULL) break;
+    if(first->addrType == ADDR_TYPE_PUBLIC) {
+      capture.add( 1000 + first->next, first->mac, first->addrType, first->rssi, beaconAdv, sizeof(beaconAdv) );
+    } else {
+      capture.add( 1000 + first->next, first->mac, first->addrType, first->rssi, phoneAdv, sizeof(phoneAdv) );
+    }
+    first->next += first->period + randomMs(11);
+  }
+  capture.close();
+  return capture.records;
+}
+
+
+int main() {
+  char folderTemplate[] = "/tmp/blecollector-scheduler-XXXXXX";
+  String folder = mkdtemp(folderTemplate);
+  uint32_t records = writeCapture( folder );
+  CHECK( records > 0 );
+
+  // fixed settings in a child, its result comes back through a pipe
+  int result[2];
+  CHECK( pipe(result) == 0 );
+  fflush(stdout);
+  pid_t child = fork();
+  if(child == 0) {
+    ReplayHost host;
+    Scheduler.adaptive = false;
+    if( !host.init( folder.c_str() ) ) _exit(1);
+    host.run();
+    uint32_t figures[2] = { Replay.uniquePerMinute10(), Replay.unique };
+    if( write(result[1], figures, sizeof(figures)) != sizeof(figures) ) _exit(1);
+    fflush(stdout);
+    _exit(0);
+  }
+  uint32_t fixed[2] = { 0, 0 };
+  CHECK( read(result[0], fixed, sizeof(fixed)) == sizeof(fixed) );
+  int status = -1;
+  waitpid(child, &status, 0);
+  CHECK_EQUAL( status, 0 );
+
+  ReplayHost host;
+  CHECK( host.init( folder.c_str() ) );
+  host.run();
+
+  printf("Scheduler -- unique devices per minute: adaptive %d.%d (%d), fixed %d.%d (%d), %d in the capture\n",
+    Replay.uniquePerMinute10() / 10, Replay.uniquePerMinute10() % 10, Replay.unique,
+    fixed[0] / 10, fixed[0] % 10, fixed[1],
+    6 + 80 + 40
+  );
+  CHECK( Replay.unique > 0 );
+  CHECK( Replay.uniquePerMinute10() >= fixed[0] );
+
+  remove( (folder + CAPTURE_FILE).c_str() );
+  rmdir( folder.c_str() );
+  return testSummary("Scheduler");
+}
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+Converts the card icons of Assets.h (JPEG arrays) into Icons.h, a raw RGB565
+atlas: every icon is stored row-major, one after the other, in a single flash
+array, and located by its IconRect (offset, width, height). The sketch blits
+an icon with one drawRGBBitmap() call instead of decoding a JPEG.
+
+Usage, from the sketch folder, whenever an icon changes in Assets.h:
+
+    python3 tools/make_icons.py [Assets.h] [Icons.h]
+
+Requires Pillow (pip install pillow).
+"""
+
+import io
+import re
+import sys
+
+from PIL import Image
+
+# atlas order, (enum name, Assets.h array)
+ICONS = [
+    ("ICON_NIC",       "nic16_jpeg"),
+    ("ICON_NAME",      "name_jpeg"),
+    ("ICON_INSERT",    "insert_jpeg"),
+    ("ICON_UPDATE",    "update_jpeg"),
+    ("ICON_SERVICE",   "service_jpeg"),
+    ("ICON_GENERIC",   "generic_jpeg"),
+    ("ICON_APPLE",     "apple16_jpeg"),
+    ("ICON_IBM",       "ibm8_jpg"),
+    ("ICON_MICROSOFT", "crosoft_jpeg"),
+]
+
+HEADER = """/*
+
+  ESP32 BLE Collector - A BLE scanner with sqlite data persistence on the SD Card
+  Source: https://github.com/tobozo/ESP32-BLECollector
+
+  MIT License
+
+  Copyright (c) 2018 tobozo
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------
+
+  RGB565 icon atlas, generated from Assets.h by tools/make_icons.py, don't edit.
+
+*/
+"""
+
+
+def load_arrays(path):
+    source = open(path).read()
+    arrays = {}
+    for name, body in re.findall(r"const unsigned char (\w+)\[\][^{]*\{([^}]*)\}", source):
+        arrays[name] = bytes(int(value, 16) for value in re.findall(r"0x[0-9a-fA-F]{2}", body))
+    return arrays
+
+
+def rgb565(r, g, b):
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
+
+
+def main():
+    assets = sys.argv[1] if len(sys.argv) > 1 else "Assets.h"
+    output = sys.argv[2] if len(sys.argv) > 2 else "Icons.h"
+    arrays = load_arrays(assets)
+    pixels = []
+    rects = []
+    for enum, array in ICONS:
+        image = Image.open(io.BytesIO(arrays[array])).convert("RGB")
+        width, height = image.size
+        rects.append((enum, array, len(pixels), width, height))
+        pixels.extend(rgb565(*image.getpixel((x, y))) for y in range(height) for x in range(width))
+
+    out = [HEADER]
+    out.append("enum IconId {")
+    for i, (enum, array, offset, width, height) in enumerate(rects):
+        out.append("  %s = %d, // %s" % (enum.ljust(14), i, array))
+    out.append("  ICONS_COUNT")
+    out.append("};\n")
+    out.append("struct IconRect {")
+    out.append("  uint16_t offset; // in iconAtlas")
+    out.append("  uint8_t width;")
+    out.append("  uint8_t height;")
+    out.append("};\n")
+    out.append("const IconRect iconRects[ICONS_COUNT] = {")
+    for enum, array, offset, width, height in rects:
+        out.append("  { %4d, %2d, %d }, // %s" % (offset, width, height, enum))
+    out.append("};\n")
+    out.append("const uint16_t iconAtlas[%d] PROGMEM = {" % len(pixels))
+    for i in range(0, len(pixels), 12):
+        out.append("  " + ", ".join("0x%04x" % p for p in pixels[i:i + 12]) + ",")
+    out.append("};")
+    open(output, "w").write("\n".join(out) + "\n")
+    print("%s: %d icons, %d pixels, %d bytes" % (output, len(rects), len(pixels), 2 * len(pixels)))
+
+
+if __name__ == "__main__":
+    main()